@@ -37,14 +37,12 @@
 //(startup) item
 @property(nonatomic, retain)Item* item;
 
-//esf client
-@property es_client_t* esClient;
-
 //esf message
 @property es_message_t* esMessage;
 
-//esf sema
-@property dispatch_semaphore_t esSemaphore;
+//(destination) file version
+// dev, inode, (status) change time, and size
+@property(nonatomic, retain)NSString* fileVersion;
 
 //(user) action
 @property NSUInteger action;
@@ -57,10 +55,29 @@
 //init
 -(id)init:(id)object plugin:(PluginBase*)plugin;
 
+//init
+// w/ option to defer resolving (startup) item
+-(id)init:(id)object plugin:(PluginBase*)plugin resolve:(BOOL)resolve;
+
+//resolve (startup) item
+-(void)resolve;
+
 //determines if a event is related
 // checks things like process path, plugins, paths, etc
 -(BOOL)isRelated:(Event*)lastEvent includeTime:(BOOL)includeTime;
 
+//relation fingerprint
+// events related (w/o time) have same fingerprint, 0 if event can't be related
+-(NSUInteger)fingerprint;
+
+//source fingerprint
+// events from same source (and unchanged file) have same fingerprint, 0 if there's no file version
+-(NSUInteger)sourceFingerprint;
+
+//same source?
+// same plugin, process path, and (unchanged) destination file
+-(BOOL)isSameSource:(Event*)event;
+
 //create an (deliverable) obj
 -(NSMutableDictionary*)toAlert;
 
@@ -17,6 +17,8 @@
 
 #import "FileMonitor.h"
 
+#import <sys/stat.h>
+
 /* GLOBALS */
 
 //log handle
@@ -32,13 +34,23 @@ extern os_log_t logHandle;
 @synthesize plugin;
 @synthesize process;
 @synthesize timestamp;
-@synthesize esClient;
 @synthesize esMessage;
-@synthesize esSemaphore;
+@synthesize fileVersion;
 
 //init
+// and resolve item
 -(id)init:(id)object plugin:(PluginBase*)plugin
 {
+    return [self init:object plugin:plugin resolve:YES];
+}
+
+//init
+// item is only resolved if requested, as that may be expensive (e.g. parsing a plist)
+-(id)init:(id)object plugin:(PluginBase*)plugin resolve:(BOOL)resolve
+{
+    //file info
+    struct stat fileInfo = {0};
+    
     self = [super init];
     if(self)
     {
@@ -56,6 +68,16 @@ extern os_log_t logHandle;
             
             //save process
             self.process = file.process;
+            
+            //save (destination) file version
+            // so unchanged files can be detected w/o parsing
+            // note: ctime, not mtime, as mtime can be reset (utimes), but ctime can't
+            if( (nil != file.destinationPath) &&
+                (0 == stat(file.destinationPath.fileSystemRepresentation, &fileInfo)) )
+            {
+                //save
+                self.fileVersion = [NSString stringWithFormat:@"%d:%llu:%ld.%ld:%lld", fileInfo.st_dev, fileInfo.st_ino, fileInfo.st_ctimespec.tv_sec, fileInfo.st_ctimespec.tv_nsec, fileInfo.st_size];
+            }
         }
         //process obj?
         else if(YES == [object isKindOfClass:Process.class])
@@ -69,12 +91,30 @@ extern os_log_t logHandle;
         
         //init item
         // calls into plugin to set name, obj, etc...
-        self.item = [[Item alloc] init:self];
+        if(YES == resolve)
+        {
+            //resolve
+            [self resolve];
+        }
     }
     
     return self;
 }
 
+//resolve (startup) item
+// calls into plugin to set name, obj, etc...
+-(void)resolve
+{
+    //not yet resolved?
+    if(nil == self.item)
+    {
+        //init
+        self.item = [[Item alloc] init:self];
+    }
+    
+    return;
+}
+
 //create an (deliverable) dictionary object
 -(NSMutableDictionary*)toAlert
 {
@@ -240,6 +280,73 @@ extern os_log_t logHandle;
     return YES;
 }
 
+//relation fingerprint
+// hash over what 'isRelated' compares (w/o time), so related events share a fingerprint
+-(NSUInteger)fingerprint
+{
+    //fingerprint
+    NSUInteger fingerprint = 0;
+    
+    //can't be related?
+    // 'isRelated' treats missing paths/items as different
+    if( (nil == self.process.path) ||
+        (nil == self.file.destinationPath) ||
+        (nil == self.item.object) )
+    {
+        return 0;
+    }
+    
+    //plugin
+    fingerprint = (NSUInteger)(__bridge void*)self.plugin;
+    
+    //mix in process path, startup path, and startup item
+    fingerprint = (fingerprint * 0x9E3779B97F4A7C15ULL) ^ self.process.path.hash;
+    fingerprint = (fingerprint * 0x9E3779B97F4A7C15ULL) ^ self.file.destinationPath.hash;
+    fingerprint = (fingerprint * 0x9E3779B97F4A7C15ULL) ^ self.item.object.hash;
+    
+    //0 is reserved
+    return (0 != fingerprint) ? fingerprint : 1;
+}
+
+//source fingerprint
+// hash over plugin, process path, and (destination) file and its version, i.e. w/o item
+-(NSUInteger)sourceFingerprint
+{
+    //fingerprint
+    NSUInteger fingerprint = 0;
+    
+    //no file version?
+    // can't tell if (startup) item changed
+    if( (nil == self.process.path) ||
+        (nil == self.file.destinationPath) ||
+        (nil == self.fileVersion) )
+    {
+        return 0;
+    }
+    
+    //plugin
+    fingerprint = (NSUInteger)(__bridge void*)self.plugin;
+    
+    //mix in process path, startup path, and its version
+    fingerprint = (fingerprint * 0x9E3779B97F4A7C15ULL) ^ self.process.path.hash;
+    fingerprint = (fingerprint * 0x9E3779B97F4A7C15ULL) ^ self.file.destinationPath.hash;
+    fingerprint = (fingerprint * 0x9E3779B97F4A7C15ULL) ^ self.fileVersion.hash;
+    
+    //0 is reserved
+    return (0 != fingerprint) ? fingerprint : 1;
+}
+
+//same source?
+// same plugin, process path, and (unchanged) destination file
+-(BOOL)isSameSource:(Event*)event
+{
+    return ( (self.plugin == event.plugin) &&
+             (nil != self.fileVersion) &&
+             (YES == [self.process.path isEqualToString:event.process.path]) &&
+             (YES == [self.file.destinationPath isEqualToString:event.file.destinationPath]) &&
+             (YES == [self.fileVersion isEqualToString:event.fileVersion]) );
+}
+
 //build an array of processes ancestry
 // this is used to populate the 'ancesty' popup
 -(NSMutableArray*)buildProcessHierarchy:(Process*)process
@@ -250,6 +357,9 @@ extern os_log_t logHandle;
     //ancestor
     NSNumber* ancestor = nil;
     
+    //ancestor's path
+    NSString* ancestorPath = nil;
+    
     //alloc
     processHierarchy = [NSMutableArray array];
     
@@ -267,8 +377,17 @@ extern os_log_t logHandle;
         //extact ancestor
         ancestor = process.ancestors[i];
         
+        //path
+        // from process tree, so no lookup (and still set if ancestor exited)
+        ancestorPath = (i < process.ancestorPaths.count) ? process.ancestorPaths[i] : nil;
+        if(0 == ancestorPath.length)
+        {
+            //lookup
+            ancestorPath = getProcessPath(ancestor.intValue);
+        }
+        
         //add
-        [processHierarchy addObject:[@{@"pid":ancestor, @"name":valueForStringItem(getProcessPath(ancestor.intValue))} mutableCopy]];
+        [processHierarchy addObject:[@{@"pid":ancestor, @"name":valueForStringItem(ancestorPath)} mutableCopy]];
     }
         
     //add the index value
@@ -0,0 +1,60 @@
+//
+//  file: EventCoalescer.h
+//  project: BlockBlock (launch daemon)
+//  description: coalesces bursts of related events (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+#ifndef EventCoalescer_h
+#define EventCoalescer_h
+
+@import Foundation;
+
+@class Event;
+
+/* CONSTS */
+
+//default window (seconds)
+// related events within this long of each other are coalesced
+#define COALESCER_DEFAULT_WINDOW 3
+
+//default capacity
+// number of recent events tracked
+#define COALESCER_DEFAULT_CAPACITY 64
+
+@interface EventCoalescer : NSObject
+
+/* PROPERTIES */
+
+//window (nanoseconds)
+@property(readonly)uint64_t window;
+
+//capacity
+@property(readonly)NSUInteger capacity;
+
+/* METHODS */
+
+//init
+-(id)initWithWindow:(NSTimeInterval)window capacity:(NSUInteger)capacity;
+
+//check if event is related to a recent one (within window)
+// if so, that one is refreshed (with this event), so bursts are coalesced
+-(BOOL)coalesce:(Event*)event;
+
+//check if (unresolved) event is from same source as a recent one (within window)
+// i.e. same plugin, process, and unchanged file, so (startup) item needn't be resolved
+-(BOOL)coalesceUnresolved:(Event*)event;
+
+//add event
+// evicts least recently seen, if at capacity
+-(void)add:(Event*)event;
+
+//stats
+// hits (incl. those that avoided resolving an item), misses, evictions, etc
+-(NSDictionary*)stats;
+
+@end
+
+#endif /* EventCoalescer_h */
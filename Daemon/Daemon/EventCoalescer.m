@@ -0,0 +1,436 @@
+//
+//  file: EventCoalescer.m
+//  project: BlockBlock (launch daemon)
+//  description: coalesces bursts of related events
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+//  recent events are tracked in an LRU list, and by (relation) fingerprint. as each hit
+//  or add moves an entry to the front (w/ the current time), the list is also ordered by
+//  time, so entries that have aged out of the window are expired from the back.
+//
+//  this replaces checking only the last event, so interleaved bursts (e.g. an installer
+//  writing to two plists in alternation, or two processes) are still coalesced
+//
+//  entries are also tracked by source (plugin, process, and destination file w/ its version),
+//  so an event from the same source as a recent one can be coalesced before its (startup)
+//  item is resolved (e.g. w/o re-parsing a plist that hasn't changed)
+
+@import OSLog;
+
+#import <mach/mach_time.h>
+
+#import "Event.h"
+#import "utilities.h"
+#import "EventCoalescer.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+/* OBJECT: ENTRY */
+
+@interface CoalescerEntry : NSObject
+
+//fingerprint
+@property NSUInteger fingerprint;
+
+//source fingerprint
+@property NSUInteger sourceFingerprint;
+
+//(most recent) event
+@property(nonatomic, retain)Event* event;
+
+//last seen
+// mach time
+@property uint64_t lastSeen;
+
+//next (less recent) entry
+@property(nonatomic, retain)CoalescerEntry* next;
+
+//previous (more recent) entry
+@property(nonatomic, weak)CoalescerEntry* prev;
+
+@end
+
+@implementation CoalescerEntry
+
+@synthesize next;
+@synthesize prev;
+@synthesize event;
+@synthesize lastSeen;
+@synthesize fingerprint;
+@synthesize sourceFingerprint;
+
+@end
+
+@interface EventCoalescer ()
+{
+    //counters
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evicted;
+    uint64_t expired;
+    uint64_t unresolvedHits;
+}
+
+//entries
+// key: fingerprint
+@property(nonatomic, retain)NSMutableDictionary* entries;
+
+//entries
+// key: source fingerprint
+@property(nonatomic, retain)NSMutableDictionary* sources;
+
+//most recent entry
+@property(nonatomic, retain)CoalescerEntry* head;
+
+//least recent entry
+@property(nonatomic, weak)CoalescerEntry* tail;
+
+@end
+
+@implementation EventCoalescer
+
+@synthesize head;
+@synthesize tail;
+@synthesize sources;
+@synthesize window;
+@synthesize entries;
+@synthesize capacity;
+
+//init
+-(id)initWithWindow:(NSTimeInterval)timeWindow capacity:(NSUInteger)maxEntries
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //save
+        window = (uint64_t)(timeWindow * NSEC_PER_SEC);
+        capacity = MAX(maxEntries, 1);
+
+        //alloc
+        entries = [NSMutableDictionary dictionary];
+        sources = [NSMutableDictionary dictionary];
+    }
+
+    return self;
+}
+
+//check if event is related to a recent one (within window)
+// if so, refresh that entry w/ this event
+-(BOOL)coalesce:(Event*)event
+{
+    //flag
+    BOOL coalesced = NO;
+
+    //entry
+    CoalescerEntry* entry = nil;
+
+    //fingerprint
+    NSUInteger fingerprint = event.fingerprint;
+
+    //sync
+    @synchronized(self)
+    {
+        //now
+        uint64_t now = mach_absolute_time();
+
+        //expire old entries
+        [self expire:now];
+
+        //can't be related?
+        if(0 == fingerprint)
+        {
+            //miss
+            misses++;
+
+            //bail
+            goto bail;
+        }
+
+        //related?
+        // note: still check, as fingerprints may collide
+        entry = self.entries[@(fingerprint)];
+        if( (nil == entry) ||
+            (YES != [event isRelated:entry.event includeTime:NO]) )
+        {
+            //miss
+            misses++;
+
+            //bail
+            goto bail;
+        }
+
+        //refresh
+        // i.e. window slides w/ each related event
+        [self refresh:entry event:event now:now];
+
+        //hit
+        hits++;
+
+        //happy
+        coalesced = YES;
+    }
+
+bail:
+
+    return coalesced;
+}
+
+//check if (unresolved) event is from same source as a recent one (within window)
+// if so, it's related, so takes that one's (startup) item, and refreshes it
+-(BOOL)coalesceUnresolved:(Event*)event
+{
+    //flag
+    BOOL coalesced = NO;
+
+    //entry
+    CoalescerEntry* entry = nil;
+
+    //source fingerprint
+    NSUInteger sourceFingerprint = event.sourceFingerprint;
+
+    //no source fingerprint?
+    // (full) check will be done once item is resolved
+    if(0 == sourceFingerprint) return NO;
+
+    //sync
+    @synchronized(self)
+    {
+        //now
+        uint64_t now = mach_absolute_time();
+
+        //expire old entries
+        [self expire:now];
+
+        //same source?
+        // note: still check, as fingerprints may collide
+        entry = self.sources[@(sourceFingerprint)];
+        if( (nil == entry) ||
+            (YES != [event isSameSource:entry.event]) )
+        {
+            //bail
+            // not a miss, as (full) check will be done once item is resolved
+            goto bail;
+        }
+
+        //same (unchanged) file
+        // so item is too
+        event.item = entry.event.item;
+
+        //refresh
+        // i.e. window slides w/ each related event
+        [self refresh:entry event:event now:now];
+
+        //hit
+        hits++;
+        unresolvedHits++;
+
+        //happy
+        coalesced = YES;
+    }
+
+bail:
+
+    return coalesced;
+}
+
+//add event
+// or refresh its entry, if there's one w/ same fingerprint
+-(void)add:(Event*)event
+{
+    //entry
+    CoalescerEntry* entry = nil;
+
+    //fingerprint
+    NSUInteger fingerprint = event.fingerprint;
+
+    //can't be related?
+    if(0 == fingerprint) return;
+
+    //sync
+    @synchronized(self)
+    {
+        //now
+        uint64_t now = mach_absolute_time();
+
+        //expire old entries
+        [self expire:now];
+
+        //new entry?
+        entry = self.entries[@(fingerprint)];
+        if(nil == entry)
+        {
+            //at capacity?
+            // evict least recent
+            if(self.entries.count >= self.capacity)
+            {
+                //remove
+                [self remove:self.tail];
+
+                //inc
+                evicted++;
+            }
+
+            //init
+            entry = [[CoalescerEntry alloc] init];
+            entry.fingerprint = fingerprint;
+
+            //add
+            self.entries[@(fingerprint)] = entry;
+
+            //add to front
+            [self link:entry];
+        }
+
+        //(re)init
+        [self refresh:entry event:event now:now];
+    }
+
+    return;
+}
+
+//expire entries
+// from back (least recent), till one is still within window
+// note: caller must hold lock
+-(void)expire:(uint64_t)now
+{
+    //expire
+    while( (nil != self.tail) &&
+           (machTimeToNanoseconds(now - self.tail.lastSeen) >= self.window) )
+    {
+        //remove
+        [self remove:self.tail];
+
+        //inc
+        expired++;
+    }
+
+    return;
+}
+
+//refresh entry
+// w/ (newer) event, and move to front
+// note: caller must hold lock
+-(void)refresh:(CoalescerEntry*)entry event:(Event*)event now:(uint64_t)now
+{
+    //remove (old) source
+    // if it (still) maps to this entry
+    if(entry == self.sources[@(entry.sourceFingerprint)])
+    {
+        //remove
+        [self.sources removeObjectForKey:@(entry.sourceFingerprint)];
+    }
+
+    //update
+    entry.event = event;
+    entry.lastSeen = now;
+    entry.sourceFingerprint = event.sourceFingerprint;
+
+    //add (new) source
+    if(0 != entry.sourceFingerprint)
+    {
+        //add
+        self.sources[@(entry.sourceFingerprint)] = entry;
+    }
+
+    //move to front
+    [self unlink:entry];
+    [self link:entry];
+
+    return;
+}
+
+//remove entry
+// from list, and both maps
+// note: caller must hold lock
+-(void)remove:(CoalescerEntry*)entry
+{
+    //entry (strong)
+    // as removing may drop last reference
+    CoalescerEntry* removed = entry;
+
+    //remove
+    [self.entries removeObjectForKey:@(removed.fingerprint)];
+
+    //remove source
+    // if it (still) maps to this entry
+    if(removed == self.sources[@(removed.sourceFingerprint)])
+    {
+        //remove
+        [self.sources removeObjectForKey:@(removed.sourceFingerprint)];
+    }
+
+    //unlink
+    [self unlink:removed];
+
+    return;
+}
+
+//add entry to front
+// note: caller must hold lock
+-(void)link:(CoalescerEntry*)entry
+{
+    //link
+    entry.prev = nil;
+    entry.next = self.head;
+
+    //update old head
+    if(nil != self.head) self.head.prev = entry;
+
+    //update head
+    self.head = entry;
+
+    //first?
+    if(nil == self.tail) self.tail = entry;
+
+    return;
+}
+
+//remove entry from list
+// note: caller must hold lock
+-(void)unlink:(CoalescerEntry*)entry
+{
+    //entry (strong)
+    // as unlinking may drop last reference
+    CoalescerEntry* unlinked = entry;
+
+    //update previous
+    if(nil != unlinked.prev) unlinked.prev.next = unlinked.next;
+    else self.head = unlinked.next;
+
+    //update next
+    if(nil != unlinked.next) unlinked.next.prev = unlinked.prev;
+    else self.tail = unlinked.prev;
+
+    //reset
+    unlinked.next = nil;
+    unlinked.prev = nil;
+
+    return;
+}
+
+//stats
+// hits, misses, evictions, etc
+-(NSDictionary*)stats
+{
+    //sync
+    @synchronized(self)
+    {
+        return @{@"window (ms)":@(self.window / NSEC_PER_MSEC),
+                 @"capacity":@(self.capacity),
+                 @"entries":@(self.entries.count),
+                 @"hits":@(hits),
+                 @"hits (item not resolved)":@(unresolvedHits),
+                 @"misses":@(misses),
+                 @"evicted":@(evicted),
+                 @"expired":@(expired)};
+    }
+}
+
+@end
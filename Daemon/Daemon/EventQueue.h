@@ -0,0 +1,67 @@
+//
+//  file: EventQueue.h
+//  project: BlockBlock (launch daemon)
+//  description: bounded (lock-free) queue between ES callbacks and event workers (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+#ifndef EventQueue_h
+#define EventQueue_h
+
+@import Foundation;
+
+#import "FileMonitor.h"
+#import <EndpointSecurity/EndpointSecurity.h>
+
+@class PluginBase;
+
+/* CONSTS */
+
+//max number of workers
+// each owns a shard (ring)
+#define EVENT_QUEUE_MAX_WORKERS 8
+
+//capacity of each shard
+// note: must be a power of 2
+#define EVENT_QUEUE_CAPACITY 512
+
+//how long a producer will wait (in microseconds) for space in a full shard
+// after which the event is spilled to the shard's (unbounded) overflow list, so the ES queue
+// is never stalled for long, and events that matched a plugin are never dropped
+#define EVENT_QUEUE_BACKPRESSURE_WAIT 5000
+
+//number of (log2, microsecond) latency buckets
+#define EVENT_QUEUE_LATENCY_BUCKETS 32
+
+/* TYPEDEFS */
+
+//block for workers
+typedef void (^EventQueueHandler)(File* _Nonnull file, PluginBase* _Nullable plugin, es_message_t* _Nullable message);
+
+@interface EventQueue : NSObject
+
+/* METHODS */
+
+//init
+// workers: number of shards/workers, capacity: per shard
+-(id _Nullable)initWithWorkers:(NSUInteger)workers capacity:(NSUInteger)capacity handler:(EventQueueHandler _Nonnull)handler;
+
+//add event
+// sharded by responsible process, so per-process order is kept
+// note: takes ownership of (retained) message, which is released if event is dropped
+//       (only if it has no plugin, or queue is stopped)
+-(BOOL)enqueue:(File* _Nonnull)file plugin:(PluginBase* _Nullable)plugin message:(es_message_t* _Nullable)message;
+
+//stop workers
+// rejects new events, and any still queued are dropped (their messages released)
+-(void)stop;
+
+//stats
+// counters, depth, throughput & latency
+-(NSDictionary* _Nonnull)stats;
+
+@end
+
+#endif /* EventQueue_h */
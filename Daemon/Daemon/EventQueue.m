@@ -0,0 +1,914 @@
+//
+//  file: EventQueue.m
+//  project: BlockBlock (launch daemon)
+//  description: bounded (lock-free) queue between ES callbacks and event workers
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+//  ES callbacks (file, btm) only enqueue events, so a slow event (plist parsing, rule lookup,
+//  xpc delivery) no longer stalls the ES queue. each worker owns a bounded ring, that any ES
+//  callback can push to (multi-producer, single-consumer). events are sharded by responsible
+//  process, so events from a process are still handled in order. when a ring is full, producers
+//  wait (briefly) for space, then spill the event to the ring's (unbounded) overflow list, which
+//  its worker drains once the ring is empty. events that matched a plugin are never dropped; only
+//  those without one (or any that arrive once stopped) are, and each drop is logged and counted.
+
+@import OSLog;
+
+#import <stdatomic.h>
+#import <mach/mach_time.h>
+
+#import "utilities.h"
+#import "PluginBase.h"
+#import "EventQueue.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+/* TYPEDEFS */
+
+//ring cell
+// sequence number tracks if cell is free or full
+typedef struct
+{
+    //sequence
+    _Atomic(size_t) sequence;
+
+    //item
+    // (retained) EventQueueItem
+    void* item;
+
+} RingCell;
+
+//ring
+// bounded multi-producer, single-consumer queue
+typedef struct
+{
+    //cells
+    RingCell* cells;
+
+    //capacity - 1
+    size_t mask;
+
+    //producers' position
+    // own cache line, as it's contended
+    _Alignas(64) _Atomic(size_t) enqueuePos;
+
+    //consumer's position
+    _Alignas(64) _Atomic(size_t) dequeuePos;
+
+    //max depth seen
+    _Atomic(size_t) highWater;
+
+    //number of items in ring's overflow list
+    // while non-zero, producers append to it (not the ring), so order is kept
+    _Atomic(size_t) spilled;
+
+} Ring;
+
+/* OBJECT: ITEM */
+
+@interface EventQueueItem : NSObject
+
+//file
+@property(nonatomic, retain)File* file;
+
+//plugin
+@property(nonatomic, retain)PluginBase* plugin;
+
+//message
+@property es_message_t* message;
+
+//when enqueued
+@property uint64_t enqueued;
+
+@end
+
+@implementation EventQueueItem
+
+@synthesize file;
+@synthesize plugin;
+@synthesize message;
+@synthesize enqueued;
+
+@end
+
+/* FUNCTIONS */
+
+//init ring
+static BOOL ringInit(Ring* ring, size_t capacity);
+
+//push item
+// returns NO if ring is full
+static BOOL ringPush(Ring* ring, void* item);
+
+//pop item
+// returns NULL if ring is empty (only called by ring's worker)
+static void* ringPop(Ring* ring);
+
+//release an ES message
+static void releaseMessage(es_message_t* message);
+
+@interface EventQueue ()
+{
+    //rings
+    // one per worker
+    Ring* rings;
+
+    //number of rings/workers
+    NSUInteger count;
+
+    //flag
+    _Atomic(bool) running;
+
+    //producers (in enqueue)
+    // so stop can wait for them, before workers drain (and exit)
+    _Atomic(uint64_t) producers;
+
+    //counters
+    _Atomic(uint64_t) enqueued;
+    _Atomic(uint64_t) processed;
+    _Atomic(uint64_t) dropped;
+    _Atomic(uint64_t) backpressured;
+    _Atomic(uint64_t) overflowed;
+
+    //lock
+    // for overflow lists, and per-plugin drop counts
+    os_unfair_lock overflowLock;
+
+    //latency histogram
+    // enqueue to processed, bucketed by log2(microseconds)
+    _Atomic(uint64_t) latencies[EVENT_QUEUE_LATENCY_BUCKETS];
+
+    //max latency (nanoseconds)
+    _Atomic(uint64_t) maxLatency;
+
+    //start time
+    uint64_t started;
+}
+
+//worker wakeups
+// one semaphore per ring
+@property(nonatomic, retain)NSArray* wakeups;
+
+//worker handler
+@property(nonatomic, copy)EventQueueHandler handler;
+
+//workers
+// signaled (left) as each exits
+@property(nonatomic, retain)dispatch_group_t workers;
+
+//overflow lists
+// one per ring, for events that didn't fit
+@property(nonatomic, retain)NSArray<NSMutableArray*>* overflows;
+
+//drops
+// plugin (name) -> count
+@property(nonatomic, retain)NSMutableDictionary* drops;
+
+@end
+
+@implementation EventQueue
+
+@synthesize handler;
+@synthesize wakeups;
+@synthesize workers;
+@synthesize overflows;
+@synthesize drops;
+
+//init
+// alloc rings, and start a worker for each
+-(id)initWithWorkers:(NSUInteger)workerCount capacity:(NSUInteger)capacity handler:(EventQueueHandler)eventHandler
+{
+    //semaphores
+    NSMutableArray* semaphores = nil;
+
+    //overflow lists
+    NSMutableArray* lists = nil;
+
+    //init super
+    self = [super init];
+    if(nil == self)
+    {
+        //bail
+        goto bail;
+    }
+
+    //sanity check
+    // capacity must be a power of 2
+    if( (0 == workerCount) ||
+        (workerCount > EVENT_QUEUE_MAX_WORKERS) ||
+        (capacity < 2) ||
+        (0 != (capacity & (capacity - 1))) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: invalid event queue config (workers: %lu, capacity: %lu)", (unsigned long)workerCount, (unsigned long)capacity);
+
+        //unset
+        self = nil;
+
+        //bail
+        goto bail;
+    }
+
+    //save
+    count = workerCount;
+    self.handler = eventHandler;
+
+    //alloc rings
+    rings = calloc(count, sizeof(Ring));
+    if(NULL == rings)
+    {
+        //unset
+        self = nil;
+
+        //bail
+        goto bail;
+    }
+
+    //init rings
+    for(NSUInteger i = 0; i < count; i++)
+    {
+        //init
+        if(YES != ringInit(&rings[i], capacity))
+        {
+            //unset
+            self = nil;
+
+            //bail
+            goto bail;
+        }
+    }
+
+    //alloc wakeups
+    semaphores = [NSMutableArray array];
+    for(NSUInteger i = 0; i < count; i++)
+    {
+        //add
+        [semaphores addObject:dispatch_semaphore_create(0)];
+    }
+    self.wakeups = semaphores;
+
+    //alloc overflow lists
+    lists = [NSMutableArray array];
+    for(NSUInteger i = 0; i < count; i++)
+    {
+        //add
+        [lists addObject:[NSMutableArray array]];
+    }
+    self.overflows = lists;
+
+    //init
+    self.drops = [NSMutableDictionary dictionary];
+    overflowLock = OS_UNFAIR_LOCK_INIT;
+
+    //init
+    self.workers = dispatch_group_create();
+    started = mach_absolute_time();
+    atomic_store(&running, true);
+
+    //start workers
+    for(NSUInteger i = 0; i < count; i++)
+    {
+        //worker
+        NSThread* worker = [[NSThread alloc] initWithBlock:^{
+            [self work:i];
+        }];
+
+        //init
+        worker.name = [NSString stringWithFormat:@"event worker %lu", (unsigned long)i];
+        worker.qualityOfService = NSQualityOfServiceUserInitiated;
+
+        //start
+        dispatch_group_enter(self.workers);
+        [worker start];
+    }
+
+    //dbg msg
+    os_log_debug(logHandle, "started %lu event workers (capacity: %lu)", (unsigned long)count, (unsigned long)capacity);
+
+bail:
+
+    return self;
+}
+
+//dealloc
+// drain, then free rings (workers have all exited, as they retain self)
+-(void)dealloc
+{
+    //item
+    void* retainedItem = NULL;
+
+    //each ring
+    for(NSUInteger i = 0; (NULL != rings) && (i < count); i++)
+    {
+        //drain
+        // release any (still) queued items, and their messages
+        while(NULL != (retainedItem = ringPop(&rings[i])))
+        {
+            //release message
+            releaseMessage(((__bridge EventQueueItem*)retainedItem).message);
+
+            //release
+            CFBridgingRelease(retainedItem);
+        }
+
+        //free
+        free(rings[i].cells);
+    }
+
+    //drain overflow lists
+    for(NSMutableArray* list in self.overflows)
+    {
+        //release messages
+        for(EventQueueItem* item in list)
+        {
+            //release message
+            releaseMessage(item.message);
+        }
+    }
+
+    //free
+    free(rings);
+
+    return;
+}
+
+//add event
+// sharded by responsible process, so per-process order is kept
+-(BOOL)enqueue:(File*)file plugin:(PluginBase*)plugin message:(es_message_t*)message
+{
+    //flag
+    BOOL queued = NO;
+
+    //item
+    EventQueueItem* item = nil;
+
+    //retained item
+    void* retainedItem = NULL;
+
+    //shard key
+    pid_t key = 0;
+
+    //ring
+    Ring* ring = NULL;
+
+    //waited (microseconds)
+    NSUInteger waited = 0;
+
+    //shard
+    NSUInteger shard = 0;
+
+    //inc
+    // before checking if stopped, so stop (which unsets flag, then waits for producers) can't miss this event
+    atomic_fetch_add(&producers, 1);
+
+    //stopped?
+    if(true != atomic_load(&running))
+    {
+        //bail
+        goto bail;
+    }
+
+    //init item
+    item = [[EventQueueItem alloc] init];
+    item.file = file;
+    item.plugin = plugin;
+    item.message = message;
+    item.enqueued = mach_absolute_time();
+
+    //shard by responsible process
+    // ...or process, if it has none
+    key = (0 != file.process.rpid) ? file.process.rpid : file.process.pid;
+    shard = (NSUInteger)key % count;
+    ring = &rings[shard];
+
+    //ring has (older) events in its overflow list?
+    // append to that too, so this event isn't handled before them
+    if(0 != atomic_load(&ring->spilled))
+    {
+        //spill
+        [self spill:item shard:shard];
+
+        //done
+        goto pushed;
+    }
+
+    //retain
+    // ring now owns item
+    retainedItem = (void*)CFBridgingRetain(item);
+
+    //push
+    // full? wait (briefly) for space
+    while(YES != ringPush(ring, retainedItem))
+    {
+        //first time?
+        if(0 == waited)
+        {
+            //inc
+            atomic_fetch_add_explicit(&backpressured, 1, memory_order_relaxed);
+        }
+
+        //stopped?
+        if(true != atomic_load(&running))
+        {
+            //release
+            CFBridgingRelease(retainedItem);
+
+            //bail
+            goto bail;
+        }
+
+        //waited too long?
+        // spill event (if it matched a plugin), else drop it
+        if(waited >= EVENT_QUEUE_BACKPRESSURE_WAIT)
+        {
+            //release
+            // overflow list (or no one) now owns item
+            CFBridgingRelease(retainedItem);
+
+            //no plugin?
+            if(nil == plugin)
+            {
+                //bail
+                goto bail;
+            }
+
+            //spill
+            [self spill:item shard:shard];
+
+            //done
+            goto pushed;
+        }
+
+        //wait
+        usleep(50);
+        waited += 50;
+    }
+
+pushed:
+
+    //inc
+    atomic_fetch_add_explicit(&enqueued, 1, memory_order_relaxed);
+
+    //wake worker
+    dispatch_semaphore_signal(self.wakeups[shard]);
+
+    //happy
+    queued = YES;
+
+bail:
+
+    //dropped?
+    if(YES != queued)
+    {
+        //drop
+        [self drop:file plugin:plugin message:message];
+    }
+
+    //dec
+    atomic_fetch_sub(&producers, 1);
+
+    return queued;
+}
+
+//worker
+// pop and handle events from its ring, until stopped
+-(void)work:(NSUInteger)index
+{
+    //wakeup
+    dispatch_semaphore_t wakeup = self.wakeups[index];
+
+    while(YES)
+    {
+        @autoreleasepool
+        {
+            //item
+            EventQueueItem* item = nil;
+
+            //latency
+            uint64_t latency = 0;
+
+            //pop
+            item = [self pop:index];
+
+            //empty?
+            if(nil == item)
+            {
+                //stopped, and no (in-flight) producers?
+                // pop once more (as a producer may have pushed, since), then exit if (still) empty
+                if( (true != atomic_load(&running)) &&
+                    (0 == atomic_load(&producers)) )
+                {
+                    //pop
+                    item = [self pop:index];
+                    if(nil == item) break;
+                }
+                //wait
+                else
+                {
+                    //wait
+                    dispatch_semaphore_wait(wakeup, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC));
+                    continue;
+                }
+            }
+
+            //stopped?
+            // drop event
+            if(true != atomic_load(&running))
+            {
+                //drop
+                [self drop:item.file plugin:item.plugin message:item.message];
+
+                continue;
+            }
+
+            //handle
+            self.handler(item.file, item.plugin, item.message);
+
+            //latency
+            latency = machTimeToNanoseconds(mach_absolute_time() - item.enqueued);
+
+            //add to histogram
+            atomic_fetch_add_explicit(&latencies[MIN((NSUInteger)(flsll((long long)(latency/NSEC_PER_USEC))), EVENT_QUEUE_LATENCY_BUCKETS-1)], 1, memory_order_relaxed);
+
+            //update max
+            for(uint64_t max = atomic_load_explicit(&maxLatency, memory_order_relaxed); latency > max; )
+            {
+                if(atomic_compare_exchange_weak_explicit(&maxLatency, &max, latency, memory_order_relaxed, memory_order_relaxed)) break;
+            }
+
+            //inc
+            atomic_fetch_add_explicit(&processed, 1, memory_order_relaxed);
+        }
+    }
+
+    //done
+    dispatch_group_leave(self.workers);
+
+    return;
+}
+
+//pop item
+// from ring, then (once it's empty) from its overflow list
+-(EventQueueItem*)pop:(NSUInteger)index
+{
+    //item
+    EventQueueItem* item = nil;
+
+    //retained item
+    void* retainedItem = NULL;
+
+    //overflow list
+    NSMutableArray* list = nil;
+
+    //pop from ring
+    retainedItem = ringPop(&rings[index]);
+    if(NULL != retainedItem)
+    {
+        //take ownership
+        item = CFBridgingRelease(retainedItem);
+
+        //done
+        goto bail;
+    }
+
+    //nothing spilled?
+    if(0 == atomic_load(&rings[index].spilled))
+    {
+        //bail
+        goto bail;
+    }
+
+    //list
+    list = self.overflows[index];
+
+    //lock
+    os_unfair_lock_lock(&overflowLock);
+
+    //pop from overflow list
+    // oldest first
+    item = list.firstObject;
+    if(nil != item)
+    {
+        //remove
+        [list removeObjectAtIndex:0];
+
+        //dec
+        atomic_fetch_sub(&rings[index].spilled, 1);
+    }
+
+    //unlock
+    os_unfair_lock_unlock(&overflowLock);
+
+bail:
+
+    return item;
+}
+
+//spill item
+// append to (unbounded) overflow list of ring, for its worker to drain
+-(void)spill:(EventQueueItem*)item shard:(NSUInteger)shard
+{
+    //lock
+    os_unfair_lock_lock(&overflowLock);
+
+    //add
+    [self.overflows[shard] addObject:item];
+
+    //inc
+    // under lock, so worker never sees count without item
+    atomic_fetch_add(&rings[shard].spilled, 1);
+
+    //unlock
+    os_unfair_lock_unlock(&overflowLock);
+
+    //inc
+    atomic_fetch_add_explicit(&overflowed, 1, memory_order_relaxed);
+
+    return;
+}
+
+//drop event
+// log, count (per plugin), and release its message
+-(void)drop:(File*)file plugin:(PluginBase*)plugin message:(es_message_t*)message
+{
+    //name
+    NSString* name = (nil != plugin) ? NSStringFromClass(plugin.class) : @"none";
+
+    //inc
+    atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+
+    //lock
+    os_unfair_lock_lock(&overflowLock);
+
+    //inc
+    self.drops[name] = @([self.drops[name] unsignedLongLongValue] + 1);
+
+    //unlock
+    os_unfair_lock_unlock(&overflowLock);
+
+    //err msg
+    os_log_error(logHandle, "ERROR: event queue %{public}s, dropped event for %{public}@ (plugin: %{public}@)", (true != atomic_load(&running)) ? "stopped" : "full", file.destinationPath, name);
+
+    //release message
+    releaseMessage(message);
+
+    return;
+}
+
+//stop workers
+// rejects new events, and any still queued are dropped (their messages released)
+-(void)stop
+{
+    //unset
+    // new enqueues are now rejected
+    atomic_store(&running, false);
+
+    //wait for (in-flight) producers
+    // so nothing's pushed once workers have drained their rings and exited
+    while(0 != atomic_load(&producers))
+    {
+        //wait
+        usleep(50);
+    }
+
+    //wake all
+    for(dispatch_semaphore_t wakeup in self.wakeups)
+    {
+        //wake
+        dispatch_semaphore_signal(wakeup);
+    }
+
+    //wait (a bit) for workers
+    // any busy worker will exit once its current event is done
+    if(0 != dispatch_group_wait(self.workers, dispatch_time(DISPATCH_TIME_NOW, 2 * NSEC_PER_SEC)))
+    {
+        //dbg msg
+        os_log_debug(logHandle, "timed out waiting for event workers to exit");
+    }
+
+    return;
+}
+
+//stats
+// counters, depth, throughput & latency
+-(NSDictionary*)stats
+{
+    //depth
+    size_t depth = 0;
+
+    //high water
+    size_t highWater = 0;
+
+    //total (in histogram)
+    uint64_t total = 0;
+
+    //buckets
+    uint64_t buckets[EVENT_QUEUE_LATENCY_BUCKETS] = {0};
+
+    //percentiles
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+
+    //running total
+    uint64_t seen = 0;
+
+    //elapsed (seconds)
+    double elapsed = 0;
+
+    //spilled
+    size_t spilled = 0;
+
+    //drops (per plugin)
+    NSDictionary* pluginDrops = nil;
+
+    //depth / high water
+    for(NSUInteger i = 0; i < count; i++)
+    {
+        //add
+        depth += atomic_load(&rings[i].enqueuePos) - atomic_load(&rings[i].dequeuePos);
+        highWater = MAX(highWater, atomic_load(&rings[i].highWater));
+        spilled += atomic_load(&rings[i].spilled);
+    }
+
+    //copy drops
+    os_unfair_lock_lock(&overflowLock);
+    pluginDrops = [self.drops copy];
+    os_unfair_lock_unlock(&overflowLock);
+
+    //copy histogram
+    for(NSUInteger i = 0; i < EVENT_QUEUE_LATENCY_BUCKETS; i++)
+    {
+        buckets[i] = atomic_load_explicit(&latencies[i], memory_order_relaxed);
+        total += buckets[i];
+    }
+
+    //percentiles
+    // upper bound of bucket (microseconds)
+    for(NSUInteger i = 0; i < EVENT_QUEUE_LATENCY_BUCKETS; i++)
+    {
+        seen += buckets[i];
+
+        if( (0 == p50) && (seen * 2 >= total) && (0 != total) ) p50 = 1ULL << i;
+        if( (0 == p99) && (seen * 100 >= total * 99) && (0 != total) ) p99 = 1ULL << i;
+    }
+
+    //elapsed
+    elapsed = (double)machTimeToNanoseconds(mach_absolute_time() - started) / NSEC_PER_SEC;
+
+    return @{@"workers":@(count),
+             @"enqueued":@(atomic_load(&enqueued)),
+             @"processed":@(atomic_load(&processed)),
+             @"dropped":@(atomic_load(&dropped)),
+             @"dropped (per plugin)":pluginDrops,
+             @"backpressured":@(atomic_load(&backpressured)),
+             @"overflowed":@(atomic_load(&overflowed)),
+             @"depth":@(depth),
+             @"depth (overflow)":@(spilled),
+             @"high water":@(highWater),
+             @"throughput (events/sec)":@((elapsed > 0) ? atomic_load(&processed)/elapsed : 0),
+             @"latency p50 (us)":@(p50),
+             @"latency p99 (us)":@(p99),
+             @"latency max (us)":@(atomic_load(&maxLatency)/NSEC_PER_USEC)};
+}
+
+@end
+
+//init ring
+// each cell's sequence starts as its index (i.e. free)
+static BOOL ringInit(Ring* ring, size_t capacity)
+{
+    //alloc
+    ring->cells = calloc(capacity, sizeof(RingCell));
+    if(NULL == ring->cells) return NO;
+
+    //init cells
+    for(size_t i = 0; i < capacity; i++)
+    {
+        atomic_init(&ring->cells[i].sequence, i);
+    }
+
+    //init
+    ring->mask = capacity - 1;
+    atomic_init(&ring->enqueuePos, 0);
+    atomic_init(&ring->dequeuePos, 0);
+    atomic_init(&ring->highWater, 0);
+    atomic_init(&ring->spilled, 0);
+
+    return YES;
+}
+
+//push item
+// claim a (free) cell by advancing enqueue position, then publish item via its sequence
+static BOOL ringPush(Ring* ring, void* item)
+{
+    //cell
+    RingCell* cell = NULL;
+
+    //position
+    size_t position = atomic_load_explicit(&ring->enqueuePos, memory_order_relaxed);
+
+    //depth
+    size_t depth = 0;
+
+    while(YES)
+    {
+        //cell
+        cell = &ring->cells[position & ring->mask];
+
+        //sequence vs position
+        intptr_t difference = (intptr_t)atomic_load_explicit(&cell->sequence, memory_order_acquire) - (intptr_t)position;
+
+        //free?
+        // try claim it
+        if(0 == difference)
+        {
+            if(atomic_compare_exchange_weak_explicit(&ring->enqueuePos, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        }
+        //full
+        else if(difference < 0)
+        {
+            return NO;
+        }
+        //another producer claimed it
+        // reload, and retry
+        else
+        {
+            position = atomic_load_explicit(&ring->enqueuePos, memory_order_relaxed);
+        }
+    }
+
+    //save
+    cell->item = item;
+
+    //publish
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+
+    //update high water
+    depth = position + 1 - atomic_load_explicit(&ring->dequeuePos, memory_order_relaxed);
+    for(size_t max = atomic_load_explicit(&ring->highWater, memory_order_relaxed); depth > max; )
+    {
+        if(atomic_compare_exchange_weak_explicit(&ring->highWater, &max, depth, memory_order_relaxed, memory_order_relaxed)) break;
+    }
+
+    return YES;
+}
+
+//pop item
+// single consumer, so no need to claim; just mark cell free for the next lap
+static void* ringPop(Ring* ring)
+{
+    //item
+    void* item = NULL;
+
+    //position
+    size_t position = atomic_load_explicit(&ring->dequeuePos, memory_order_relaxed);
+
+    //cell
+    RingCell* cell = &ring->cells[position & ring->mask];
+
+    //not (yet) published?
+    if((intptr_t)atomic_load_explicit(&cell->sequence, memory_order_acquire) - (intptr_t)(position + 1) < 0)
+    {
+        return NULL;
+    }
+
+    //grab
+    item = cell->item;
+    cell->item = NULL;
+
+    //free cell
+    atomic_store_explicit(&cell->sequence, position + ring->mask + 1, memory_order_release);
+
+    //advance
+    atomic_store_explicit(&ring->dequeuePos, position + 1, memory_order_relaxed);
+
+    return item;
+}
+
+//release an ES message
+static void releaseMessage(es_message_t* message)
+{
+    //sanity check
+    if(NULL == message) return;
+
+    //release message
+    if(@available(macOS 11.0, *))
+    {
+        //release
+        es_release_message(message);
+    }
+    //free message
+    else
+    {
+        //free
+        es_free_message(message);
+    }
+
+    return;
+}
@@ -24,6 +24,10 @@
 //shown events
 @property(nonatomic, retain)NSMutableDictionary* reportedEvents;
 
+//shown events, by relation fingerprint
+// key: fingerprint, value: array of (shown) events
+@property(nonatomic, retain)NSMutableDictionary* relatedEvents;
+
 //related alerts
 //@property(nonatomic, retain)NSMutableDictionary* relatedAlerts;
 
@@ -29,6 +29,7 @@ XPCUserClient* xpcUserClient;
 
 @synthesize consoleUser;
 @synthesize userObserver;
+@synthesize relatedEvents;
 @synthesize reportedEvents;
 @synthesize undelivertedAlerts;
 
@@ -42,6 +43,9 @@ XPCUserClient* xpcUserClient;
         //alloc shown
         reportedEvents = [NSMutableDictionary dictionary];
         
+        //alloc shown (by fingerprint)
+        relatedEvents = [NSMutableDictionary dictionary];
+        
         //alloc undelivered
         undelivertedAlerts = [NSMutableDictionary dictionary];
         
@@ -72,11 +76,29 @@ XPCUserClient* xpcUserClient;
     //dbg msg
     os_log_debug(logHandle, "adding alert to 'shown': %{public}@", event);
     
+    //fingerprint
+    NSUInteger fingerprint = event.fingerprint;
+    
     //add alert
     @synchronized(self.reportedEvents)
     {
         //add
         self.reportedEvents[event.uuid] = event;
+        
+        //can be related?
+        // add by fingerprint too
+        if(0 != fingerprint)
+        {
+            //init
+            if(nil == self.relatedEvents[@(fingerprint)])
+            {
+                //init
+                self.relatedEvents[@(fingerprint)] = [NSMutableArray array];
+            }
+            
+            //add
+            [self.relatedEvents[@(fingerprint)] addObject:event];
+        }
     }
     
     return;
@@ -88,38 +110,62 @@ XPCUserClient* xpcUserClient;
     //dbg msg
     os_log_debug(logHandle, "removing alert from 'shown': %{public}@", event);
     
+    //fingerprint
+    NSUInteger fingerprint = event.fingerprint;
+    
     //remove alert
     @synchronized(self.reportedEvents)
     {
         //remove
         self.reportedEvents[event.uuid] = nil;
+        
+        //remove by fingerprint too
+        // note: by identity, as other (related) events share its fingerprint
+        [self.relatedEvents[@(fingerprint)] removeObjectIdenticalTo:event];
+        
+        //last one?
+        if(0 == [self.relatedEvents[@(fingerprint)] count])
+        {
+            //remove
+            [self.relatedEvents removeObjectForKey:@(fingerprint)];
+        }
     }
     
     return;
 }
 
 //check if (possibly related) alert was already shown
+// only checks shown events w/ same fingerprint, so O(1)
 -(BOOL)wasShown:(Event*)event
 {
     //flag
-    __block BOOL shown = NO;
+    BOOL shown = NO;
+    
+    //fingerprint
+    NSUInteger fingerprint = 0;
+    
+    //fingerprint
+    // 0 means event can't be related to any
+    fingerprint = event.fingerprint;
+    if(0 == fingerprint) goto bail;
     
     //sync to check
     @synchronized(self.reportedEvents)
     {
         //any matches?
-        [self.reportedEvents enumerateKeysAndObjectsUsingBlock:^(NSString* key, Event* shownEvent, BOOL *stop)
+        // note: still check each, as fingerprints may collide
+        for(Event* shownEvent in self.relatedEvents[@(fingerprint)])
         {
             //related?
             if(YES == [event isRelated:shownEvent includeTime:NO])
             {
                 //got match
                 shown = YES;
-                    
+                
                 //done
-                *stop = YES;
+                break;
             }
-        }];
+        }
     }
 
 bail:
@@ -0,0 +1,53 @@
+//
+//  file: FileReadiness.h
+//  project: BlockBlock (launch daemon)
+//  description: parks events till a file they need is ready (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+#ifndef FileReadiness_h
+#define FileReadiness_h
+
+@import Foundation;
+
+/* CONSTS */
+
+//default timeout (seconds)
+// how long an event is parked, waiting for its file
+#define FILE_READINESS_TIMEOUT 1.0
+
+/* TYPEDEFS */
+
+//block for (parked) waiters
+// ready: file event seen (vs. timed out)
+typedef void (^FileReadinessHandler)(BOOL ready);
+
+@interface FileReadiness : NSObject
+
+/* METHODS */
+
+//wait for file
+// parks handler (w/o blocking a thread) till file is created/written/renamed, or timeout
+-(void)wait:(NSString* _Nonnull)path timeout:(NSTimeInterval)timeout handler:(FileReadinessHandler _Nonnull)handler;
+
+//any waiters?
+// cheap, so file events can skip creating paths
+-(BOOL)isWaiting;
+
+//file event (create/close/rename) seen for path
+// resumes any waiters
+-(void)ready:(NSString* _Nonnull)path;
+
+//stop
+// resumes all waiters (as not ready) now, as will any later waits, then waits (a bit) for their handlers
+-(void)stop;
+
+//stats
+// parked, resumed, timed out, and stall time
+-(NSDictionary* _Nonnull)stats;
+
+@end
+
+#endif /* FileReadiness_h */
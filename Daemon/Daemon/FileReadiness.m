@@ -0,0 +1,311 @@
+//
+//  file: FileReadiness.m
+//  project: BlockBlock (launch daemon)
+//  description: parks events till a file they need is ready
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+//  some items (e.g. a launch item's plist, or a kext's Info.plist) may not be (fully) written
+//  when the event for them arrives. vs. sleep-polling on an event worker, which stalls every
+//  event behind it, such events are parked here, and resumed (on another queue) as soon as a
+//  file event (create/close/rename) for the path is seen, or the timeout fires.
+
+@import OSLog;
+
+#import <stdatomic.h>
+#import <mach/mach_time.h>
+
+#import "utilities.h"
+#import "FileReadiness.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+/* OBJECT: WAITER */
+
+@interface FileWaiter : NSObject
+
+//handler
+@property(nonatomic, copy)FileReadinessHandler handler;
+
+//when parked
+@property uint64_t parked;
+
+@end
+
+@implementation FileWaiter
+
+@synthesize parked;
+@synthesize handler;
+
+@end
+
+/* OBJECT: READINESS */
+
+@interface FileReadiness ()
+{
+    //number of waiters
+    _Atomic(uint64_t) waiting;
+    
+    //counters
+    uint64_t parkedCount;
+    uint64_t resumed;
+    uint64_t timedOut;
+    
+    //stall time (nanoseconds)
+    uint64_t stallTime;
+    uint64_t maxStallTime;
+    
+    //stopped?
+    BOOL stopped;
+}
+
+//waiters
+// key: path
+@property(nonatomic, retain)NSMutableDictionary<NSString*, NSMutableArray<FileWaiter*>*>* waiters;
+
+//queue
+// (serial) for waiters & timeouts
+@property(nonatomic, retain)dispatch_queue_t queue;
+
+//handlers
+// (invoked) that are still running
+@property(nonatomic, retain)dispatch_group_t handlers;
+
+@end
+
+@implementation FileReadiness
+
+@synthesize queue;
+@synthesize waiters;
+@synthesize handlers;
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //alloc
+        waiters = [NSMutableDictionary dictionary];
+        
+        //init queue
+        queue = dispatch_queue_create("com.objective-see.blockblock.readiness", DISPATCH_QUEUE_SERIAL);
+        
+        //init handlers
+        handlers = dispatch_group_create();
+    }
+    
+    return self;
+}
+
+//wait for file
+// parks handler till file is ready, or timeout
+-(void)wait:(NSString*)path timeout:(NSTimeInterval)timeout handler:(FileReadinessHandler)handler
+{
+    //waiter
+    FileWaiter* waiter = nil;
+    
+    //flag
+    __block BOOL parked = NO;
+    
+    //init
+    waiter = [[FileWaiter alloc] init];
+    waiter.handler = handler;
+    waiter.parked = mach_absolute_time();
+    
+    //park
+    dispatch_sync(self.queue, ^{
+        
+        //stopped?
+        // don't park
+        if(YES == self->stopped) return;
+        
+        //first for path?
+        if(nil == self.waiters[path])
+        {
+            //alloc
+            self.waiters[path] = [NSMutableArray array];
+        }
+        
+        //add
+        [self.waiters[path] addObject:waiter];
+        
+        //inc
+        self->parkedCount++;
+        atomic_fetch_add_explicit(&self->waiting, 1, memory_order_relaxed);
+        
+        //set
+        parked = YES;
+    });
+    
+    //not parked (as stopped)?
+    // invoke handler now, as not ready
+    if(YES != parked)
+    {
+        //invoke
+        handler(NO);
+        
+        return;
+    }
+    
+    //dbg msg
+    os_log_debug(logHandle, "parked event, till %{public}@ is ready (timeout: %f seconds)", path, timeout);
+    
+    //timeout
+    // (still parked?) resume, though file isn't ready
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC)), self.queue, ^{
+        
+        //still parked?
+        if(YES == [self.waiters[path] containsObject:waiter])
+        {
+            //inc
+            self->timedOut++;
+            
+            //resume
+            [self resume:waiter path:path ready:NO];
+        }
+    });
+    
+    //file (now) exists?
+    // e.g. created between caller's check and parking, so resume now
+    if(YES == [NSFileManager.defaultManager fileExistsAtPath:path])
+    {
+        //ready
+        [self ready:path];
+    }
+    
+    return;
+}
+
+//any waiters?
+-(BOOL)isWaiting
+{
+    return (0 != atomic_load_explicit(&waiting, memory_order_relaxed));
+}
+
+//file event seen for path
+// resume all its waiters
+-(void)ready:(NSString*)path
+{
+    //nothing parked?
+    if(YES != [self isWaiting]) return;
+    
+    //resume
+    dispatch_async(self.queue, ^{
+        
+        //resume each
+        for(FileWaiter* waiter in [self.waiters[path] copy])
+        {
+            //inc
+            self->resumed++;
+            
+            //resume
+            [self resume:waiter path:path ready:YES];
+        }
+    });
+    
+    return;
+}
+
+//resume a waiter
+// remove it, then invoke its handler (on another queue, as it may block)
+// note: called on (serial) queue
+-(void)resume:(FileWaiter*)waiter path:(NSString*)path ready:(BOOL)ready
+{
+    //stall time
+    uint64_t stall = 0;
+    
+    //remove
+    [self.waiters[path] removeObject:waiter];
+    if(0 == self.waiters[path].count)
+    {
+        //remove
+        [self.waiters removeObjectForKey:path];
+    }
+    
+    //dec
+    atomic_fetch_sub_explicit(&waiting, 1, memory_order_relaxed);
+    
+    //stall time
+    stall = machTimeToNanoseconds(mach_absolute_time() - waiter.parked);
+    stallTime += stall;
+    maxStallTime = MAX(maxStallTime, stall);
+    
+    //dbg msg
+    os_log_debug(logHandle, "resuming event for %{public}@ (ready: %d, after %llu ms)", path, ready, stall / NSEC_PER_MSEC);
+    
+    //invoke handler
+    // tracked, so stop can wait for it
+    dispatch_group_async(self.handlers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        
+        @autoreleasepool
+        {
+            //invoke
+            waiter.handler(ready);
+        }
+    });
+    
+    return;
+}
+
+//stop
+// resume all waiters (as not ready), then wait (a bit) for their handlers
+-(void)stop
+{
+    //resume all
+    dispatch_sync(self.queue, ^{
+        
+        //set
+        self->stopped = YES;
+        
+        //each path
+        for(NSString* path in self.waiters.allKeys)
+        {
+            //each waiter
+            for(FileWaiter* waiter in [self.waiters[path] copy])
+            {
+                //resume
+                [self resume:waiter path:path ready:NO];
+            }
+        }
+    });
+    
+    //wait (a bit) for handlers
+    if(0 != dispatch_group_wait(self.handlers, dispatch_time(DISPATCH_TIME_NOW, 2 * NSEC_PER_SEC)))
+    {
+        //dbg msg
+        os_log_debug(logHandle, "timed out waiting for (file readiness) handlers");
+    }
+    
+    return;
+}
+
+//stats
+// parked, resumed, timed out, and stall time
+-(NSDictionary*)stats
+{
+    //stats
+    __block NSDictionary* stats = nil;
+    
+    //sync
+    dispatch_sync(self.queue, ^{
+        
+        //init
+        stats = @{@"parked":@(self->parkedCount),
+                  @"waiting":@(atomic_load(&self->waiting)),
+                  @"resumed (ready)":@(self->resumed),
+                  @"resumed (timed out)":@(self->timedOut),
+                  @"stall (avg, ms)":@((0 != self->resumed + self->timedOut) ? (self->stallTime / (self->resumed + self->timedOut) / NSEC_PER_MSEC) : 0),
+                  @"stall (max, ms)":@(self->maxStallTime / NSEC_PER_MSEC)};
+    });
+    
+    return stats;
+}
+
+@end
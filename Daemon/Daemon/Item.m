@@ -21,11 +21,9 @@
     self = [super init];
     if(self)
     {
-        //set name
-        self.name = [event.plugin itemName:event];
-        
-        //set item
-        self.object = [event.plugin itemObject:event];
+        //set name & item
+        // via plugin, which can resolve both at once
+        [event.plugin resolveItem:self event:event];
     }
     
     return self;
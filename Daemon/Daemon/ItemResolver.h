@@ -0,0 +1,55 @@
+//
+//  file: ItemResolver.h
+//  project: BlockBlock (launch daemon)
+//  description: resolves (startup) items of events, async on a bounded executor (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+#ifndef ItemResolver_h
+#define ItemResolver_h
+
+@import Foundation;
+
+@class Event;
+
+/* CONSTS */
+
+//max number of workers
+#define ITEM_RESOLVER_MAX_WORKERS 4
+
+//max number of queued events
+// once reached, callers block (till there's room), applying backpressure to the event queue
+#define ITEM_RESOLVER_MAX_QUEUED 1024
+
+/* TYPEDEFS */
+
+//block for resolved events
+typedef void (^ItemResolverHandler)(Event* _Nonnull event);
+
+@interface ItemResolver : NSObject
+
+/* METHODS */
+
+//init
+// workers: max number of items resolved at once
+-(id _Nonnull)initWithWorkers:(NSUInteger)workers;
+
+//resolve event's item
+// queued till a worker is free, then handler is invoked (on worker) once resolved
+// note: events of the same (responsible) process are resolved/handled one at a time, in order
+// blocks while ITEM_RESOLVER_MAX_QUEUED events are queued, returns NO (and doesn't queue event) if stopped
+-(BOOL)resolve:(Event* _Nonnull)event handler:(ItemResolverHandler _Nonnull)handler;
+
+//stop
+// rejects new events, waits (a bit) for running ones, and returns (unresolved) queued ones
+-(NSArray<Event*>* _Nonnull)stop;
+
+//stats
+// queued, resolved, and (per plugin) latency
+-(NSDictionary* _Nonnull)stats;
+
+@end
+
+#endif /* ItemResolver_h */
@@ -0,0 +1,513 @@
+//
+//  file: ItemResolver.m
+//  project: BlockBlock (launch daemon)
+//  description: resolves (startup) items of events, async on a bounded executor
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+//  resolving an event's item calls into its plugin (e.g. to parse a launch item's plist), which
+//  may be slow. so event workers hand events off here, and move on. a bounded number of events
+//  are resolved at once (others are queued, w/o blocking a thread), and each then continues (to
+//  rule lookup, delivery, etc) via its handler. latency of resolving is tracked per plugin.
+//
+//  events from the same (responsible) process are resolved and continued one at a time, in order,
+//  as the event queue sharded them to keep that order (e.g. so a burst is coalesced, not alerted twice)
+//  thus each process has its own FIFO, and processes w/ queued (but no running) work are in a ready
+//  list, so starting the next work is O(1), no matter how many are queued behind a busy process
+//
+//  the number of queued events is capped. once reached, callers (event workers) block till there's
+//  room, so a flood backs up into the event queue, rather than growing (unbounded) here
+
+@import OSLog;
+
+#import <os/lock.h>
+#import <mach/mach_time.h>
+
+#import "Event.h"
+#import "utilities.h"
+#import "PluginBase.h"
+#import "ItemResolver.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+/* OBJECT: WORK */
+
+@interface ItemResolverWork : NSObject
+
+//event
+@property(nonatomic, retain)Event* event;
+
+//handler
+@property(nonatomic, copy)ItemResolverHandler handler;
+
+//when queued
+@property uint64_t queued;
+
+//key
+// (responsible) process, for ordering
+@property(nonatomic, retain)NSNumber* key;
+
+@end
+
+@implementation ItemResolverWork
+
+@synthesize key;
+@synthesize event;
+@synthesize queued;
+@synthesize handler;
+
+@end
+
+/* OBJECT: RESOLVER */
+
+@interface ItemResolver ()
+{
+    //lock
+    os_unfair_lock lock;
+    
+    //workers
+    NSUInteger workers;
+    
+    //running
+    NSUInteger running;
+    
+    //counters
+    uint64_t submitted;
+    uint64_t resolved;
+    
+    //queued
+    NSUInteger queued;
+    
+    //max queued
+    NSUInteger maxQueued;
+    
+    //times callers were blocked (queue full)
+    uint64_t backpressured;
+    
+    //time spent queued (nanoseconds)
+    uint64_t queuedTime;
+    
+    //stopped?
+    BOOL stopped;
+}
+
+//pending work
+// key: (responsible) process, value: its FIFO of work waiting for a worker (or for its prior work)
+// note: entry exists while process has any queued or running work
+@property(nonatomic, retain)NSMutableDictionary<NSNumber*, NSMutableArray<ItemResolverWork*>*>* pending;
+
+//ready processes
+// FIFO of keys w/ queued work, but none running (so next work can start)
+@property(nonatomic, retain)NSMutableArray<NSNumber*>* ready;
+
+//keys of running work
+// one at a time per (responsible) process, so its events stay in order
+@property(nonatomic, retain)NSMutableSet<NSNumber*>* busy;
+
+//free slots
+// in (capped) queue, callers wait on this when it's full
+@property(nonatomic, retain)dispatch_semaphore_t slots;
+
+//(per plugin) latency
+// key: plugin class, value: @[count, total (ns), max (ns)]
+@property(nonatomic, retain)NSMutableDictionary<NSString*, NSArray<NSNumber*>*>* latencies;
+
+//queue
+// (concurrent) for workers
+@property(nonatomic, retain)dispatch_queue_t queue;
+
+//running work
+// so stop can wait for it
+@property(nonatomic, retain)dispatch_group_t group;
+
+@end
+
+@implementation ItemResolver
+
+@synthesize busy;
+@synthesize ready;
+@synthesize slots;
+@synthesize group;
+@synthesize queue;
+@synthesize pending;
+@synthesize latencies;
+
+//init
+-(id)initWithWorkers:(NSUInteger)count
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init
+        lock = OS_UNFAIR_LOCK_INIT;
+        workers = MIN(MAX(count, 1), ITEM_RESOLVER_MAX_WORKERS);
+        
+        //alloc
+        pending = [NSMutableDictionary dictionary];
+        ready = [NSMutableArray array];
+        busy = [NSMutableSet set];
+        slots = dispatch_semaphore_create(ITEM_RESOLVER_MAX_QUEUED);
+        latencies = [NSMutableDictionary dictionary];
+        
+        //init queue
+        queue = dispatch_queue_create("com.objective-see.blockblock.resolver", DISPATCH_QUEUE_CONCURRENT);
+        
+        //init group
+        group = dispatch_group_create();
+    }
+    
+    return self;
+}
+
+//resolve event's item
+// (once there's room) queue, then start a worker, if one's free
+-(BOOL)resolve:(Event*)event handler:(ItemResolverHandler)handler
+{
+    //flag
+    BOOL added = NO;
+    
+    //flag
+    BOOL stopping = NO;
+    
+    //work
+    ItemResolverWork* work = nil;
+    
+    //process' work
+    NSMutableArray* fifo = nil;
+    
+    //full?
+    // block (checking if stopped) till there's room
+    if(0 != dispatch_semaphore_wait(self.slots, DISPATCH_TIME_NOW))
+    {
+        //lock
+        os_unfair_lock_lock(&lock);
+        
+        //inc
+        backpressured++;
+        
+        //unlock
+        os_unfair_lock_unlock(&lock);
+        
+        //err msg
+        os_log_error(logHandle, "ERROR: item resolver is saturated (%d events queued), blocking", ITEM_RESOLVER_MAX_QUEUED);
+        
+        //wait
+        while(0 != dispatch_semaphore_wait(self.slots, dispatch_time(DISPATCH_TIME_NOW, 100 * NSEC_PER_MSEC)))
+        {
+            //lock
+            os_unfair_lock_lock(&lock);
+            
+            //stopped?
+            stopping = stopped;
+            
+            //unlock
+            os_unfair_lock_unlock(&lock);
+            
+            //stopped?
+            if(YES == stopping) return NO;
+        }
+    }
+    
+    //init
+    work = [[ItemResolverWork alloc] init];
+    work.event = event;
+    work.handler = handler;
+    work.queued = mach_absolute_time();
+    work.key = @((0 != event.process.rpid) ? event.process.rpid : event.process.pid);
+    
+    //lock
+    os_unfair_lock_lock(&lock);
+    
+    //not stopped?
+    // add to process' FIFO
+    if(YES != stopped)
+    {
+        //process' FIFO
+        fifo = self.pending[work.key];
+        
+        //new?
+        // process is now ready (as it has nothing running)
+        if(nil == fifo)
+        {
+            //alloc/add
+            fifo = [NSMutableArray array];
+            self.pending[work.key] = fifo;
+            
+            //ready
+            [self.ready addObject:work.key];
+        }
+        
+        //add
+        [fifo addObject:work];
+        
+        //inc
+        submitted++;
+        queued++;
+        
+        //max?
+        maxQueued = MAX(maxQueued, queued);
+        
+        //set
+        added = YES;
+    }
+    
+    //unlock
+    os_unfair_lock_unlock(&lock);
+    
+    //not added?
+    // give back slot
+    if(YES != added)
+    {
+        //signal
+        dispatch_semaphore_signal(self.slots);
+    }
+    
+    //start worker
+    if(YES == added) [self next];
+    
+    return added;
+}
+
+//stop
+// reject new events, and (once running work is done) return queued ones
+-(NSArray<Event*>*)stop
+{
+    //events
+    NSMutableArray<Event*>* events = nil;
+    
+    //alloc
+    events = [NSMutableArray array];
+    
+    //lock
+    os_unfair_lock_lock(&lock);
+    
+    //set
+    stopped = YES;
+    
+    //grab queued events
+    for(NSNumber* key in self.pending)
+    {
+        //each
+        for(ItemResolverWork* work in self.pending[key])
+        {
+            //add
+            [events addObject:work.event];
+        }
+    }
+    
+    //clear
+    // note: keys of running work are kept, as their workers remove them
+    for(NSNumber* key in self.pending.allKeys)
+    {
+        //remove
+        if(YES == [self.busy containsObject:key]) [self.pending[key] removeAllObjects];
+        else [self.pending removeObjectForKey:key];
+    }
+    [self.ready removeAllObjects];
+    queued = 0;
+    
+    //unlock
+    os_unfair_lock_unlock(&lock);
+    
+    //give back slots
+    for(NSUInteger i = 0; i < events.count; i++)
+    {
+        //signal
+        dispatch_semaphore_signal(self.slots);
+    }
+    
+    //wait (a bit) for running work
+    if(0 != dispatch_group_wait(self.group, dispatch_time(DISPATCH_TIME_NOW, 2 * NSEC_PER_SEC)))
+    {
+        //dbg msg
+        os_log_debug(logHandle, "timed out waiting for (item resolver) workers");
+    }
+    
+    return events;
+}
+
+//start next work
+// while there's a ready process (i.e. w/ none running), and a worker is free
+-(void)next
+{
+    //work
+    ItemResolverWork* work = nil;
+    
+    //key
+    NSNumber* key = nil;
+    
+    while(YES)
+    {
+        //reset
+        work = nil;
+        
+        //lock
+        os_unfair_lock_lock(&lock);
+        
+        //worker free, and a process is ready?
+        // take oldest work of (first) ready process
+        if( (running < workers) &&
+            (0 != self.ready.count) )
+        {
+            //pop key
+            key = self.ready.firstObject;
+            [self.ready removeObjectAtIndex:0];
+            
+            //pop work
+            work = self.pending[key].firstObject;
+            [self.pending[key] removeObjectAtIndex:0];
+            
+            //mark busy
+            [self.busy addObject:key];
+            
+            //inc/dec
+            running++;
+            queued--;
+        }
+        
+        //unlock
+        os_unfair_lock_unlock(&lock);
+        
+        //none?
+        if(nil == work) break;
+        
+        //give back slot
+        dispatch_semaphore_signal(self.slots);
+        
+        //run
+        [self start:work];
+    }
+    
+    return;
+}
+
+//start work
+// on a worker, then (once it's done) start next
+-(void)start:(ItemResolverWork*)work
+{
+    dispatch_group_async(self.group, self.queue, ^{
+        
+        @autoreleasepool
+        {
+            //run
+            [self run:work];
+        }
+        
+        //lock
+        os_unfair_lock_lock(&self->lock);
+        
+        //dec
+        self->running--;
+        
+        //process' next work can run
+        // ready, if it has any, else remove its (empty) FIFO
+        [self.busy removeObject:work.key];
+        if(0 != self.pending[work.key].count) [self.ready addObject:work.key];
+        else [self.pending removeObjectForKey:work.key];
+        
+        //unlock
+        os_unfair_lock_unlock(&self->lock);
+        
+        //start next
+        [self next];
+    });
+    
+    return;
+}
+
+//run work
+// resolve item (timing it), then continue event via handler
+-(void)run:(ItemResolverWork*)work
+{
+    //start
+    uint64_t start = mach_absolute_time();
+    
+    //latency
+    uint64_t latency = 0;
+    
+    //plugin
+    NSString* plugin = NSStringFromClass([work.event.plugin class]);
+    
+    //(per plugin) latency
+    NSArray<NSNumber*>* latency4Plugin = nil;
+    
+    //resolve
+    [work.event resolve];
+    
+    //latency
+    latency = machTimeToNanoseconds(mach_absolute_time() - start);
+    
+    //lock
+    os_unfair_lock_lock(&lock);
+    
+    //inc
+    resolved++;
+    queuedTime += machTimeToNanoseconds(start - work.queued);
+    
+    //update plugin's latency
+    latency4Plugin = self.latencies[plugin];
+    self.latencies[plugin] = @[@(latency4Plugin[0].unsignedLongLongValue + 1),
+                               @(latency4Plugin[1].unsignedLongLongValue + latency),
+                               @(MAX(latency4Plugin[2].unsignedLongLongValue, latency))];
+    
+    //unlock
+    os_unfair_lock_unlock(&lock);
+    
+    //continue
+    work.handler(work.event);
+    
+    return;
+}
+
+//stats
+// queued, resolved, and (per plugin) latency
+-(NSDictionary*)stats
+{
+    //stats
+    NSMutableDictionary* stats = nil;
+    
+    //(per plugin) latencies
+    NSMutableDictionary* pluginLatencies = nil;
+    
+    //alloc
+    pluginLatencies = [NSMutableDictionary dictionary];
+    
+    //lock
+    os_unfair_lock_lock(&lock);
+    
+    //init
+    stats = [@{@"workers":@(workers),
+               @"running":@(running),
+               @"queued":@(queued),
+               @"processes (queued/running)":@(self.pending.count),
+               @"max queued":@(maxQueued),
+               @"backpressured":@(backpressured),
+               @"submitted":@(submitted),
+               @"resolved":@(resolved),
+               @"queued (avg, us)":@((0 != resolved) ? (queuedTime / resolved / NSEC_PER_USEC) : 0)} mutableCopy];
+    
+    //add each plugin's latency
+    for(NSString* plugin in self.latencies)
+    {
+        //add
+        pluginLatencies[plugin] = @{@"resolved":self.latencies[plugin][0],
+                                    @"latency (avg, us)":@(self.latencies[plugin][1].unsignedLongLongValue / self.latencies[plugin][0].unsignedLongLongValue / NSEC_PER_USEC),
+                                    @"latency (max, us)":@(self.latencies[plugin][2].unsignedLongLongValue / NSEC_PER_USEC)};
+    }
+    
+    //unlock
+    os_unfair_lock_unlock(&lock);
+    
+    //add
+    stats[@"plugins"] = pluginLatencies;
+    
+    return stats;
+}
+
+@end
@@ -9,7 +9,13 @@
 @import Foundation;
 
 #import "Event.h"
+#import "EventQueue.h"
+#import "ItemResolver.h"
+#import "FileReadiness.h"
+#import "EventCoalescer.h"
 #import "FileMonitor.h"
+#import "PathMatcher.h"
+#import "SubscriptionPlanner.h"
 
 #import "Monitors/BTMMonitor.h"
 #import "Monitors/ProcessMonitor.h"
@@ -18,6 +24,11 @@
 
 @import OSLog;
 
+/* CONSTS */
+
+//how often (in seconds) to log stats
+#define STATS_INTERVAL (15 * 60)
+
 @interface Monitor : NSObject
 {
 
@@ -31,6 +42,10 @@
 //file monitor
 @property(atomic, retain)FileMonitor* fileMon;
 
+//event queue
+// between ES callbacks and event workers
+@property(atomic, retain)EventQueue* eventQueue;
+
 //btm monitor
 @property(nonatomic, retain)BTMMonitor* btmMonitor;
 
@@ -40,12 +55,42 @@
 //plugin (objects)
 @property (nonatomic, retain)NSMutableArray* plugins;
 
-//last event
-@property (nonatomic, retain)Event* lastEvent;
+//(compiled) watch paths of all plugins
+@property (nonatomic, retain)PathMatcher* pathMatcher;
+
+//recent events
+// coalesces bursts of related events
+@property (atomic, retain)EventCoalescer* coalescer;
+
+//file readiness
+// parks events till their file is ready
+@property (atomic, retain)FileReadiness* readiness;
+
+//item resolver
+// resolves events' (startup) items, async
+@property (atomic, retain)ItemResolver* resolver;
+
+//stopping?
+// then (parked/resolving) events just release their message
+@property BOOL stopping;
+
+//subscription planner
+// derives target paths from watch paths
+@property(nonatomic, retain)SubscriptionPlanner* planner;
+
+//watches on (planner's) expanded directories
+// e.g. '/Users/', so target paths are re-planned when a user is added
+@property(nonatomic, retain)NSMutableArray* directoryWatches;
+
+//queue for (re)planning
+@property(nonatomic, retain)dispatch_queue_t planQueue;
 
 //observer for new client/user
 @property(nonatomic, retain)id userObserver;
 
+//timer for (periodically) logging stats
+@property(nonatomic, retain)dispatch_source_t statsTimer;
+
 
 /* METHODS */
 
@@ -55,7 +100,19 @@
 //process event
 -(void)processEvent:(File*)file plugin:(PluginBase*)plugin message:(es_message_t*)message;
 
+//process event
+// ready: item's file is (known to be) ready, so don't park
+-(void)processEvent:(File*)file plugin:(PluginBase*)plugin message:(es_message_t*)message ready:(BOOL)ready;
+
+//process (resolved) event
+// continues processing, once event's item is resolved
+-(void)processResolvedEvent:(Event*)event;
+
 //stop
 -(BOOL)stop;
 
+//stats
+// from each component
+-(NSDictionary*)statistics;
+
 @end
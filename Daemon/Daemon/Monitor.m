@@ -32,14 +32,25 @@ extern os_log_t logHandle;
 //glboal prefs obj
 extern Preferences* preferences;
 
+/* FUNCTIONS */
+
+//release an ES message
+static void releaseESMessage(es_message_t* message);
+
 @implementation Monitor
 
 @synthesize plugins;
 @synthesize fileMon;
-@synthesize lastEvent;
+@synthesize coalescer;
+@synthesize eventQueue;
+@synthesize statsTimer;
+@synthesize pathMatcher;
 @synthesize btmMonitor;
 @synthesize userObserver;
 @synthesize endpointProcessClient;
+@synthesize planner;
+@synthesize planQueue;
+@synthesize directoryWatches;
 
 //init function
 -(id)init
@@ -86,8 +97,12 @@ extern Preferences* preferences;
     PluginBase* processPlugin = nil;
 
     //events of interest for file monitor
-    // also pass in process exec/exit to capture args
-    es_event_type_t events[] = {ES_EVENT_TYPE_NOTIFY_CREATE, ES_EVENT_TYPE_NOTIFY_WRITE, ES_EVENT_TYPE_NOTIFY_RENAME, ES_EVENT_TYPE_NOTIFY_EXEC, ES_EVENT_TYPE_NOTIFY_EXIT};
+    // also pass in process fork/exec/exit to capture args, and track ancestry
+    // note: close is (only) to resume events parked till their file is ready, so must be last (see below)
+    es_event_type_t events[] = {ES_EVENT_TYPE_NOTIFY_CREATE, ES_EVENT_TYPE_NOTIFY_WRITE, ES_EVENT_TYPE_NOTIFY_RENAME, ES_EVENT_TYPE_NOTIFY_FORK, ES_EVENT_TYPE_NOTIFY_EXEC, ES_EVENT_TYPE_NOTIFY_EXIT, ES_EVENT_TYPE_NOTIFY_CLOSE};
+    
+    //count of events
+    uint32_t eventsCount = sizeof(events)/sizeof(events[0]);
     
     //define block for file monitor
     // automatically invoked upon file events
@@ -95,9 +110,43 @@ extern Preferences* preferences;
     {
         @autoreleasepool
         {
-            //process file event
-            // match alert, etc...
-            [self processEvent:file plugin:nil message:nil];
+            //plugin
+            PluginBase* plugin = nil;
+            
+            //events parked (till their file is ready)?
+            // create/close/rename of a file means it is, so resume any for it
+            if( (YES == [self.readiness isWaiting]) &&
+                (ES_EVENT_TYPE_NOTIFY_WRITE != file.event) &&
+                (0 != file.destinationPath.length) )
+            {
+                //ready
+                [self.readiness ready:file.destinationPath];
+            }
+            
+            //close?
+            // only used for readiness
+            if(ES_EVENT_TYPE_NOTIFY_CLOSE == file.event)
+            {
+                //ignore
+                return;
+            }
+            
+            //find plugin
+            // ...that cares about the path/file
+            plugin = [self findPlugin:file];
+            if(nil == plugin)
+            {
+                //ignore
+                return;
+            }
+            
+            //create paths
+            // as (ES) message they point into is gone once we return
+            [file materialize];
+            
+            //queue file event
+            // workers will then process it (match, alert, etc...)
+            [self.eventQueue enqueue:file plugin:plugin message:nil];
         }
     };
     
@@ -112,15 +161,60 @@ extern Preferences* preferences;
         goto bail;
     }
     
+    //init coalescer
+    // window/capacity: default, unless set in preferences
+    self.coalescer = [[EventCoalescer alloc] initWithWindow:(nil != preferences.preferences[PREF_COALESCE_WINDOW]) ? [preferences.preferences[PREF_COALESCE_WINDOW] doubleValue] : COALESCER_DEFAULT_WINDOW
+                                                   capacity:(nil != preferences.preferences[PREF_COALESCE_CAPACITY]) ? [preferences.preferences[PREF_COALESCE_CAPACITY] unsignedIntegerValue] : COALESCER_DEFAULT_CAPACITY];
+    
+    //init readiness
+    // parks events till their file is ready
+    self.readiness = [[FileReadiness alloc] init];
+    
+    //init resolver
+    // resolves events' items, async
+    self.resolver = [[ItemResolver alloc] initWithWorkers:NSProcessInfo.processInfo.activeProcessorCount/2];
+    
+    //init event queue
+    // workers (sharded by responsible process) process events
+    self.eventQueue = [[EventQueue alloc] initWithWorkers:MIN(MAX(NSProcessInfo.processInfo.activeProcessorCount/2, 2), EVENT_QUEUE_MAX_WORKERS) capacity:EVENT_QUEUE_CAPACITY handler:^(File* file, PluginBase* plugin, es_message_t* message)
+    {
+        //process event
+        // match alert, etc...
+        [self processEvent:file plugin:plugin message:message];
+    }];
+    
+    if(nil == self.eventQueue)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to create event queue");
+        
+        //bail
+        goto bail;
+    }
+    
     //dbg msg
     os_log_debug(logHandle, "starting file monitor...");
     
     //init monitor
     fileMon = [[FileMonitor alloc] init];
+    
+    //only deliver file events under watched paths
+    // (target) prefixes are derived from (all) watch paths
+    self.planner = [[SubscriptionPlanner alloc] init];
+    self.fileMon.targetPrefixes = [self.planner targetPrefixes:self.pathMatcher];
+
+    //not restricted to target paths?
+    // then skip close, as it'd deliver every (modified) close on the system
+    // parked events are then (only) resumed by a create/rename, or their timeout
+    if(YES != [self.fileMon isTargeted])
+    {
+        //skip (last) close
+        eventsCount--;
+    }
 
     //start monitoring
     // pass in block for events
-    started = [self.fileMon start:events count:sizeof(events)/sizeof(events[0]) csOption:csNone callback:block];
+    started = [self.fileMon start:events count:eventsCount csOption:csNone callback:block];
     if(YES != started)
     {
         //err msg
@@ -130,6 +224,20 @@ extern Preferences* preferences;
         goto bail;
     }
     
+    //targeted?
+    // watch (planner's) expanded directories, to re-plan when they change
+    if(YES == [self.fileMon isTargeted])
+    {
+        //init
+        self.directoryWatches = [NSMutableArray array];
+        self.planQueue = dispatch_queue_create("com.objective-see.blockblock.planner", DISPATCH_QUEUE_SERIAL);
+        
+        //watch
+        dispatch_async(self.planQueue, ^{
+            [self watchExpanded];
+        });
+    }
+    
     //find process plugin
     processPlugin = [self findPluginByName:@"Processes"];
     if(nil == processPlugin)
@@ -185,6 +293,17 @@ extern Preferences* preferences;
         os_log_debug(logHandle, "started btm monitor");
     }
     
+    //start stats timer
+    // periodically logs stats of each component
+    self.statsTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+    dispatch_source_set_timer(self.statsTimer, dispatch_time(DISPATCH_TIME_NOW, STATS_INTERVAL * NSEC_PER_SEC), STATS_INTERVAL * NSEC_PER_SEC, NSEC_PER_SEC);
+    dispatch_source_set_event_handler(self.statsTimer, ^{
+        
+        //dbg msg
+        os_log_debug(logHandle, "stats: %{public}@", [self statistics]);
+    });
+    dispatch_resume(self.statsTimer);
+    
     //happy
     started = YES;
     
@@ -194,6 +313,124 @@ bail:
 }
 
 
+//watch (planner's) expanded directories
+// any change (e.g. new user) triggers a re-plan
+// note: only invoked on plan queue
+-(void)watchExpanded
+{
+    //cancel existing watches
+    for(dispatch_source_t watch in self.directoryWatches)
+    {
+        //cancel
+        dispatch_source_cancel(watch);
+    }
+    
+    //remove
+    [self.directoryWatches removeAllObjects];
+    
+    //watch each
+    for(NSString* directory in self.planner.expanded)
+    {
+        //watch
+        dispatch_source_t watch = NULL;
+        
+        //open
+        // just for events
+        int fd = open(directory.fileSystemRepresentation, O_EVTONLY);
+        if(-1 == fd)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to open %{public}@ (error: %d)", directory, errno);
+            
+            //next
+            continue;
+        }
+        
+        //create
+        // write: an entry was added, removed, or renamed
+        watch = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, fd, DISPATCH_VNODE_WRITE, self.planQueue);
+        if(NULL == watch)
+        {
+            //close
+            close(fd);
+            
+            //next
+            continue;
+        }
+        
+        //handler
+        dispatch_source_set_event_handler(watch, ^{
+            
+            //re-plan
+            [self replan];
+        });
+        
+        //cancel handler
+        dispatch_source_set_cancel_handler(watch, ^{
+            
+            //close
+            close(fd);
+        });
+        
+        //start
+        dispatch_resume(watch);
+        
+        //save
+        [self.directoryWatches addObject:watch];
+    }
+    
+    return;
+}
+
+//re-plan target paths
+// e.g. a user was added, so now need to target their directories too
+// note: only invoked on plan queue, and events in (new) directories before this are missed
+-(void)replan
+{
+    //prefixes
+    NSArray* prefixes = nil;
+    
+    //stopping?
+    if(YES == self.stopping)
+    {
+        //bail
+        goto bail;
+    }
+    
+    //re-plan
+    prefixes = [self.planner targetPrefixes:self.pathMatcher];
+    if(nil == prefixes)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to re-plan target paths");
+        
+        //bail
+        goto bail;
+    }
+    
+    //changed?
+    if(YES != [prefixes isEqualToArray:self.fileMon.targetPrefixes])
+    {
+        //dbg msg
+        os_log_debug(logHandle, "target paths changed, retargeting: %{public}@", prefixes);
+        
+        //retarget
+        if(YES != [self.fileMon retarget:prefixes])
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to retarget file monitor");
+        }
+    }
+    
+    //(re)watch
+    // as expanded directories may have changed too
+    [self watchExpanded];
+    
+bail:
+    
+    return;
+}
+
 //stop monitors
 -(BOOL)stop
 {
@@ -254,6 +491,62 @@ bail:
         os_log_debug(logHandle, "stopped btm monitor");
     }
     
+    //stop event queue
+    // after monitors, as they (were) the producers
+    if(nil != self.eventQueue)
+    {
+        //stop
+        [self.eventQueue stop];
+        
+        //unset
+        self.eventQueue = nil;
+    }
+    
+    //set flag
+    // (parked/resolving) events now just release their message
+    self.stopping = YES;
+    
+    //stop readiness
+    // resumes (and waits for) parked events
+    // note: before resolver, as (resumed) events may be handed to it
+    [self.readiness stop];
+    
+    //stop resolver
+    // then release messages of events it hadn't started resolving
+    for(Event* event in [self.resolver stop])
+    {
+        //release
+        [self releaseMessage:event delivered:NO];
+    }
+    
+    //stop watching (expanded) directories
+    if(nil != self.planQueue)
+    {
+        //cancel
+        dispatch_sync(self.planQueue, ^{
+            
+            //cancel each
+            for(dispatch_source_t watch in self.directoryWatches)
+            {
+                //cancel
+                dispatch_source_cancel(watch);
+            }
+            
+            //remove
+            [self.directoryWatches removeAllObjects];
+        });
+    }
+    
+    //stop stats timer
+    if(nil != self.statsTimer)
+    {
+        //cancel
+        dispatch_source_cancel(self.statsTimer);
+        
+        //unset
+        self.statsTimer = nil;
+    }
+    
     //happy
     stopped = YES;
     
@@ -262,20 +555,28 @@ bail:
     return stopped;
 }
 
+//process an event
+// file isn't known to be ready (yet)
+-(void)processEvent:(File*)file plugin:(PluginBase*)plugin message:(es_message_t*)message
+{
+    //process
+    [self processEvent:file plugin:plugin message:message ready:NO];
+    
+    return;
+}
+
 //process an event
 // a) determine if it's an event of interest
 // b) then, build and deliver alert to the user
--(void)processEvent:(File*)file plugin:(PluginBase*)plugin message:(es_message_t*)message
+// note: if item's file isn't ready, event is parked (and processed again once it is)
+-(void)processEvent:(File*)file plugin:(PluginBase*)plugin message:(es_message_t*)message ready:(BOOL)ready
 {
-    //flag
-    BOOL wasDelivered = NO;
+    //path of file item needs
+    NSString* readinessPath = nil;
     
     //event
     Event* event = nil;
     
-    //matching rule (if any)
-    Rule* matchingRule = nil;
-    
     //plugin
     PluginBase* matchingPlugin = nil;
     
@@ -335,6 +636,35 @@ bail:
         goto bail;
     }
     
+    //file item needs not ready (i.e. doesn't exist yet)?
+    // park event, vs. blocking this worker (and all events behind it), till it's ready, or timeout
+    readinessPath = (YES != ready) ? [matchingPlugin readinessPath:file] : nil;
+    if( (nil != readinessPath) &&
+        (YES != [NSFileManager.defaultManager fileExistsAtPath:readinessPath]) )
+    {
+        //park
+        // ...process again, (as ready) once resumed
+        [self.readiness wait:readinessPath timeout:FILE_READINESS_TIMEOUT handler:^(BOOL isReady)
+        {
+            //stopping?
+            // just release message
+            if(YES == self.stopping)
+            {
+                //release
+                releaseESMessage(message);
+                
+                return;
+            }
+            
+            //process
+            [self processEvent:file plugin:matchingPlugin message:message ready:YES];
+        }];
+        
+        //done
+        // note: (parked) event still owns message
+        return;
+    }
+    
     //create event
     event = [Event alloc];
         
@@ -346,20 +676,81 @@ bail:
     }
     
     //complete initialization
-    event = [event init:file plugin:matchingPlugin];
+    // but defer resolving (startup) item, as that may be expensive (e.g. parsing a plist)
+    event = [event init:file plugin:matchingPlugin resolve:NO];
+    
+    //from same source (and unchanged file) as a recent event?
+    // if so, it's related, so ignore it (w/o resolving item)
+    if(YES == [self.coalescer coalesceUnresolved:event])
+    {
+        //dbg msg
+        os_log_debug(logHandle, "matches (source of) recent event, so ignoring");
+        
+        //skip
+        goto bail;
+    }
+    
+    //resolve item, async
+    // as that may be slow, so continues (rule lookup, delivery, etc) once it's resolved
+    // note: fails if resolver is stopped
+    if(YES != [self.resolver resolve:event handler:^(Event* resolvedEvent)
+    {
+        //continue
+        [self processResolvedEvent:resolvedEvent];
+    }])
+    {
+        //bail
+        goto bail;
+    }
+    
+    //done
+    // note: (resolving) event now owns message
+    return;
+    
+bail:
+    
+    //release message
+    // via event, if created
+    if(nil != event) [self releaseMessage:event delivered:NO];
+    else releaseESMessage(message);
+    
+    return;
+}
+
+//process a (resolved) event
+// a) determine if it's related to a recent/shown event, or matches a rule
+// b) then, deliver alert to the user
+-(void)processResolvedEvent:(Event*)event
+{
+    //flag
+    BOOL wasDelivered = NO;
+    
+    //matching rule (if any)
+    Rule* matchingRule = nil;
+    
+    //plugin
+    PluginBase* matchingPlugin = event.plugin;
+    
+    //file
+    File* file = event.file;
     
     //dbg msg
     os_log_debug(logHandle, "created event: %{public}@", event);
     
-    //matches last event?
-    // if so, ignore the event
-    if(YES == [event isRelated:self.lastEvent includeTime:YES])
+    //stopping?
+    // don't (then) call into (torn down) components
+    if(YES == self.stopping)
+    {
+        //skip
+        goto bail;
+    }
+    
+    //related to a recent event?
+    // if so, ignore the event (coalescer also refreshes that one)
+    if(YES == [self.coalescer coalesce:event])
     {
         //dbg msg
-        os_log_debug(logHandle, "matches last event, so ignoring");
-
-        //update
-        self.lastEvent = event;
+        os_log_debug(logHandle, "matches recent event, so ignoring");
 
         //skip
         goto bail;
@@ -411,8 +802,8 @@ bail:
     //dbg msg
     os_log_debug(logHandle, "no matching rule found...");
     
-    //update last event
-    self.lastEvent = event;
+    //add to recent events
+    [self.coalescer add:event];
     
     //dbg msg
     os_log_debug(logHandle, "event appears to be new!, will deliver");
@@ -430,6 +821,17 @@ bail:
     
 bail:
     
+    //release message
+    // unless delivered
+    [self releaseMessage:event delivered:wasDelivered];
+    
+    return;
+}
+
+//release event's (es) message
+// unless event was delivered (then, it's released once user responds)
+-(void)releaseMessage:(Event*)event delivered:(BOOL)wasDelivered
+{
     @synchronized (event) {
         
         //not delivered?
@@ -438,17 +840,7 @@ bail:
             (NULL != event.esMessage) )
         {
             //release message
-            if(@available(macOS 11.0, *))
-            {
-                //release
-                es_release_message(event.esMessage);
-            }
-            //free message
-            else
-            {
-                //free
-                es_free_message(event.esMessage);
-            }
+            releaseESMessage(event.esMessage);
             
             //unset
             event.esMessage = NULL;
@@ -559,6 +951,27 @@ bail:
     
     //dbg msg
     os_log_debug(logHandle, "registered plugins: %{public}@", self.plugins);
+    
+    //init matcher
+    self.pathMatcher = [[PathMatcher alloc] init];
+    
+    //add each plugin's watch paths
+    // note: order of plugins (in watch list) is match priority
+    for(PluginBase* plugin in self.plugins)
+    {
+        //add
+        [plugin registerPatterns:self.pathMatcher];
+    }
+    
+    //compile
+    if(YES != [self.pathMatcher compile])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to compile watch list");
+        
+        //bail
+        goto bail;
+    }
 
     //no errors
     bRet = YES;
@@ -569,6 +982,67 @@ bail:
 }
 
 
+//stats
+// from each component
+-(NSDictionary*)statistics
+{
+    //stats
+    NSMutableDictionary* statistics = nil;
+    
+    //alloc
+    statistics = [NSMutableDictionary dictionary];
+    
+    //event queue
+    if(nil != self.eventQueue)
+    {
+        //add
+        statistics[@"event queue"] = [self.eventQueue stats];
+    }
+    
+    //process monitor
+    if(nil != self.processMonitor)
+    {
+        //add
+        statistics[@"process monitor"] = [self.processMonitor stats];
+    }
+    
+    //file monitor
+    if(nil != self.fileMon)
+    {
+        //add
+        statistics[@"file monitor"] = [self.fileMon stats];
+    }
+    
+    //coalescer
+    if(nil != self.coalescer)
+    {
+        //add
+        statistics[@"coalescer"] = [self.coalescer stats];
+    }
+    
+    //item resolver
+    if(nil != self.resolver)
+    {
+        //add
+        statistics[@"item resolver"] = [self.resolver stats];
+    }
+    
+    //file readiness
+    if(nil != self.readiness)
+    {
+        //add
+        statistics[@"file readiness"] = [self.readiness stats];
+    }
+    
+    //quarantine (flags) cache
+    statistics[@"quarantine cache"] = quarantineCacheStats();
+    
+    //(parsed) plist cache
+    statistics[@"plist cache"] = plistCacheStats();
+    
+    return statistics;
+}
+
 //find loaded plugin by name
 -(PluginBase*)findPluginByName:(NSString*)name
 {
@@ -594,20 +1068,44 @@ bail:
 }
 
 //find the plugin (or none) that's intersted in the path
+// single pass over the path, via the (compiled) watch list
 -(PluginBase*)findPlugin:(File*)file
 {
-    //plugin
-    __block PluginBase* plugin = nil;
+    //path view
+    PathView view = file.destinationView;
     
-    //look for plugin that can handle path
-    NSUInteger idx = [plugins indexOfObjectWithOptions:NSEnumerationConcurrent passingTest:^BOOL(PluginBase * _Nonnull currentPlugin, NSUInteger idx, BOOL * _Nonnull stop) {
-        //is match?
-        return [currentPlugin isMatch:file];
-    }];
-    if (idx != NSNotFound) {
-        plugin = plugins[idx];
+    //have view?
+    // match on it, as path (string) then only needs creating for candidates
+    if(NULL != view.dir)
+    {
+        //match
+        return [self.pathMatcher matchView:&view];
     }
-    return plugin;
+    
+    //match
+    return [self.pathMatcher match:file.destinationPath];
 }
 
 @end
+
+//release an ES message
+static void releaseESMessage(es_message_t* message)
+{
+    //none?
+    if(NULL == message) return;
+    
+    //release message
+    if(@available(macOS 11.0, *))
+    {
+        //release
+        es_release_message(message);
+    }
+    //free message
+    else
+    {
+        //free
+        es_free_message(message);
+    }
+    
+    return;
+}
@@ -51,6 +51,9 @@ extern os_log_t logHandle;
         //copied message
         es_message_t* messageCopy = NULL;
         
+        //event queue
+        EventQueue* eventQueue = nil;
+        
         //dbg msg
         os_log_debug(logHandle, "new 'btm' event: %#x", message->event_type);
         
@@ -105,9 +108,33 @@ extern os_log_t logHandle;
             messageCopy = es_copy_message(message);
         }
         
-        //process event
-        // passing in (btm) plugin
-        [monitor processEvent:file plugin:btmPlugin message:messageCopy];
+        //grab queue
+        // as it's unset when monitor is stopped
+        eventQueue = monitor.eventQueue;
+        
+        //no queue?
+        // release message, as no one will take ownership of it
+        if(nil == eventQueue)
+        {
+            //dbg msg
+            os_log_debug(logHandle, "no event queue (stopped?), ignoring 'btm' event");
+            
+            //release
+            if(@available(macOS 11.0, *))
+            {
+                es_release_message(messageCopy);
+            }
+            else
+            {
+                es_free_message(messageCopy);
+            }
+            
+            return;
+        }
+        
+        //queue event
+        // passing in (btm) plugin, and ownership of message
+        [eventQueue enqueue:file plugin:btmPlugin message:messageCopy];
        
     });
     
@@ -0,0 +1,69 @@
+//
+//  file: DeadlineScheduler.h
+//  project: BlockBlock (launch daemon)
+//  description: earliest-deadline-first scheduler for pending (ES) auth responses (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+#ifndef DeadlineScheduler_h
+#define DeadlineScheduler_h
+
+@import Foundation;
+
+/* CONSTS */
+
+//default safety margin (nanoseconds)
+// fire this long before an ES deadline, so we're not killed
+#define DEADLINE_DEFAULT_MARGIN (2 * NSEC_PER_SEC)
+
+//min/max safety margin (nanoseconds)
+// one set (in preferences) outside this range is ignored
+#define DEADLINE_MIN_MARGIN (500 * NSEC_PER_MSEC)
+#define DEADLINE_MAX_MARGIN (10 * NSEC_PER_SEC)
+
+//min time (nanoseconds) a user has to respond (beyond the margin)
+// any less, and there's no point in alerting
+#define DEADLINE_MIN_RESPONSE_TIME (NSEC_PER_SEC / 2)
+
+//number of (log2, millisecond) slack buckets
+#define DEADLINE_SLACK_BUCKETS 20
+
+/* TYPEDEFS */
+
+//block for expired entries
+typedef void (^DeadlineHandler)(id _Nonnull object);
+
+@interface DeadlineScheduler : NSObject
+
+/* PROPERTIES */
+
+//safety margin (nanoseconds)
+@property uint64_t margin;
+
+/* METHODS */
+
+//init
+// handler is invoked (on queue) for each entry whose deadline (minus margin) has passed
+-(id _Nonnull)initWithMargin:(uint64_t)margin queue:(dispatch_queue_t _Nonnull)queue handler:(DeadlineHandler _Nonnull)handler;
+
+//schedule an object
+// deadline is mach (absolute) time, O(log n)
+-(void)schedule:(id _Nonnull)object deadline:(uint64_t)deadline;
+
+//cancel an object
+// returns NO if it wasn't scheduled (e.g. already fired), O(log n)
+-(BOOL)cancel:(id _Nonnull)object;
+
+//cancel all
+// and stop timer
+-(void)stop;
+
+//stats
+// count, and slack histograms
+-(NSDictionary* _Nonnull)stats;
+
+@end
+
+#endif /* DeadlineScheduler_h */
@@ -0,0 +1,507 @@
+//
+//  file: DeadlineScheduler.m
+//  project: BlockBlock (launch daemon)
+//  description: earliest-deadline-first scheduler for pending (ES) auth responses
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+//  all pending (auth) messages are kept in a single min-heap, ordered by when they must be
+//  acted upon (their ES deadline, minus a safety margin). one timer is armed for the top of
+//  the heap. each entry tracks its index in the heap, so cancelling is O(log n) too.
+//
+//  to help tune the margin, two histograms are kept: the slack ES gave us (deadline - arrival)
+//  and the slack that was left when an entry was cancelled (i.e. when the user responded)
+
+@import OSLog;
+
+#import <mach/mach_time.h>
+
+#import "utilities.h"
+#import "DeadlineScheduler.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+/* FUNCTIONS */
+
+//convert nanoseconds to mach time
+static uint64_t nanosecondsToMachTime(uint64_t nanoseconds);
+
+//add to (log2, millisecond) histogram
+static void addToHistogram(uint64_t* histogram, uint64_t nanoseconds);
+
+//convert histogram to dictionary
+// key: upper bound of (non-empty) bucket
+static NSDictionary* histogramToDictionary(uint64_t* histogram);
+
+/* OBJECT: ENTRY */
+
+@interface DeadlineEntry : NSObject
+
+//object
+@property(nonatomic, retain)id object;
+
+//deadline
+@property uint64_t deadline;
+
+//fire time
+// deadline - margin
+@property uint64_t fireTime;
+
+//index in heap
+@property NSUInteger index;
+
+@end
+
+@implementation DeadlineEntry
+
+@synthesize index;
+@synthesize object;
+@synthesize deadline;
+@synthesize fireTime;
+
+@end
+
+@interface DeadlineScheduler ()
+{
+    //slack given by ES
+    uint64_t givenSlack[DEADLINE_SLACK_BUCKETS];
+
+    //slack left when cancelled
+    uint64_t remainingSlack[DEADLINE_SLACK_BUCKETS];
+
+    //counters
+    uint64_t fired;
+    uint64_t cancelled;
+}
+
+//heap
+// ordered by fire time
+@property(nonatomic, retain)NSMutableArray<DeadlineEntry*>* heap;
+
+//entries
+// key: object (identity)
+@property(nonatomic, retain)NSMapTable* entries;
+
+//timer
+@property(nonatomic, retain)dispatch_source_t timer;
+
+//queue for handler
+@property(nonatomic, retain)dispatch_queue_t queue;
+
+//handler
+@property(nonatomic, copy)DeadlineHandler handler;
+
+@end
+
+@implementation DeadlineScheduler
+
+@synthesize heap;
+@synthesize queue;
+@synthesize timer;
+@synthesize margin;
+@synthesize handler;
+@synthesize entries;
+
+//init
+// create (single) timer, which is (re)armed for the earliest entry
+-(id)initWithMargin:(uint64_t)safetyMargin queue:(dispatch_queue_t)handlerQueue handler:(DeadlineHandler)deadlineHandler
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //save
+        margin = safetyMargin;
+        queue = handlerQueue;
+        handler = deadlineHandler;
+
+        //alloc
+        heap = [NSMutableArray array];
+        entries = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory|NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+
+        //init timer
+        timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(QOS_CLASS_USER_INTERACTIVE, 0));
+        dispatch_source_set_timer(timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+
+        //weak self
+        // as timer is owned by self
+        __weak DeadlineScheduler* weakSelf = self;
+
+        //handler
+        dispatch_source_set_event_handler(timer, ^{
+            [weakSelf expire];
+        });
+
+        //start
+        dispatch_resume(timer);
+    }
+
+    return self;
+}
+
+//schedule an object
+// add to bottom of heap, then sift up
+-(void)schedule:(id)object deadline:(uint64_t)deadline
+{
+    //entry
+    DeadlineEntry* entry = nil;
+
+    //now
+    uint64_t now = mach_absolute_time();
+
+    //margin
+    uint64_t machMargin = nanosecondsToMachTime(self.margin);
+
+    //init entry
+    entry = [[DeadlineEntry alloc] init];
+    entry.object = object;
+    entry.deadline = deadline;
+    entry.fireTime = (deadline > machMargin) ? (deadline - machMargin) : 0;
+
+    //sync
+    @synchronized(self)
+    {
+        //already scheduled?
+        // remove old entry first
+        if(nil != [self.entries objectForKey:object])
+        {
+            //remove
+            [self removeEntry:[self.entries objectForKey:object]];
+        }
+
+        //add slack given
+        addToHistogram(givenSlack, (deadline > now) ? machTimeToNanoseconds(deadline - now) : 0);
+
+        //add
+        entry.index = self.heap.count;
+        [self.heap addObject:entry];
+        [self.entries setObject:entry forKey:object];
+
+        //sift up
+        [self siftUp:entry.index];
+
+        //new earliest?
+        // (re)arm timer
+        if(0 == entry.index)
+        {
+            [self arm];
+        }
+    }
+
+    return;
+}
+
+//cancel an object
+// remove its entry from the heap
+-(BOOL)cancel:(id)object
+{
+    //flag
+    BOOL wasCancelled = NO;
+
+    //entry
+    DeadlineEntry* entry = nil;
+
+    //now
+    uint64_t now = mach_absolute_time();
+
+    //sync
+    @synchronized(self)
+    {
+        //find
+        entry = [self.entries objectForKey:object];
+        if(nil == entry)
+        {
+            //bail
+            goto bail;
+        }
+
+        //add slack remaining
+        addToHistogram(remainingSlack, (entry.deadline > now) ? machTimeToNanoseconds(entry.deadline - now) : 0);
+
+        //remove
+        [self removeEntry:entry];
+
+        //inc
+        cancelled++;
+
+        //happy
+        wasCancelled = YES;
+    }
+
+bail:
+
+    return wasCancelled;
+}
+
+//cancel all
+// and stop timer
+-(void)stop
+{
+    //sync
+    @synchronized(self)
+    {
+        //remove all
+        [self.heap removeAllObjects];
+        [self.entries removeAllObjects];
+
+        //cancel timer
+        if(nil != self.timer)
+        {
+            //cancel
+            dispatch_source_cancel(self.timer);
+            self.timer = nil;
+        }
+    }
+
+    return;
+}
+
+//expire entries
+// pop all entries whose fire time has passed, invoke handler for each, then re-arm
+-(void)expire
+{
+    //expired objects
+    NSMutableArray* expired = nil;
+
+    //now
+    uint64_t now = mach_absolute_time();
+
+    //alloc
+    expired = [NSMutableArray array];
+
+    //sync
+    @synchronized(self)
+    {
+        //pop all expired
+        while( (0 != self.heap.count) &&
+               (self.heap[0].fireTime <= now) )
+        {
+            //save
+            [expired addObject:self.heap[0].object];
+
+            //remove
+            [self removeEntry:self.heap[0]];
+
+            //inc
+            fired++;
+        }
+
+        //re-arm
+        [self arm];
+    }
+
+    //invoke handler
+    // outside of lock, as it may (re)enter
+    for(id object in expired)
+    {
+        //invoke
+        dispatch_async(self.queue, ^{
+            self.handler(object);
+        });
+    }
+
+    return;
+}
+
+//(re)arm timer
+// for earliest entry, or never if empty
+// note: caller must hold lock
+-(void)arm
+{
+    //now
+    uint64_t now = mach_absolute_time();
+
+    //stopped?
+    if(nil == self.timer) return;
+
+    //empty?
+    // disarm
+    if(0 == self.heap.count)
+    {
+        //disarm
+        dispatch_source_set_timer(self.timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        return;
+    }
+
+    //arm
+    // note: no leeway, as timing is what matters here
+    dispatch_source_set_timer(self.timer, dispatch_time(DISPATCH_TIME_NOW, (self.heap[0].fireTime > now) ? (int64_t)machTimeToNanoseconds(self.heap[0].fireTime - now) : 0), DISPATCH_TIME_FOREVER, 0);
+
+    return;
+}
+
+//remove entry
+// swap with last, then restore heap (either direction)
+// note: caller must hold lock
+-(void)removeEntry:(DeadlineEntry*)entry
+{
+    //index
+    NSUInteger index = entry.index;
+
+    //last
+    NSUInteger last = self.heap.count - 1;
+
+    //was earliest?
+    BOOL wasTop = (0 == index);
+
+    //remove from map
+    [self.entries removeObjectForKey:entry.object];
+
+    //swap w/ last
+    if(index != last)
+    {
+        [self swap:index with:last];
+    }
+
+    //remove
+    [self.heap removeLastObject];
+
+    //restore heap
+    // moved entry may need to go either way
+    if(index < self.heap.count)
+    {
+        //moved
+        DeadlineEntry* moved = self.heap[index];
+
+        //sift
+        [self siftUp:index];
+        [self siftDown:moved.index];
+    }
+
+    //earliest changed?
+    // re-arm timer
+    if(YES == wasTop)
+    {
+        [self arm];
+    }
+
+    return;
+}
+
+//sift up
+// move entry toward root, while earlier than its parent
+-(void)siftUp:(NSUInteger)index
+{
+    while(index > 0)
+    {
+        //parent
+        NSUInteger parent = (index - 1) / 2;
+
+        //in order?
+        if(self.heap[parent].fireTime <= self.heap[index].fireTime) break;
+
+        //swap
+        [self swap:index with:parent];
+        index = parent;
+    }
+
+    return;
+}
+
+//sift down
+// move entry toward leaves, while later than a child
+-(void)siftDown:(NSUInteger)index
+{
+    while(YES)
+    {
+        //children
+        NSUInteger left = (2 * index) + 1;
+        NSUInteger right = left + 1;
+
+        //earliest
+        NSUInteger earliest = index;
+
+        //left earlier?
+        if( (left < self.heap.count) &&
+            (self.heap[left].fireTime < self.heap[earliest].fireTime) ) earliest = left;
+
+        //right earlier?
+        if( (right < self.heap.count) &&
+            (self.heap[right].fireTime < self.heap[earliest].fireTime) ) earliest = right;
+
+        //in order?
+        if(earliest == index) break;
+
+        //swap
+        [self swap:index with:earliest];
+        index = earliest;
+    }
+
+    return;
+}
+
+//swap two entries
+// and update their indices
+-(void)swap:(NSUInteger)first with:(NSUInteger)second
+{
+    //swap
+    [self.heap exchangeObjectAtIndex:first withObjectAtIndex:second];
+
+    //update
+    self.heap[first].index = first;
+    self.heap[second].index = second;
+
+    return;
+}
+
+//stats
+// count, and slack histograms
+-(NSDictionary*)stats
+{
+    //sync
+    @synchronized(self)
+    {
+        return @{@"margin (ms)":@(self.margin / NSEC_PER_MSEC),
+                 @"scheduled":@(self.heap.count),
+                 @"fired":@(fired),
+                 @"cancelled":@(cancelled),
+                 @"slack given (ms)":histogramToDictionary(givenSlack),
+                 @"slack remaining (ms)":histogramToDictionary(remainingSlack)};
+    }
+}
+
+@end
+
+//convert nanoseconds to mach time
+static uint64_t nanosecondsToMachTime(uint64_t nanoseconds)
+{
+    //timebase
+    static mach_timebase_info_data_t timebase;
+    if(0 == timebase.denom) (void)mach_timebase_info(&timebase);
+
+    return (nanoseconds * timebase.denom) / timebase.numer;
+}
+
+//add to (log2, millisecond) histogram
+static void addToHistogram(uint64_t* histogram, uint64_t nanoseconds)
+{
+    //add
+    histogram[MIN((NSUInteger)flsll((long long)(nanoseconds / NSEC_PER_MSEC)), DEADLINE_SLACK_BUCKETS-1)]++;
+
+    return;
+}
+
+//convert histogram to dictionary
+// key: upper bound of (non-empty) bucket
+static NSDictionary* histogramToDictionary(uint64_t* histogram)
+{
+    //dictionary
+    NSMutableDictionary* dictionary = [NSMutableDictionary dictionary];
+
+    //add non-empty
+    for(NSUInteger i = 0; i < DEADLINE_SLACK_BUCKETS; i++)
+    {
+        //empty?
+        if(0 == histogram[i]) continue;
+
+        //add
+        dictionary[[NSString stringWithFormat:@"<%llu", 1ULL << i]] = @(histogram[i]);
+    }
+
+    return dictionary;
+}
@@ -1,5 +1,5 @@
 //
-//  Monitor.h
+//  ProcessMonitor.h
 //  BlockBlock
 //
 //  Created by Patrick Wardle on 9/25/14.
@@ -10,9 +10,16 @@
 @import Foundation;
 
 #import "Event.h"
+#import "DeadlineScheduler.h"
 
 #import <EndpointSecurity/EndpointSecurity.h>
 
+/* CONSTS */
+
+//max number of (auth) events evaluated at once
+// as each may block (e.g. waiting to see if process dies, code signing checks)
+#define PROCESS_MONITOR_MAX_EVALUATIONS 8
+
 @interface ProcessMonitor : NSObject
 {
 
@@ -29,6 +36,29 @@
 //cache
 @property(nonatomic, retain)NSCache* cache;
 
+//pending (auth) decisions
+// key: message (pointer), value: event (shown to user)
+@property(nonatomic, retain)NSMutableDictionary* pending;
+
+//scheduler for pending (auth) decisions
+// takes default action, just before their deadline
+@property(nonatomic, retain)DeadlineScheduler* scheduler;
+
+//queue for scheduler
+// (high priority) serial, and its own, so evaluations can't starve it past (ES) deadlines
+@property(nonatomic, retain)dispatch_queue_t deadlineQueue;
+
+//queue for evaluating (auth) events
+// so ES handler can return immediately
+@property(nonatomic, retain)dispatch_queue_t evaluationQueue;
+
+//queue for admitting (auth) events
+// serial, so events are evaluated in order, and (at most) PROCESS_MONITOR_MAX_EVALUATIONS at once
+@property(nonatomic, retain)dispatch_queue_t admissionQueue;
+
+//evaluations (still) allowed
+@property(nonatomic, retain)dispatch_semaphore_t evaluations;
+
 
 /* METHODS */
 
@@ -38,6 +68,13 @@
 //stop
 -(BOOL)stop;
 
+//complete a pending (auth) decision
+// can be called from any thread, but only the first call (for an event) responds
+-(BOOL)complete:(Event*)event result:(es_auth_result_t)result;
+
+//stats
+-(NSDictionary*)stats;
+
 //clear (ES) cache
 -(void)clearCache;
 
@@ -1,5 +1,5 @@
 //
-//  Monitor.m
+//  ProcessMonitor.m
 //  BlockBlock
 //
 //  Created by Patrick Wardle on 9/25/14.
@@ -16,6 +16,8 @@
 #import "Processes.h"
 #import "ProcessMonitor.h"
 
+#import <stdatomic.h>
+
 /* GLOBALS */
 
 //log handle
@@ -25,8 +27,35 @@ extern Events* events;
 extern Monitor* monitor;
 extern Preferences* preferences;
 
+/* FUNCTIONS */
+
+//release an ES message
+static void releaseMessage(es_message_t* message);
+
+@interface ProcessMonitor ()
+{
+    //counters
+    _Atomic(uint64_t) decided;
+    _Atomic(uint64_t) parked;
+    _Atomic(uint64_t) answered;
+    _Atomic(uint64_t) timedOut;
+
+    //decision latency (of parked events)
+    // nanoseconds, from exec to response
+    _Atomic(uint64_t) totalLatency;
+    _Atomic(uint64_t) maxLatency;
+}
+@end
+
 @implementation ProcessMonitor
 
+@synthesize pending;
+@synthesize scheduler;
+@synthesize evaluations;
+@synthesize deadlineQueue;
+@synthesize admissionQueue;
+@synthesize evaluationQueue;
+
 //start process monitor
 // and respond to process events
 -(BOOL)start:(PluginBase*)plugin
@@ -40,10 +69,65 @@ extern Preferences* preferences;
     //events
     es_event_type_t procESEvents[] = {ES_EVENT_TYPE_AUTH_EXEC};
     
+    //(deadline) margin
+    uint64_t margin = 0;
+    
     //init cache
     self.cache = [[NSCache alloc] init];
     self.cache.countLimit = 4096;
     
+    //init pending
+    self.pending = [NSMutableDictionary dictionary];
+    
+    //init evaluation queue
+    self.evaluationQueue = dispatch_queue_create("com.objective-see.blockblock.exec", DISPATCH_QUEUE_CONCURRENT);
+    
+    //init admission queue
+    // and bound on (concurrent) evaluations
+    self.admissionQueue = dispatch_queue_create("com.objective-see.blockblock.exec.admission", DISPATCH_QUEUE_SERIAL);
+    self.evaluations = dispatch_semaphore_create(PROCESS_MONITOR_MAX_EVALUATIONS);
+    
+    //init deadline queue
+    // serial, high priority
+    self.deadlineQueue = dispatch_queue_create("com.objective-see.blockblock.exec.deadlines", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_USER_INTERACTIVE, 0));
+    
+    //init (deadline) margin
+    // default, unless (validly) set in preferences (ms)
+    margin = DEADLINE_DEFAULT_MARGIN;
+    if(YES == [preferences.preferences[PREF_NOTARIZATION_ES_TIMEOUT_MARGIN] isKindOfClass:[NSNumber class]])
+    {
+        //set
+        // note: checked (below) before converting, so it can't overflow
+        margin = [preferences.preferences[PREF_NOTARIZATION_ES_TIMEOUT_MARGIN] unsignedLongLongValue];
+        
+        //in range?
+        // too small and we'd be killed, too large and exec's would (always) be default-actioned
+        if( (margin >= DEADLINE_MIN_MARGIN / NSEC_PER_MSEC) &&
+            (margin <= DEADLINE_MAX_MARGIN / NSEC_PER_MSEC) )
+        {
+            //convert
+            margin *= NSEC_PER_MSEC;
+        }
+        //out of range
+        else
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: %{public}@ (%{public}@ms) is out of range, using default", PREF_NOTARIZATION_ES_TIMEOUT_MARGIN, preferences.preferences[PREF_NOTARIZATION_ES_TIMEOUT_MARGIN]);
+            
+            //default
+            margin = DEADLINE_DEFAULT_MARGIN;
+        }
+    }
+    
+    //init scheduler
+    // fires default action for pending events, a margin before their deadline
+    // note: on its own queue, so (blocked) evaluations can't delay it
+    self.scheduler = [[DeadlineScheduler alloc] initWithMargin:margin queue:self.deadlineQueue handler:^(id object)
+    {
+        //expire
+        [self expire:(Event*)object];
+    }];
+    
     //dbg msg
     os_log_debug(logHandle, "starting process monitor...");
         
@@ -51,21 +135,15 @@ extern Preferences* preferences;
     // and handle process (auth exec) events
     result = es_new_client(&_endpointClient, ^(es_client_t *client, const es_message_t *message)
     {
-        //event
-        Event* event = nil;
-        
-        //new process event
-        Process* process = nil;
-        
-        //deadline sema
-        dispatch_semaphore_t deadlineSema = 0;
+        //retained message
+        es_message_t* retainedMessage = NULL;
         
         //dbg msg
         //os_log_debug(logHandle, "new ES_EVENT_TYPE_AUTH_EXEC event");
         
         //if deadline is super short
-        // user won't be able to respond anyways, so just allow :|
-        if((machTimeToNanoseconds(message->deadline - mach_absolute_time())) < (2.5 * NSEC_PER_SEC)) {
+        // user won't be able to respond (before margin) anyways, so just allow :|
+        if((machTimeToNanoseconds(message->deadline - mach_absolute_time())) < (self.scheduler.margin + DEADLINE_MIN_RESPONSE_TIME)) {
             
             NSString* path = convertStringToken(&message->event.exec.target->executable->path);
         
@@ -81,6 +159,10 @@ extern Preferences* preferences;
                 es_respond_auth_result(client, message, ES_AUTH_RESULT_ALLOW, false);
                 os_log_debug(logHandle, "allowing process (due to user preference)");
             }
+            
+            //inc
+            atomic_fetch_add_explicit(&self->decided, 1, memory_order_relaxed);
+            
             //done
             return;
         }
@@ -93,191 +175,72 @@ extern Preferences* preferences;
             //os_log_debug(logHandle, "allowing process, due to preferences (%{public}@)", preferences.preferences]);
             
             [self allowProcessEvent:client message:(es_message_t*)message cache:true];
-            return;
-        }
-    
-        //init process obj
-        process = [[Process alloc] init:(es_message_t* _Nonnull)message csOption:csDynamic];
-        if(!process) {
             
-            os_log_error(logHandle, "failed to create process object");
-            [self allowProcessEvent:client message:(es_message_t*)message cache:false];
-
-            return;
-        }
-        
-        //allow?
-        // and cache
-        if([plugin shouldIgnore:process message:(es_message_t *)message]) {
+            //inc
+            atomic_fetch_add_explicit(&self->decided, 1, memory_order_relaxed);
             
-            os_log_debug(logHandle, "allowing (and caching) %{public}@", process);
-            [self allowProcessEvent:client message:(es_message_t*)message cache:true];
-
             return;
         }
         
-        //ignore if dead now
-        //when macOS kills a process we still get an event, so handle this case
-        for(int i=0; i<3; i++)
-        {
-            if(!isProcessAlive(process.pid)) {
-                os_log_debug(logHandle, "process died, so will ignore");
-                [self allowProcessEvent:client message:(es_message_t*)message cache:false];
-                return;
-            }
-            
-            [NSThread sleepForTimeInterval:0.05];
-        }
-      
-        /* from here on, we're going to ask user
-           ...even in passive mode (killing processes w/o user input isn't ideal) */
-        
-        //dbg msg
-        os_log_debug(logHandle, "alerting user about: %{public}@", process);
-        
-        //init event
-        event = [[Event alloc] init:process plugin:plugin];
-        
-        //dbg msg
-        os_log_debug(logHandle, "alerting user w/: %{public}@", event);
-        
-        //add client
-        event.esClient = client;
-        
         //retain message
+        // as it's now evaluated (and maybe responded to) async
         if(@available(macOS 11.0, *))
         {
             //retain
             es_retain_message(message);
-            event.esMessage = (es_message_t*)message;
+            retainedMessage = (es_message_t*)message;
         }
         //copy message
         else
         {
             //copy
-            event.esMessage = es_copy_message(message);
+            retainedMessage = es_copy_message(message);
         }
         
-        //create deadline semaphore
-        deadlineSema = dispatch_semaphore_create(0);
-        
-        //add to event
-        event.esSemaphore = deadlineSema;
-        
-        //deliver alert
-        // can fail if no client
-        if(YES == [events deliver:event])
-        {
-            //dbg msg
-            os_log_debug(logHandle, "alert delivered, waiting for response...");
+        //evaluate async
+        // so other execs aren't stuck behind this one
+        // but bounded, as each evaluation may block (so, wait for one to finish, off ES' thread)
+        dispatch_async(self.admissionQueue, ^{
             
-            //wait time
-            // note: we've already checked to make sure it's at least 2.5 seconds
-            uint64_t waitTime = machTimeToNanoseconds(message->deadline - mach_absolute_time()) - (2.0 * NSEC_PER_SEC);
+            //wait for free evaluation
+            dispatch_semaphore_wait(self.evaluations, DISPATCH_TIME_FOREVER);
             
-            //wait till close to timeout
-            // if haven't hit, just allow, otherwise we'll be killed
-            if(0 != dispatch_semaphore_wait(deadlineSema, dispatch_time(DISPATCH_TIME_NOW, waitTime)))
-            {
-                //err msg
-                os_log_error(logHandle, "ERROR: ES timeout (%llu seconds) about to be hit, forced to take action", waitTime / NSEC_PER_SEC);
-                
-                //sync
-                @synchronized(self)
-                {
-                    NSString* path = convertStringToken(&message->event.exec.target->executable->path);
-                    
-                    //deny on timeout?
-                    if([preferences.preferences[PREF_NOTARIZATION_ES_TIMEOUT_MODE] boolValue]) {
-                        es_respond_auth_result(client, message, ES_AUTH_RESULT_DENY, false);
-                        os_log(logHandle, "Blocking %{public}@ ...ES timeout hit, and user set default action to 'Block'", path);
-                    }
-                    //allow
-                    else {
-                        es_respond_auth_result(client, message, ES_AUTH_RESULT_ALLOW, false);
-                        os_log(logHandle, "Allowing %{public}@ ...ES timeout hit, and default action is set to 'Allow'", path);
-                    }
-                    
-                    //sync
-                    @synchronized (event) {
-                        
-                        //unset
-                        event.esClient = NULL;
-                        
-                        //release message
-                        if(@available(macOS 11.0, *)) {
-                            if(event.esMessage) {
-                                es_release_message(event.esMessage);
-                            }
-                        }
-                        //free message
-                        else {
-                            if(event.esMessage) {
-                                es_free_message(event.esMessage);
-                            }
-                        }
-                        
-                        //unset
-                        event.esMessage = NULL;
-                    }
-                }
-            }
-            //sema signal'd
-            // handled by user, all good
-            else
+            //waited too long?
+            // i.e. deadline is now too close for user to respond, so take default action
+            if( (retainedMessage->deadline <= mach_absolute_time()) ||
+                (machTimeToNanoseconds(retainedMessage->deadline - mach_absolute_time()) < (self.scheduler.margin + DEADLINE_MIN_RESPONSE_TIME)) )
             {
                 //dbg msg
-                os_log_debug(logHandle, "esf semaphore signaled, alert was handled");
+                os_log_debug(logHandle, "ES deadline too close (after waiting to be evaluated), so taking default action");
+                
+                //respond
+                es_respond_auth_result(client, retainedMessage, ([preferences.preferences[PREF_NOTARIZATION_ES_TIMEOUT_MODE] boolValue]) ? ES_AUTH_RESULT_DENY : ES_AUTH_RESULT_ALLOW, false);
+                
+                //inc
+                atomic_fetch_add_explicit(&self->decided, 1, memory_order_relaxed);
+                
+                //release
+                releaseMessage(retainedMessage);
+                
+                //done
+                dispatch_semaphore_signal(self.evaluations);
+                
+                return;
             }
-        }
-        //failed to deliver
-        // will just allow process
-        else
-        {
-            //err msg
-            os_log_error(logHandle, "ERROR: failed to deliver message, will allow process :/");
             
-            //sync
-            @synchronized(self)
-            {
-                //allow
-                if(YES != [self allowProcessEvent:client message:(es_message_t*)message cache:NO])
+            //evaluate
+            dispatch_async(self.evaluationQueue, ^{
+                
+                @autoreleasepool
                 {
-                    //err msg
-                    os_log_error(logHandle, "ERROR: failed to allow process");
+                    //evaluate
+                    [self evaluate:retainedMessage client:client plugin:plugin];
                 }
                 
-                //sync
-                @synchronized(event) {
-                    
-                    //unset
-                    event.esClient = NULL;
-                    
-                    //release message
-                    if(@available(macOS 11.0, *))
-                    {
-                        //release
-                        if(NULL != event.esMessage)
-                        {
-                            es_release_message(event.esMessage);
-                        }
-                    }
-                    //free message
-                    else
-                    {
-                        //free
-                        if(NULL != event.esMessage)
-                        {
-                            es_free_message(event.esMessage);
-                        }
-                    }
-                    
-                    //unset
-                    event.esMessage = NULL;
-                }
-            }
-        }
-            
+                //done
+                dispatch_semaphore_signal(self.evaluations);
+            });
+        });
     });
    
     //sanity check
@@ -307,6 +270,290 @@ bail:
     return started;
 }
 
+//evaluate (auth) exec event
+// either respond now, or park it (and alert user), and return
+// note: takes ownership of (retained) message
+-(void)evaluate:(es_message_t*)message client:(es_client_t*)client plugin:(PluginBase*)plugin
+{
+    //event
+    Event* event = nil;
+    
+    //new process event
+    Process* process = nil;
+    
+    //init process obj
+    process = [[Process alloc] init:(es_message_t* _Nonnull)message csOption:csDynamic];
+    if(!process) {
+        
+        os_log_error(logHandle, "failed to create process object");
+        [self allowProcessEvent:client message:message cache:false];
+
+        goto bail;
+    }
+    
+    //allow?
+    // and cache
+    if([plugin shouldIgnore:process message:message]) {
+        
+        os_log_debug(logHandle, "allowing (and caching) %{public}@", process);
+        [self allowProcessEvent:client message:message cache:true];
+
+        goto bail;
+    }
+    
+    //ignore if dead now
+    //when macOS kills a process we still get an event, so handle this case
+    for(int i=0; i<3; i++)
+    {
+        if(!isProcessAlive(process.pid)) {
+            os_log_debug(logHandle, "process died, so will ignore");
+            [self allowProcessEvent:client message:message cache:false];
+            
+            goto bail;
+        }
+        
+        [NSThread sleepForTimeInterval:0.05];
+    }
+  
+    /* from here on, we're going to ask user
+       ...even in passive mode (killing processes w/o user input isn't ideal) */
+    
+    //dbg msg
+    os_log_debug(logHandle, "alerting user about: %{public}@", process);
+    
+    //init event
+    event = [[Event alloc] init:process plugin:plugin];
+    
+    //dbg msg
+    os_log_debug(logHandle, "alerting user w/: %{public}@", event);
+    
+    //park
+    // ...pending table now owns message
+    [self park:event message:message];
+    
+    //deliver alert
+    // can fail if no client
+    if(YES == [events deliver:event])
+    {
+        //dbg msg
+        os_log_debug(logHandle, "alert delivered, pending response...");
+    }
+    //failed to deliver
+    // will just allow process
+    else
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to deliver message, will allow process :/");
+        
+        //allow
+        [self complete:event result:ES_AUTH_RESULT_ALLOW cache:NO];
+    }
+    
+    //done
+    return;
+    
+bail:
+    
+    //inc
+    atomic_fetch_add_explicit(&decided, 1, memory_order_relaxed);
+    
+    //release
+    releaseMessage(message);
+    
+    return;
+}
+
+//park event
+// add to pending, and schedule (default) action for just before ES deadline
+-(void)park:(Event*)event message:(es_message_t*)message
+{
+    //add message
+    event.esMessage = message;
+    
+    //add
+    @synchronized(self.pending)
+    {
+        //add
+        self.pending[[NSValue valueWithPointer:message]] = event;
+    }
+    
+    //inc
+    atomic_fetch_add_explicit(&parked, 1, memory_order_relaxed);
+    
+    //schedule
+    // if still pending close to timeout, scheduler will take default action
+    [self.scheduler schedule:event deadline:message->deadline];
+    
+    return;
+}
+
+//deadline (nearly) hit
+// take default action, otherwise we'll be killed
+-(void)expire:(Event*)event
+{
+    //default action
+    es_auth_result_t result = ([preferences.preferences[PREF_NOTARIZATION_ES_TIMEOUT_MODE] boolValue]) ? ES_AUTH_RESULT_DENY : ES_AUTH_RESULT_ALLOW;
+    
+    //process path
+    NSString* path = event.process.path;
+    
+    //complete
+    // NO if already completed (i.e. user responded)
+    if(YES != [self complete:event result:result cache:NO])
+    {
+        return;
+    }
+    
+    //inc
+    atomic_fetch_add_explicit(&timedOut, 1, memory_order_relaxed);
+    
+    //err msg
+    os_log_error(logHandle, "ERROR: ES timeout (margin: %llu ms) about to be hit, forced to take action", self.scheduler.margin / NSEC_PER_MSEC);
+    
+    //deny on timeout?
+    if(ES_AUTH_RESULT_DENY == result) {
+        os_log(logHandle, "Blocking %{public}@ ...ES timeout hit, and user set default action to 'Block'", path);
+    }
+    //allow
+    else {
+        os_log(logHandle, "Allowing %{public}@ ...ES timeout hit, and default action is set to 'Allow'", path);
+    }
+    
+    return;
+}
+
+//complete a pending (auth) decision
+// e.g. user's response, via plugin
+-(BOOL)complete:(Event*)event result:(es_auth_result_t)result
+{
+    //complete
+    if(YES != [self complete:event result:result cache:YES])
+    {
+        //dbg msg
+        os_log_debug(logHandle, "esf message was already completed ...timeout hit?");
+        
+        return NO;
+    }
+    
+    //inc
+    atomic_fetch_add_explicit(&answered, 1, memory_order_relaxed);
+    
+    return YES;
+}
+
+//complete a pending (auth) decision
+// only the first caller (per event) finds it pending, so responds and releases message
+-(BOOL)complete:(Event*)event result:(es_auth_result_t)result cache:(BOOL)cache
+{
+    //flag
+    BOOL completed = NO;
+    
+    //message
+    es_message_t* message = NULL;
+    
+    //latency
+    uint64_t latency = 0;
+    
+    //response
+    es_respond_result_t response = !ES_RESPOND_RESULT_SUCCESS;
+    
+    //sync
+    @synchronized(event)
+    {
+        //message
+        message = event.esMessage;
+        if(NULL == message)
+        {
+            //bail
+            goto bail;
+        }
+        
+        //remove
+        // but only if it's (still) this event's
+        @synchronized(self.pending)
+        {
+            //not pending?
+            if(event != self.pending[[NSValue valueWithPointer:message]])
+            {
+                //bail
+                goto bail;
+            }
+            
+            //remove
+            [self.pending removeObjectForKey:[NSValue valueWithPointer:message]];
+        }
+        
+        //cancel deadline
+        // no-op if it's what fired
+        [self.scheduler cancel:event];
+        
+        //scripts aren't cached
+        if( (message->version >= 2) &&
+            (NULL != message->event.exec.script) )
+        {
+            //unset
+            cache = NO;
+        }
+        
+        //respond
+        response = es_respond_auth_result(self.endpointClient, message, result, cache);
+        if(ES_RESPOND_RESULT_SUCCESS != response)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: 'es_respond_auth_result' failed with: %x", response);
+        }
+        
+        //latency
+        // from exec, to response
+        latency = machTimeToNanoseconds(mach_absolute_time() - message->mach_time);
+        atomic_fetch_add_explicit(&totalLatency, latency, memory_order_relaxed);
+        for(uint64_t max = atomic_load_explicit(&maxLatency, memory_order_relaxed); latency > max; )
+        {
+            if(atomic_compare_exchange_weak_explicit(&maxLatency, &max, latency, memory_order_relaxed, memory_order_relaxed)) break;
+        }
+        
+        //release
+        releaseMessage(message);
+        
+        //unset
+        event.esMessage = NULL;
+        
+        //happy
+        completed = YES;
+        
+    } //sync
+    
+bail:
+    
+    return completed;
+}
+
+//stats
+-(NSDictionary*)stats
+{
+    //completed
+    uint64_t completed = atomic_load(&answered) + atomic_load(&timedOut);
+    
+    //pending
+    NSUInteger pendingCount = 0;
+    
+    //sync
+    @synchronized(self.pending)
+    {
+        //count
+        pendingCount = self.pending.count;
+    }
+    
+    return @{@"deadlines":[self.scheduler stats],
+             @"decided (immediately)":@(atomic_load(&decided)),
+             @"parked":@(atomic_load(&parked)),
+             @"answered":@(atomic_load(&answered)),
+             @"timed out":@(atomic_load(&timedOut)),
+             @"pending":@(pendingCount),
+             @"decision latency avg (ms)":@((0 != completed) ? (atomic_load(&totalLatency) / completed) / NSEC_PER_MSEC : 0),
+             @"decision latency max (ms)":@(atomic_load(&maxLatency) / NSEC_PER_MSEC)};
+}
+
 //allow process event
 -(BOOL)allowProcessEvent:(es_client_t*)client message:(es_message_t*)message cache:(bool)cache
 {
@@ -371,6 +618,17 @@ bail:
             
         //dbg msg
         os_log_debug(logHandle, "unsubscribed from process events");
+        
+        //allow any pending
+        // as client is about to be deleted
+        for(Event* event in [self pendingEvents])
+        {
+            //allow
+            [self complete:event result:ES_AUTH_RESULT_ALLOW cache:NO];
+        }
+        
+        //stop scheduler
+        [self.scheduler stop];
            
         //delete client
         if(ES_RETURN_SUCCESS != es_delete_client(self.endpointClient))
@@ -399,6 +657,23 @@ bail:
     return stopped;
 }
 
+//pending events
+// snapshot, so can be completed outside of lock
+-(NSArray*)pendingEvents
+{
+    //events
+    NSArray* pendingEvents = nil;
+    
+    //sync
+    @synchronized(self.pending)
+    {
+        //copy
+        pendingEvents = self.pending.allValues;
+    }
+    
+    return pendingEvents;
+}
+
 //clear (ES) cache
 -(void)clearCache
 {
@@ -419,3 +694,22 @@ bail:
 }
 
 @end
+
+//release an ES message
+static void releaseMessage(es_message_t* message)
+{
+    //release message
+    if(@available(macOS 11.0, *))
+    {
+        //release
+        es_release_message(message);
+    }
+    //free message
+    else
+    {
+        //free
+        es_free_message(message);
+    }
+    
+    return;
+}
@@ -0,0 +1,58 @@
+//
+//  file: PathMatcher.h
+//  project: BlockBlock (launch daemon)
+//  description: multi-pattern (watch list) path matcher (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+#ifndef PathMatcher_h
+#define PathMatcher_h
+
+@import Foundation;
+
+#import "FileMonitor.h"
+
+@class PluginBase;
+
+/* CONSTS */
+
+//max number of literals
+// each gets a bit in a 64-bit mask
+#define MATCHER_MAX_LITERALS 64
+
+//min length of a literal
+// shorter ones (e.g. '/') don't filter anything
+#define MATCHER_MIN_LITERAL 3
+
+@interface PathMatcher : NSObject
+
+/* METHODS */
+
+//add a plugin's (compiled) regexes
+// note: order of adds is match priority
+-(void)addPlugin:(PluginBase*)plugin regexes:(NSArray<NSRegularExpression*>*)regexes;
+
+//add a plugin's path prefix
+// note: order of adds is match priority
+-(void)addPlugin:(PluginBase*)plugin prefix:(NSString*)prefix;
+
+//compile all added patterns into a single automaton
+// must be called (once) after all plugins are added, and before matching
+-(BOOL)compile;
+
+//find (first) plugin that matches a path
+-(PluginBase*)match:(NSString*)path;
+
+//find (first) plugin that matches a path view
+// e.g. straight from an ES message, so no path (string) is created unless there's a candidate
+-(PluginBase*)matchView:(const PathView*)view;
+
+//enumerate all added patterns
+// regexes are passed as their (string) pattern, prefixes as is
+-(void)enumeratePatterns:(void(^)(NSString* pattern, BOOL isPrefix))block;
+
+@end
+
+#endif /* PathMatcher_h */
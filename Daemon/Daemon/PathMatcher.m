@@ -0,0 +1,651 @@
+//
+//  file: PathMatcher.m
+//  project: BlockBlock (launch daemon)
+//  description: multi-pattern (watch list) path matcher
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+//  all watch list patterns are compiled into a single (Aho-Corasick) automaton over the
+//  literals that any match of each pattern must contain. one pass over a path yields the
+//  set of literals present, and only entries whose literals are all present are then
+//  verified (by their regex or prefix). as almost no paths match, most never hit a regex.
+
+@import OSLog;
+
+#import "PluginBase.h"
+#import "PathMatcher.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+/* DEFINES */
+
+//entry types
+enum MatcherEntryType{MatcherEntryRegex, MatcherEntryPrefix};
+
+/* FUNCTIONS */
+
+//fold (ascii) byte to lower case
+static inline uint8_t foldByte(uint8_t byte)
+{
+    return ((byte >= 'A') && (byte <= 'Z')) ? (uint8_t)(byte | 0x20) : byte;
+}
+
+//extract literals any match of a regex must contain
+// returns nil if there are none (e.g. top-level alternation)
+NSArray* extractLiterals(NSString* pattern);
+
+@interface PathMatcher ()
+{
+    //automaton transitions
+    // one row of 256 (byte) transitions per state
+    int32_t (*transitions)[256];
+
+    //per-state mask of (found) literals
+    uint64_t* outputs;
+
+    //number of states
+    NSUInteger stateCount;
+
+    //per-entry mask of required literals
+    uint64_t* required;
+}
+
+//plugin, per entry
+@property(nonatomic, retain)NSMutableArray* plugins;
+
+//regex or prefix, per entry
+@property(nonatomic, retain)NSMutableArray* patterns;
+
+//type, per entry
+@property(nonatomic, retain)NSMutableArray* types;
+
+//literals, per entry
+@property(nonatomic, retain)NSMutableArray* entryLiterals;
+
+//flag
+@property BOOL compiled;
+
+@end
+
+@implementation PathMatcher
+
+@synthesize types;
+@synthesize plugins;
+@synthesize patterns;
+@synthesize compiled;
+@synthesize entryLiterals;
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //alloc
+        plugins = [NSMutableArray array];
+        patterns = [NSMutableArray array];
+        types = [NSMutableArray array];
+        entryLiterals = [NSMutableArray array];
+    }
+
+    return self;
+}
+
+//dealloc
+// free automaton
+-(void)dealloc
+{
+    //free
+    free(transitions);
+    free(outputs);
+    free(required);
+
+    return;
+}
+
+//add a plugin's (compiled) regexes
+// each regex becomes its own entry
+-(void)addPlugin:(PluginBase*)plugin regexes:(NSArray<NSRegularExpression*>*)regexes
+{
+    //add each
+    for(NSRegularExpression* regex in regexes)
+    {
+        //add
+        [self.plugins addObject:plugin];
+        [self.patterns addObject:regex];
+        [self.types addObject:@(MatcherEntryRegex)];
+
+        //extract literals
+        [self.entryLiterals addObject:extractLiterals(regex.pattern) ?: @[]];
+    }
+
+    return;
+}
+
+//add a plugin's path prefix
+-(void)addPlugin:(PluginBase*)plugin prefix:(NSString*)prefix
+{
+    //folded bytes
+    NSMutableData* literal = nil;
+
+    //sanity check
+    if(0 == prefix.length) return;
+
+    //prefix is its own literal
+    literal = [NSMutableData dataWithBytes:prefix.UTF8String length:strlen(prefix.UTF8String)];
+    for(NSUInteger i = 0; i < literal.length; i++)
+    {
+        //fold
+        ((uint8_t*)literal.mutableBytes)[i] = foldByte(((uint8_t*)literal.mutableBytes)[i]);
+    }
+
+    //add
+    [self.plugins addObject:plugin];
+    [self.patterns addObject:prefix];
+    [self.types addObject:@(MatcherEntryPrefix)];
+    [self.entryLiterals addObject:(literal.length >= MATCHER_MIN_LITERAL) ? @[literal] : @[]];
+
+    return;
+}
+
+//compile all patterns into a single automaton
+// a) assign a bit to each (unique) literal
+// b) build trie of literals
+// c) add failure links, making it a full DFA
+-(BOOL)compile
+{
+    //flag
+    BOOL result = NO;
+
+    //all (unique) literals
+    NSMutableArray* literals = nil;
+
+    //bfs queue
+    int32_t* queue = NULL;
+
+    //failure links
+    int32_t* failures = NULL;
+
+    //max states
+    NSUInteger maxStates = 1;
+
+    //alloc
+    literals = [NSMutableArray array];
+
+    //alloc required masks
+    required = calloc(MAX(self.plugins.count, 1), sizeof(uint64_t));
+    if(NULL == required) goto bail;
+
+    //assign bits to literals
+    // longest first, as they're the most selective
+    for(NSUInteger entry = 0; entry < self.plugins.count; entry++)
+    {
+        //sort
+        NSArray* sorted = [self.entryLiterals[entry] sortedArrayUsingComparator:^NSComparisonResult(NSData* first, NSData* second) {
+            return (first.length > second.length) ? NSOrderedAscending : (first.length < second.length) ? NSOrderedDescending : NSOrderedSame;
+        }];
+
+        for(NSData* literal in sorted)
+        {
+            //index of literal
+            NSUInteger index = [literals indexOfObject:literal];
+
+            //new?
+            // out of bits? just skip (entry is simply less filtered)
+            if(NSNotFound == index)
+            {
+                if(literals.count >= MATCHER_MAX_LITERALS) continue;
+
+                //add
+                [literals addObject:literal];
+                index = literals.count - 1;
+            }
+
+            //require
+            required[entry] |= (1ULL << index);
+
+            //count states (upper bound)
+            maxStates += literal.length;
+        }
+    }
+
+    //alloc automaton
+    transitions = malloc(maxStates * sizeof(*transitions));
+    outputs = calloc(maxStates, sizeof(uint64_t));
+    failures = calloc(maxStates, sizeof(int32_t));
+    queue = calloc(maxStates, sizeof(int32_t));
+    if( (NULL == transitions) ||
+        (NULL == outputs) ||
+        (NULL == failures) ||
+        (NULL == queue) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to allocate path matcher (%lu states)", (unsigned long)maxStates);
+        goto bail;
+    }
+
+    //init root
+    memset(transitions[0], -1, sizeof(transitions[0]));
+    stateCount = 1;
+
+    //build trie
+    for(NSUInteger index = 0; index < literals.count; index++)
+    {
+        //current state
+        int32_t state = 0;
+
+        //literal
+        NSData* literal = literals[index];
+
+        //add each byte
+        for(NSUInteger i = 0; i < literal.length; i++)
+        {
+            //byte
+            uint8_t byte = ((const uint8_t*)literal.bytes)[i];
+
+            //new state?
+            if(transitions[state][byte] < 0)
+            {
+                //init
+                memset(transitions[stateCount], -1, sizeof(transitions[0]));
+                transitions[state][byte] = (int32_t)stateCount++;
+            }
+
+            //next
+            state = transitions[state][byte];
+        }
+
+        //mark
+        outputs[state] |= (1ULL << index);
+    }
+
+    //queue indices
+    NSUInteger head = 0;
+    NSUInteger tail = 0;
+
+    //root's transitions
+    // missing ones loop back to root
+    for(NSUInteger byte = 0; byte < 256; byte++)
+    {
+        if(transitions[0][byte] < 0)
+        {
+            transitions[0][byte] = 0;
+        }
+        else
+        {
+            failures[transitions[0][byte]] = 0;
+            queue[tail++] = transitions[0][byte];
+        }
+    }
+
+    //bfs
+    // add failure links, and resolve them into transitions
+    while(head < tail)
+    {
+        //state
+        int32_t state = queue[head++];
+
+        for(NSUInteger byte = 0; byte < 256; byte++)
+        {
+            //next
+            int32_t next = transitions[state][byte];
+
+            //missing?
+            // follow failure link
+            if(next < 0)
+            {
+                transitions[state][byte] = transitions[failures[state]][byte];
+                continue;
+            }
+
+            //set failure
+            // and inherit its output
+            failures[next] = transitions[failures[state]][byte];
+            outputs[next] |= outputs[failures[next]];
+
+            //queue
+            queue[tail++] = next;
+        }
+    }
+
+    //dbg msg
+    os_log_debug(logHandle, "compiled %lu watch patterns (%lu literals) into %lu states", (unsigned long)self.plugins.count, (unsigned long)literals.count, (unsigned long)stateCount);
+
+    //done
+    self.compiled = YES;
+
+    //happy
+    result = YES;
+
+bail:
+
+    //free
+    free(queue);
+    free(failures);
+
+    return result;
+}
+
+//find (first) plugin that matches a path
+// single pass over path to find literals, then verify candidates in (priority) order
+-(PluginBase*)match:(NSString*)path
+{
+    //state
+    int32_t state = 0;
+
+    //found literals
+    uint64_t found = 0;
+
+    //sanity check
+    if( (YES != self.compiled) ||
+        (0 == path.length) )
+    {
+        //bail
+        return nil;
+    }
+
+    //single pass
+    // collect all literals
+    found = [self scan:(const uint8_t*)path.UTF8String length:SIZE_MAX state:&state];
+
+    //verify
+    return [self verify:found path:path view:NULL];
+}
+
+//find (first) plugin that matches a path view
+// path (string) is only created if there's a candidate to verify
+-(PluginBase*)matchView:(const PathView*)view
+{
+    //state
+    int32_t state = 0;
+
+    //found literals
+    uint64_t found = 0;
+
+    //sanity check
+    if( (YES != self.compiled) ||
+        (NULL == view->dir) )
+    {
+        //bail
+        return nil;
+    }
+
+    //scan dir
+    found = [self scan:(const uint8_t*)view->dir length:view->dirLength state:&state];
+
+    //have name?
+    // scan (implicit) separator, then name
+    if(NULL != view->name)
+    {
+        //separator
+        // unless dir already ends w/ one (i.e. '/')
+        if('/' != view->dir[view->dirLength-1])
+        {
+            found |= [self scan:(const uint8_t*)"/" length:1 state:&state];
+        }
+
+        //name
+        found |= [self scan:(const uint8_t*)view->name length:view->nameLength state:&state];
+    }
+
+    //verify
+    return [self verify:found path:nil view:view];
+}
+
+//scan bytes
+// up to length (or NUL), returning literals found
+-(uint64_t)scan:(const uint8_t*)bytes length:(size_t)length state:(int32_t*)state
+{
+    //found literals
+    uint64_t found = 0;
+
+    //scan
+    for(size_t i = 0; (i < length) && (0 != bytes[i]); i++)
+    {
+        //next
+        *state = transitions[*state][foldByte(bytes[i])];
+
+        //add
+        found |= outputs[*state];
+    }
+
+    return found;
+}
+
+//verify candidates
+// order of entries is priority
+// note: if no path is passed, it's created from view (once there's a candidate)
+-(PluginBase*)verify:(uint64_t)found path:(NSString*)path view:(const PathView*)view
+{
+    //plugin
+    PluginBase* plugin = nil;
+
+    //verify candidates
+    for(NSUInteger entry = 0; entry < self.plugins.count; entry++)
+    {
+        //missing a required literal?
+        if(required[entry] != (found & required[entry])) continue;
+
+        //no path yet?
+        // create (just once), from view
+        if(nil == path)
+        {
+            //create
+            path = pathFromView(view);
+            if(0 == path.length) break;
+        }
+
+        //regex
+        if(MatcherEntryRegex == [self.types[entry] unsignedIntegerValue])
+        {
+            //match
+            NSTextCheckingResult* match = [(NSRegularExpression*)self.patterns[entry] firstMatchInString:path options:0 range:NSMakeRange(0, path.length)];
+            if( (nil == match) ||
+                (NSNotFound == match.range.location) )
+            {
+                //next
+                continue;
+            }
+        }
+        //prefix
+        else if(YES != [path hasPrefix:self.patterns[entry]])
+        {
+            //next
+            continue;
+        }
+
+        //got match
+        plugin = self.plugins[entry];
+
+        //done
+        break;
+    }
+
+    return plugin;
+}
+
+//enumerate all added patterns
+// in (priority) order they were added
+-(void)enumeratePatterns:(void(^)(NSString* pattern, BOOL isPrefix))block
+{
+    for(NSUInteger entry = 0; entry < self.plugins.count; entry++)
+    {
+        //regex
+        if(MatcherEntryRegex == [self.types[entry] unsignedIntegerValue])
+        {
+            block(((NSRegularExpression*)self.patterns[entry]).pattern, NO);
+        }
+        //prefix
+        else
+        {
+            block(self.patterns[entry], YES);
+        }
+    }
+
+    return;
+}
+
+@end
+
+//extract literals any match of a regex must contain
+// walks the pattern, collecting runs of literal chars that are outside groups/classes and not optional
+NSArray* extractLiterals(NSString* pattern)
+{
+    //literals
+    NSMutableArray* literals = nil;
+
+    //current run
+    NSMutableData* run = nil;
+
+    //pattern bytes
+    const char* bytes = NULL;
+
+    //length
+    size_t length = 0;
+
+    //group depth
+    NSInteger depth = 0;
+
+    //save run
+    // only if long enough to be useful
+    void (^flush)(void) = nil;
+
+    //alloc
+    literals = [NSMutableArray array];
+    run = [NSMutableData data];
+
+    //init flush
+    flush = ^{
+        if(run.length >= MATCHER_MIN_LITERAL) [literals addObject:[run copy]];
+        run.length = 0;
+    };
+
+    //init
+    bytes = pattern.UTF8String;
+    length = strlen(bytes);
+
+    //walk pattern
+    for(size_t i = 0; i < length; i++)
+    {
+        //char
+        uint8_t c = (uint8_t)bytes[i];
+
+        switch(c)
+        {
+            //escape
+            case '\\':
+            {
+                //next
+                if(++i >= length) break;
+                c = (uint8_t)bytes[i];
+
+                //class (\d, \w, \b, ...)?
+                if(0 != isalnum(c))
+                {
+                    flush();
+                    break;
+                }
+
+                //escaped meta char
+                if(0 == depth) [run appendBytes:&c length:1];
+                break;
+            }
+
+            //class
+            // skip to end
+            case '[':
+            {
+                //skip leading '^' and ']'
+                if( (i+1 < length) && ('^' == bytes[i+1]) ) i++;
+                if( (i+1 < length) && (']' == bytes[i+1]) ) i++;
+
+                //skip to close
+                while( (++i < length) && (']' != bytes[i]) )
+                {
+                    if('\\' == bytes[i]) i++;
+                }
+
+                flush();
+                break;
+            }
+
+            //group open
+            case '(':
+                depth++;
+                flush();
+                break;
+
+            //group close
+            case ')':
+                depth--;
+                flush();
+                break;
+
+            //alternation
+            // at top level, nothing is required
+            case '|':
+                if(0 == depth) return nil;
+                break;
+
+            //optional/repeated
+            // previous char isn't required
+            case '*':
+            case '?':
+            case '{':
+            {
+                //remove
+                if( (0 == depth) &&
+                    (0 != run.length) ) run.length--;
+
+                //skip count
+                if('{' == c)
+                {
+                    while( (i < length) && ('}' != bytes[i]) ) i++;
+                }
+
+                flush();
+                break;
+            }
+
+            //one or more
+            // previous char is still required
+            case '+':
+            case '.':
+            case '^':
+            case '$':
+                flush();
+                break;
+
+            //literal
+            default:
+            {
+                //non-ascii
+                if(c >= 0x80)
+                {
+                    flush();
+                    break;
+                }
+
+                //add
+                if(0 == depth)
+                {
+                    c = foldByte(c);
+                    [run appendBytes:&c length:1];
+                }
+
+                break;
+            }
+        }
+    }
+
+    //last run
+    flush();
+
+    return literals;
+}
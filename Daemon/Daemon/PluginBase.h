@@ -7,7 +7,9 @@
 //
 
 
+@class Item;
 @class Event;
+@class PathMatcher;
 
 #import "FileMonitor.h"
 #import <Foundation/Foundation.h>
@@ -51,8 +53,8 @@
 //new user connected
 -(void)newUser:(NSString*)user;
 
-//is match
--(BOOL)isMatch:(File*)file;
+//add (watch) patterns to matcher
+-(void)registerPatterns:(PathMatcher*)matcher;
 
 //process an event
 // extra processing to decide if an alert should be shown
@@ -69,6 +71,10 @@
 //take snapshot
 -(void)snapshot:(NSString*)path;
 
+//file that must exist before item can be resolved
+// e.g. a launch item's plist (nil if none)
+-(NSString*)readinessPath:(File*)file;
+
 //alert message
 -(NSString*)alertMessage:(Event*)event;
 
@@ -80,4 +86,8 @@
 // i.e. launch item's binary path, or crobjob cmd
 -(NSString*)itemObject:(Event*)event;
 
+//resolve startup item
+// sets name and object (plugins can override, to only parse once)
+-(void)resolveItem:(Item*)item event:(Event*)event;
+
 @end
@@ -6,8 +6,10 @@
 //  Copyright (c) 2015 Objective-See. All rights reserved.
 //
 
+#import "Item.h"
 #import "Event.h"
 #import "PluginBase.h"
+#import "PathMatcher.h"
 
 
 #define kErrFormat @"%@ not implemented in subclass %@"
@@ -63,42 +65,14 @@
     return self;
 }
 
-//is a file a match?
--(BOOL)isMatch:(File*)file
+//add (watch) patterns to matcher
+// default: plugin's compiled regexes
+-(void)registerPatterns:(PathMatcher*)matcher
 {
-    //flag
-    __block BOOL matched = NO;
+    //add
+    [matcher addPlugin:self regexes:self.regexes];
     
-    //path
-    NSString* path = nil;
-    
-    //extract path
-    path = file.destinationPath;
-    
-    //match?
-    [self.regexes enumerateObjectsWithOptions:NSEnumerationConcurrent usingBlock:^(NSRegularExpression* _Nonnull regex, NSUInteger idx, BOOL * _Nonnull stop) {
-        
-        //match
-        NSTextCheckingResult* match = nil;
-
-        //is match?
-        match = [regex firstMatchInString:path options:0 range:NSMakeRange(0, path.length)];
-        if( (nil == match) ||
-           (NSNotFound == match.range.location) )
-        {
-            //no match
-            // keep checking
-            return;
-        }
-
-        //got match
-        matched = YES;
-
-        //done
-        *stop = YES;
-    }];
-    
-    return matched;
+    return;
 }
 
 
@@ -131,6 +105,13 @@
     return;
 }
 
+//file that must exist before item can be resolved
+// default: none
+-(NSString*)readinessPath:(File*)file
+{
+    return nil;
+}
+
 //alert message
 // returns default msg
 -(NSString*)alertMessage:(Event*)event
@@ -138,6 +119,19 @@
     return self.alertMsg;
 }
 
+//resolve startup item
+// default: name, then object (from subclass)
+-(void)resolveItem:(Item*)item event:(Event*)event
+{
+    //set name
+    item.name = [self itemName:event];
+    
+    //set object
+    item.object = [self itemObject:event];
+    
+    return;
+}
+
 /* REQUIRED METHODS */
 
 //stubs for inherited methods
@@ -92,6 +92,19 @@ extern XPCUserClient* xpcUserClient;
     return [[self itemObject:event] lastPathComponent];
 }
 
+//resolve item
+// name is just object's (binary's) last component, so only extract it once
+-(void)resolveItem:(Item*)item event:(Event*)event
+{
+    //set object
+    item.object = [self itemObject:event];
+    
+    //set name
+    item.name = item.object.lastPathComponent;
+    
+    return;
+}
+
 //get the binary (path) of the item
 -(NSString*)itemObject:(Event*)event
 {
@@ -22,8 +22,13 @@
 @property(nonatomic, retain)NSString* watchPath;
 
 //list or prev/orginal cron jobs
+// key: path, value: (counted) set of jobs, so diffs are linear
 @property(nonatomic, retain)NSMutableDictionary* snapshot;
 
+//new jobs, found when checking event
+// key: file (weak), value: new job, so 'itemObject' needn't re-read/diff
+@property(nonatomic, retain)NSMapTable* pending;
+
 /* METHODS */
 
 //update list of saved jobs
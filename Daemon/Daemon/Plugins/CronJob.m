@@ -10,6 +10,7 @@
 #import "Event.h"
 #import "Consts.h"
 #import "CronJob.h"
+#import "PathMatcher.h"
 #import "Utilities.h"
 #import "XPCUserClient.h"
 
@@ -20,6 +21,7 @@ extern os_log_t logHandle;
 
 @implementation CronJob
 
+@synthesize pending;
 @synthesize snapshot;
 @synthesize watchPath;
 
@@ -50,6 +52,10 @@ extern os_log_t logHandle;
         //alloc dictionary for snapshot
         snapshot = [NSMutableDictionary dictionary];
         
+        //alloc map for pending (new) jobs
+        // weak keys, so entries go away with their file (event)
+        pending = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsWeakMemory|NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+        
         //init all snapshots
         // for all (existing) crob job files
         for(NSString* path in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.watchPath error:nil])
@@ -62,12 +68,14 @@ extern os_log_t logHandle;
     return self;
 }
 
-//is a file a match?
-// just check if file has prefix
--(BOOL)isMatch:(File*)file
+//add (watch) patterns to matcher
+// just a prefix, as cron jobs are any file under watch path
+-(void)registerPatterns:(PathMatcher*)matcher
 {
-    //has prefix?
-    return [file.destinationPath hasPrefix:self.watchPath];
+    //add
+    [matcher addPlugin:self prefix:self.watchPath];
+    
+    return;
 }
 
 //check cron jobs
@@ -77,27 +85,47 @@ extern os_log_t logHandle;
     //flag
     // default to ignore
     BOOL shouldIgnore = YES;
+    
+    //new job
+    NSString* newJob = nil;
+    
+    //current jobs
+    NSCountedSet* jobs = nil;
  
     //dbg msg
     os_log_debug(logHandle, "'%s' invoked", __PRETTY_FUNCTION__);
     
     //only care about new jobs
     // might be other file edits which are ok to ignore...
-    if(nil != [self findNewJob:file.destinationPath])
+    newJob = [self findNewJob:file.destinationPath jobs:&jobs];
+    if(nil != newJob)
     {
         //dbg msg
         os_log_debug(logHandle, "found new cron job, so NOT IGNORING");
     
         //don't ignore
         shouldIgnore = NO;
+        
+        //save
+        // as it's the item's object
+        @synchronized(self.pending)
+        {
+            //save
+            [self.pending setObject:newJob forKey:file];
+        }
     }
     
     //if ignoring
-    // still update snapshot
-    if(YES == shouldIgnore)
+    // still update snapshot, from (already) loaded jobs
+    if( (YES == shouldIgnore) &&
+        (nil != jobs) )
     {
         //update
-        [self snapshot:file.destinationPath];
+        @synchronized(self.snapshot)
+        {
+            //update
+            self.snapshot[file.destinationPath] = jobs;
+        }
     }
     
     return shouldIgnore;
@@ -117,11 +145,29 @@ extern os_log_t logHandle;
 // so just return it to caller
 -(NSString*)itemObject:(Event*)event
 {
+    //new job
+    NSString* newJob = nil;
+    
     //dbg msg
     os_log_debug(logHandle, "'%s' invoked", __PRETTY_FUNCTION__);
     
+    //grab job found when checking event
+    @synchronized(self.pending)
+    {
+        //grab
+        newJob = [self.pending objectForKey:event.file];
+    }
+    
+    //not found?
+    // (re)load and diff
+    if(nil == newJob)
+    {
+        //find
+        newJob = [self findNewJob:event.file.destinationPath jobs:NULL];
+    }
+    
     //return latest job
-    return [self findNewJob:event.file.destinationPath];
+    return newJob;
 }
 
 //'allow' event
@@ -240,8 +286,9 @@ bail:
 }
 
 //finds latest crob job
-// diff's snapshot w/ current ones
--(NSString*)findNewJob:(NSString*)path
+// diff's snapshot w/ current ones, as (hashed) multisets, so linear
+// note: also returns current jobs, so caller can update snapshot w/o re-reading file
+-(NSString*)findNewJob:(NSString*)path jobs:(NSCountedSet**)current
 {
     //new job
     NSString* newJob = nil;
@@ -249,8 +296,11 @@ bail:
     //current (+ new?) jobs
     NSMutableArray* jobs = nil;
     
-    //new jobs
-    NSArray* newJobs = nil;
+    //prev jobs
+    NSCountedSet* previous = nil;
+    
+    //seen jobs
+    NSCountedSet* seen = nil;
     
     //dbg msg
     os_log_debug(logHandle, "'%s' invoked", __PRETTY_FUNCTION__);
@@ -258,16 +308,45 @@ bail:
     //load (possibly) new cron jobs
     jobs = [self loadJobs:path comments:NO];
     if(nil == jobs) goto bail;
+    
+    //grab snapshot
+    @synchronized(self.snapshot)
+    {
+        //grab
+        previous = self.snapshot[path];
+    }
+    
+    //init
+    seen = [NSCountedSet set];
 
-    //filter
-    // returns all new jobs
-    newJobs = [jobs filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"NOT SELF IN %@", self.snapshot[path]]];
+    //diff
+    // first job seen more times than in snapshot is new
+    // note: so a duplicate of an existing job is new too
+    for(NSString* job in jobs)
+    {
+        //add
+        [seen addObject:job];
+        
+        //new?
+        if([seen countForObject:job] > [previous countForObject:job])
+        {
+            //save
+            newJob = job;
+            
+            //done
+            break;
+        }
+    }
     
     //dbg msg
-    os_log_debug(logHandle, "new jobs: %{public}@", newJobs);
+    os_log_debug(logHandle, "new job: %{public}@", newJob);
     
-    //grab first new one
-    newJob = [newJobs firstObject];
+    //return current jobs?
+    if(NULL != current)
+    {
+        //init
+        *current = [[NSCountedSet alloc] initWithArray:jobs];
+    }
 
 bail:
     
@@ -288,10 +367,15 @@ bail:
     if(nil == jobs) goto bail;
     
     //update list
-    self.snapshot[path] = jobs;
+    // as (counted) set, for linear diffs
+    @synchronized(self.snapshot)
+    {
+        //update
+        self.snapshot[path] = [[NSCountedSet alloc] initWithArray:jobs];
+    }
     
     //dbg msg
-    os_log_debug(logHandle, "cron job snapshot: %{public}@", self.snapshot);
+    os_log_debug(logHandle, "cron job snapshot (%{public}@): %lu jobs", path, (unsigned long)jobs.count);
     
 bail:
 
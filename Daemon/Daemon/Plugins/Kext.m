@@ -54,6 +54,13 @@ extern os_log_t logHandle;
     return [file.destinationPath containsString:@"/StagedExtensions/"];
 }
 
+//kext's Info.plist
+// must exist (be written) before bundle can be loaded
+-(NSString*)readinessPath:(File*)file
+{
+    return [file.destinationPath stringByAppendingPathComponent:@"Contents/Info.plist"];
+}
+
 //get the name of the kext
 // load bundle and read 'CFBundleExecutable'
 -(NSString*)itemName:(Event*)event
@@ -65,8 +72,8 @@ extern os_log_t logHandle;
     NSBundle* bundle = nil;
     
     //get bundle
-    // will wait up to 1 second
-    bundle = getBundle(event.file.destinationPath, 1.0f);
+    // no wait, as event was parked till Info.plist was ready
+    bundle = getBundle(event.file.destinationPath, 0.0f);
     if( (nil == bundle) ||
         (nil == bundle.infoDictionary) )
     {
@@ -95,8 +102,8 @@ bail:
     NSBundle* bundle = nil;
     
     //get bundle
-    // will wait up to 1 second
-    bundle = getBundle(event.file.destinationPath, 1.0f);
+    // no wait, as event was parked till Info.plist was ready
+    bundle = getBundle(event.file.destinationPath, 0.0f);
     if( (nil == bundle) ||
         (nil == bundle.infoDictionary) )
     {
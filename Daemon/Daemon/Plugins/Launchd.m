@@ -71,6 +71,13 @@ extern os_log_t logHandle;
     return alert;
 }
 
+//launch item's plist
+// must exist (be written) before item can be resolved
+-(NSString*)readinessPath:(File*)file
+{
+    return file.destinationPath;
+}
+
 //get the name of the launch item
 -(NSString*)itemName:(Event*)event
 {
@@ -79,6 +86,19 @@ extern os_log_t logHandle;
     return [[self itemObject:event] lastPathComponent];
 }
 
+//resolve item
+// name is just object's (binary's) last component, so only parse plist once
+-(void)resolveItem:(Item*)item event:(Event*)event
+{
+    //set object
+    item.object = [self itemObject:event];
+    
+    //set name
+    item.name = item.object.lastPathComponent;
+    
+    return;
+}
+
 //get the binary (path) of the launch item
 -(NSString*)itemObject:(Event*)event
 {
@@ -91,7 +111,8 @@ extern os_log_t logHandle;
     
     //get program args
     // path is in args[0]
-    programArgs = getValueFromPlist(event.file.destinationPath, @"ProgramArguments", YES, 1.0f);
+    // note: no wait, as event was parked till plist was ready
+    programArgs = getValueFromPlist(event.file.destinationPath, @"ProgramArguments", YES, 0.0f);
     if(nil != programArgs)
     {
         //when its an array
@@ -115,7 +136,7 @@ extern os_log_t logHandle;
     if( (YES != [itemBinary isKindOfClass:[NSString class]]) ||
         (0 == itemBinary.length) )
     {
-        itemBinary = getValueFromPlist(event.file.destinationPath, @"Program", YES, 1.0f);
+        itemBinary = getValueFromPlist(event.file.destinationPath, @"Program", YES, 0.0f);
         if(YES != [itemBinary isKindOfClass:[NSString class]])
         {
             //unset
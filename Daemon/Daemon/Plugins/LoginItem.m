@@ -127,8 +127,8 @@ extern XPCUserClient* xpcUserClient;
 //update list of login items
 -(void)snapshot:(NSString*)path
 {
-    //plist data
-    NSDictionary* plistData = nil;
+    //bookmark objects
+    NSArray* objects = nil;
     
     //login items
     NSDictionary* loginItems = nil;
@@ -139,12 +139,13 @@ extern XPCUserClient* xpcUserClient;
     //sanity check
     if(0 == path.length) goto bail;
     
-    //load login items
-    plistData = [NSDictionary dictionaryWithContentsOfFile:path];
-    if(0 == plistData.count) goto bail;
+    //load (just) bookmark objects
+    // via (selective) plist query
+    objects = queryPlist(path, @[@"$objects"], NO);
+    if(YES != [objects isKindOfClass:[NSArray class]]) goto bail;
     
     //extract
-    loginItems = [self extractFromBookmark:plistData];
+    loginItems = [self extractFromBookmark:objects];
     if(nil == loginItems) goto bail;
     
     //update list
@@ -169,7 +170,7 @@ bail:
 
 //extract login items from bookmark data
 // newer versions of macOS use this format...
--(NSMutableDictionary*)extractFromBookmark:(NSDictionary*)data
+-(NSMutableDictionary*)extractFromBookmark:(NSArray*)objects
 {
     //login items
     NSMutableDictionary* loginItems = nil;
@@ -190,7 +191,7 @@ bail:
     NSString* path = nil;
     
     //extract current login items
-    for(id object in data[@"$objects"])
+    for(id object in objects)
     {
         //reset
         bookmark = nil;
@@ -265,8 +266,8 @@ bail:
     //latest login item
     NSDictionary* loginItem = nil;
     
-    //plist data
-    NSDictionary* plistData = nil;
+    //bookmark objects
+    NSArray* objects = nil;
     
     //current login items
     NSMutableDictionary* currentLoginItems = nil;
@@ -286,12 +287,13 @@ bail:
     //grab snapshot
     originalLoginItems = self.snapshot[file.destinationPath];
     
-    //load login items
-    plistData = [NSDictionary dictionaryWithContentsOfFile:file.destinationPath];
-    if(0 == plistData.count) goto bail;
+    //load (just) bookmark objects
+    // via (selective) plist query
+    objects = queryPlist(file.destinationPath, @[@"$objects"], NO);
+    if(YES != [objects isKindOfClass:[NSArray class]]) goto bail;
     
     //extract (current) login items
-    currentLoginItems = [self extractFromBookmark:plistData];
+    currentLoginItems = [self extractFromBookmark:objects];
     if(0 == currentLoginItems.count) goto bail;
     
     //dbg msg
@@ -9,6 +9,7 @@
 #import "Item.h"
 #import "Event.h"
 #import "consts.h"
+#import "Monitor.h"
 #import "Processes.h"
 #import "utilities.h"
 #import "Preferences.h"
@@ -20,6 +21,9 @@
 //log handle
 extern os_log_t logHandle;
 
+//monitor
+extern Monitor* monitor;
+
 //prefs obj
 extern Preferences* preferences;
 
@@ -265,64 +269,19 @@ bail:
     //flag
     BOOL responded = NO;
     
-    //result
-    es_respond_result_t result = !ES_RESPOND_RESULT_SUCCESS;
-    
     //dbg msg
     os_log_debug(logHandle, "%{public}@: %{public}@", (ES_AUTH_RESULT_ALLOW == action) ? @"allowing" : @"blocking", event.process.path);
-        
-    //sync
-    @synchronized(event)
+    
+    //complete (pending) decision
+    // fails if already completed (e.g. timeout hit)
+    if(YES != [monitor.processMonitor complete:event result:action])
     {
-        //sanity check(s)
-        if( (NULL == event.esClient) ||
-            (NULL == event.esMessage) )
-        {
-            //dbg msg
-            os_log_debug(logHandle, "esf client/message was unset ...timeout hit?");
-            
-            //bail
-            goto bail;
-        }
-            
-        //take action
-        result = es_respond_auth_result(event.esClient, event.esMessage, action, true);
-        if(ES_RESPOND_RESULT_SUCCESS != result)
-        {
-            //err msg
-            os_log_error(logHandle, "ERROR: 'es_respond_auth_result' failed with: %x", result);
-        }
-        //success
-        else
-        {
-            //dbg msg
-            os_log_debug(logHandle, "%{public}@: %{public}@", (ES_AUTH_RESULT_ALLOW == action) ? @"allowed" : @"blocked", event.process.path);
-        }
-        
-        //signal
-        // as we've avoided the es timeout
-        dispatch_semaphore_signal(event.esSemaphore);
-        
-        //release message
-        if(@available(macOS 11.0, *))
-        {
-            //release
-            es_release_message(event.esMessage);
-        }
-        //free message
-        else
-        {
-            //free
-            es_free_message(event.esMessage);
-        }
-        
-        //unset message
-        event.esMessage = NULL;
-        
-        //unset client
-        event.esClient = NULL;
+        //bail
+        goto bail;
+    }
     
-    } //sync
+    //dbg msg
+    os_log_debug(logHandle, "%{public}@: %{public}@", (ES_AUTH_RESULT_ALLOW == action) ? @"allowed" : @"blocked", event.process.path);
     
     //happy
     responded = YES;
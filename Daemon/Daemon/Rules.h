@@ -11,12 +11,15 @@
 #ifndef Rules_h
 #define Rules_h
 
+#import "RulesJournal.h"
+#import "RulesSnapshot.h"
 #import "XPCUserClient.h"
 
 @import OSLog;
 @import Foundation;
 
 @class Rule;
+@class RuleSet;
 
 
 @interface Rules : NSObject
@@ -26,8 +29,13 @@
 
 /* PROPERTIES */
 
-//rules
-@property(nonatomic, retain)NSMutableDictionary* rules;
+//current version of rules
+// immutable, and atomically replaced (published) by writers
+@property(atomic, retain)RuleSet* current;
+
+//journal
+// of changes since (rules.db) snapshot
+@property(nonatomic, retain)RulesJournal* journal;
 
 
 /* METHODS */
@@ -39,12 +47,17 @@
 -(BOOL)add:(Event*)event;
 
 //find (matching) rule
+// w/o locking, as current version is immutable
 -(Rule*)find:(Event*)event;
 
 //delete rule
 // args: process path, item (path)
 -(BOOL)delete:(Rule*)rule;
 
+//archive (all) rules
+// e.g. for (XPC) client
+-(NSData*)archive;
+
 @end
 
 
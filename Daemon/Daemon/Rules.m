@@ -33,9 +33,506 @@ extern os_log_t logHandle;
 //prefs obj
 extern Preferences* preferences;
 
-@implementation Rules
+/* OBJECT: RULE BUCKET */
+
+/* index of a process's rules
+    process scope: (*, *), one rule
+    file scope: (file, *), keyed by file
+    item (default) scope: (file, object), keyed by file, then object
+ 
+   so finding a rule for an event takes (at most) three hash probes
+*/
+
+@interface RuleBucket : NSObject
+
+//process scope rule
+@property(nonatomic, retain)Rule* processRule;
+
+//file scope rules
+// key: item file
+@property(nonatomic, retain)NSMutableDictionary* fileRules;
+
+//item rules
+// key: item file, then item object
+@property(nonatomic, retain)NSMutableDictionary* itemRules;
+
+//any rule for a (then) validly signed process?
+// if so, process must still be validly signed to match
+@property BOOL requiresValid;
+
+//add rule
+// note: existing (earlier) rule wins
+-(void)add:(Rule*)rule;
+
+//find rule
+// most specific first
+-(Rule*)find:(NSString*)itemFile itemObject:(NSString*)itemObject;
+
+@end
+
+@implementation RuleBucket
+
+@synthesize fileRules;
+@synthesize itemRules;
+@synthesize processRule;
+@synthesize requiresValid;
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //alloc
+        fileRules = [NSMutableDictionary dictionary];
+        itemRules = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+//add rule
+// into bucket matching its scope (i.e. wildcards)
+-(void)add:(Rule*)rule
+{
+    //rule for validly signed process?
+    if( (0 != rule.processSigningID.length) &&
+        (CS_VALID & rule.processCSFlags.unsignedIntegerValue) )
+    {
+        //set
+        self.requiresValid = YES;
+    }
+    
+    //rules w/o file/object never match
+    if( (nil == rule.itemFile) ||
+        (nil == rule.itemObject) )
+    {
+        return;
+    }
+    
+    //any object
+    if(YES == [rule.itemObject isEqualToString:@"*"])
+    {
+        //any file, any object
+        // i.e. process scope
+        if(YES == [rule.itemFile isEqualToString:@"*"])
+        {
+            //add
+            if(nil == self.processRule) self.processRule = rule;
+        }
+        //file, any object
+        // i.e. file scope
+        else if(nil == self.fileRules[rule.itemFile])
+        {
+            //add
+            self.fileRules[rule.itemFile] = rule;
+        }
+        
+        return;
+    }
+    
+    //init
+    if(nil == self.itemRules[rule.itemFile])
+    {
+        //init
+        self.itemRules[rule.itemFile] = [NSMutableDictionary dictionary];
+    }
+    
+    //add
+    if(nil == self.itemRules[rule.itemFile][rule.itemObject])
+    {
+        //add
+        self.itemRules[rule.itemFile][rule.itemObject] = rule;
+    }
+    
+    return;
+}
+
+//find rule
+// most specific first: (file, object), (file, *), then (*, *)
+-(Rule*)find:(NSString*)itemFile itemObject:(NSString*)itemObject
+{
+    //rule
+    Rule* rule = nil;
+    
+    //file and object
+    if( (nil != itemFile) &&
+        (nil != itemObject) )
+    {
+        //probe
+        rule = self.itemRules[itemFile][itemObject];
+    }
+    
+    //any object
+    if( (nil == rule) &&
+        (nil != itemFile) )
+    {
+        //probe
+        rule = self.fileRules[itemFile];
+    }
+    
+    //any file, any object
+    // note: (*, object) rules aren't created, but were allowed, so check those too
+    if(nil == rule)
+    {
+        //probe
+        rule = (nil != self.processRule) ? self.processRule : ((nil != itemObject) ? self.itemRules[@"*"][itemObject] : nil);
+    }
+    
+    return rule;
+}
+
+@end
+
+/* OBJECT: RULE SET */
+
+/* immutable version of (all) rules
+    readers grab the current version (a single, atomic load) and match against it w/o any locks
+    writers (serialized) create a draft of it, modify that, then publish it as the current version
+    old versions are freed (by ARC) once the last reader releases them
+ 
+   note: a draft shares (unmodified) processes' rules w/ the version it was created from,
+         so a process's rules (and bucket) are copied before they are modified
+*/
+
+@interface RuleSet : NSObject
+
+//rules
+// note: never modified once published
+@property(nonatomic, retain, readonly)NSMutableDictionary* rules;
+
+//index of rules
+// key: signing id or process path, value: bucket of rules, by item file/object
+@property(nonatomic, retain, readonly)NSMutableDictionary* buckets;
+
+//mapped snapshot
+// matched against in place, until rules are first modified
+@property(nonatomic, retain, readonly)RulesSnapshot* snapshot;
+
+//init
+// with (in-memory) rules, or a (mapped) snapshot
+-(id)initWithRules:(NSMutableDictionary*)rules snapshot:(RulesSnapshot*)snapshot;
+
+//draft a new version
+// materializes snapshot, as it's read-only
+-(RuleSet*)draft;
+
+//insert rule
+// unless there's already a rule for its (process, file, object)
+-(void)insert:(Rule*)rule;
+
+//remove rule
+-(BOOL)remove:(Rule*)rule;
+
+//find (matching) rule
+-(Rule*)find:(Event*)event;
+
+//all rules
+// in format of rules dictionary, w/o modifying this version
+-(NSDictionary*)allRules;
+
+@end
+
+@implementation RuleSet
 
 @synthesize rules;
+@synthesize buckets;
+@synthesize snapshot;
+
+//init
+// index (in-memory) rules
+-(id)initWithRules:(NSMutableDictionary*)initialRules snapshot:(RulesSnapshot*)mappedSnapshot
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //save
+        snapshot = mappedSnapshot;
+        
+        //save
+        rules = (nil != initialRules) ? initialRules : [NSMutableDictionary dictionary];
+        
+        //alloc
+        buckets = [NSMutableDictionary dictionary];
+        
+        //build index
+        for(NSString* key in rules)
+        {
+            //index
+            [self indexKey:key];
+        }
+    }
+    
+    return self;
+}
+
+//draft a new version
+// (shallow) copies of rules and index, or materialized snapshot
+-(RuleSet*)draft
+{
+    //draft
+    RuleSet* draft = nil;
+    
+    //snapshot mapped?
+    // materialize it
+    if(nil != self.snapshot)
+    {
+        //dbg msg
+        os_log_debug(logHandle, "materializing %lu rules from snapshot", (unsigned long)self.snapshot.ruleCount);
+        
+        //init
+        draft = [[RuleSet alloc] initWithRules:[self.snapshot rules] snapshot:nil];
+    }
+    //copy
+    else
+    {
+        //init
+        draft = [[RuleSet alloc] initWithRules:nil snapshot:nil];
+        
+        //copy
+        // processes' rules (and buckets) are shared, till modified
+        [draft.rules setDictionary:self.rules];
+        [draft.buckets setDictionary:self.buckets];
+    }
+    
+    return draft;
+}
+
+//copy a process's rules
+// so they can be modified w/o affecting any published version
+-(void)copyKey:(NSString*)key
+{
+    //copy
+    NSMutableDictionary* processRules = [self.rules[key] mutableCopy];
+    
+    //copy (array of) rules
+    processRules[KEY_RULES] = [self.rules[key][KEY_RULES] mutableCopy];
+    
+    //save
+    self.rules[key] = processRules;
+    
+    return;
+}
+
+//(re)build index for a key
+// note: new bucket, as existing one may be shared
+-(void)indexKey:(NSString*)key
+{
+    //bucket
+    RuleBucket* bucket = nil;
+    
+    //no rules?
+    if(0 == [self.rules[key][KEY_RULES] count])
+    {
+        //remove
+        [self.buckets removeObjectForKey:key];
+        
+        return;
+    }
+    
+    //init
+    bucket = [[RuleBucket alloc] init];
+    
+    //add each
+    // in order, so earlier rules win
+    for(Rule* rule in self.rules[key][KEY_RULES])
+    {
+        //add
+        [bucket add:rule];
+    }
+    
+    //save
+    self.buckets[key] = bucket;
+    
+    return;
+}
+
+//insert rule
+// and index it, unless there's already a rule for its (process, file, object)
+-(void)insert:(Rule*)rule
+{
+    //key
+    NSString* key = nil;
+    
+    //key
+    // bundle ID or path
+    key = (0 != rule.processSigningID.length) ? rule.processSigningID : rule.processPath;
+    if(nil == key) return;
+    
+    //new process?
+    if(nil == self.rules[key])
+    {
+        //init
+        self.rules[key] = [NSMutableDictionary dictionary];
+        
+        //init (proc) rules
+        self.rules[key][KEY_RULES] = [NSMutableArray array];
+        
+        //add cs flags
+        if(nil != rule.processCSFlags) self.rules[key][KEY_CS_FLAGS] = rule.processCSFlags;
+    }
+    //existing rule?
+    // e.g. journal record that's already in snapshot
+    else if(NSNotFound != [self indexOfRule:rule key:key])
+    {
+        return;
+    }
+    //existing process
+    // copy, as may be shared
+    else
+    {
+        //copy
+        [self copyKey:key];
+    }
+    
+    //add rule
+    [self.rules[key][KEY_RULES] addObject:rule];
+    
+    //(re)index process's rules
+    [self indexKey:key];
+    
+    return;
+}
+
+//index of rule
+// matches on item file and object
+-(NSUInteger)indexOfRule:(Rule*)rule key:(NSString*)key
+{
+    //find
+    return [self.rules[key][KEY_RULES] indexOfObjectPassingTest:^BOOL(Rule* currentRule, NSUInteger index, BOOL* stop)
+    {
+        //is match?
+        return ( (YES == [currentRule.itemFile isEqualToString:rule.itemFile]) &&
+                 ( ((nil == currentRule.itemObject) && (nil == rule.itemObject)) ||
+                   (YES == [currentRule.itemObject isEqualToString:rule.itemObject]) ) );
+    }];
+}
+
+//remove rule
+// and (re)index process's rules
+-(BOOL)remove:(Rule*)rule
+{
+    //key
+    NSString* key = nil;
+    
+    //rule index
+    NSUInteger ruleIndex = NSNotFound;
+    
+    //key
+    // bundle ID or path
+    key = (0 != rule.processSigningID.length) ? rule.processSigningID : rule.processPath;
+    if(nil == key) return NO;
+    
+    //find matching rule
+    ruleIndex = [self indexOfRule:rule key:key];
+    if(NSNotFound == ruleIndex)
+    {
+        return NO;
+    }
+    
+    //dbg msg
+    os_log_debug(logHandle, "found rule at index: %lu", (unsigned long)ruleIndex);
+    
+    //copy
+    // as may be shared
+    [self copyKey:key];
+    
+    //remove
+    [self.rules[key][KEY_RULES] removeObjectAtIndex:ruleIndex];
+    
+    //last (process rule?)
+    if(0 == ((NSMutableArray*)self.rules[key][KEY_RULES]).count)
+    {
+        //dbg msg
+        os_log_debug(logHandle, "rule was only one for process, so removing process entry");
+        
+        //remove process
+        [self.rules removeObjectForKey:key];
+    }
+    
+    //(re)index process's rules
+    [self indexKey:key];
+    
+    return YES;
+}
+
+//find (matching) rule
+// via (mapped) snapshot, or index, so (at most) three hash probes
+-(Rule*)find:(Event*)event
+{
+    //matching rule
+    Rule* matchingRule = nil;
+    
+    //key
+    NSString* key = nil;
+    
+    //bucket
+    RuleBucket* bucket = nil;
+    
+    //key
+    // bundle ID or path
+    key = (0 != event.file.process.signingID.length) ? event.file.process.signingID : event.file.process.path;
+    
+    //dbg msg
+    os_log_debug(logHandle, "key for rule: %{public}@", key);
+    
+    //snapshot (still) mapped?
+    // match against it in place
+    if(nil != self.snapshot)
+    {
+        //find
+        matchingRule = [self.snapshot find:key csFlags:event.file.process.csFlags itemFile:event.file.destinationPath itemObject:event.item.object];
+        
+        //done
+        goto bail;
+    }
+    
+    //no match on process
+    bucket = (nil != key) ? self.buckets[key] : nil;
+    if(nil == bucket)
+    {
+        //dbg msg
+        os_log_debug(logHandle, "%{public}@ didn't match any rules", key);
+        
+        //bail
+        goto bail;
+    }
+    
+    //rule(s) for validly signed process?
+    //  make sure if was valid, still is
+    if( (YES == bucket.requiresValid) &&
+        !(CS_VALID & event.file.process.csFlags.unsignedIntegerValue) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: %{public}@ is not longer validly signed (csflags: %#lx)", key, event.file.process.csFlags.unsignedIntegerValue);
+        
+        //bail
+        goto bail;
+    }
+    
+    //find
+    // same startup item and same path, or wildcard (*)
+    matchingRule = [bucket find:event.file.destinationPath itemObject:event.item.object];
+    
+bail:
+    return matchingRule;
+}
+
+//all rules
+// snapshot is materialized into a (temporary) dictionary, as version is immutable
+-(NSDictionary*)allRules
+{
+    return (nil != self.snapshot) ? [self.snapshot rules] : self.rules;
+}
+
+@end
+
+@implementation Rules
+
+@synthesize current;
+@synthesize journal;
 
 //init method
 -(id)init
@@ -44,14 +541,29 @@ extern Preferences* preferences;
     self = [super init];
     if(nil != self)
     {
-        //alloc rules dictionary
-        rules = [NSMutableDictionary dictionary];
+        //init (empty) version
+        current = [[RuleSet alloc] initWithRules:nil snapshot:nil];
+        
+        //init journal
+        // compaction snapshots (all) rules
+        journal = [[RulesJournal alloc] init:[INSTALL_DIRECTORY stringByAppendingPathComponent:RULES_JOURNAL_FILE] snapshot:^BOOL{
+            
+            //sync
+            // w/ writers
+            @synchronized(self)
+            {
+                //save
+                return [self save];
+            }
+        }];
     }
     
     return self;
 }
 
 //load rules from disk
+// map snapshot (or migrate legacy rules), then replay journal on top
+// note: a corrupt snapshot is moved aside, and rules rebuilt (from legacy rules, if any, and journal)
 -(BOOL)load
 {
     //result
@@ -63,63 +575,231 @@ extern Preferences* preferences;
     //rule's file
     NSString* rulesFile = nil;
     
+    //snapshot file
+    NSString* snapshotFile = nil;
+    
     //archived rules
     NSData* archivedRules = nil;
     
+    //unarchived rules
+    NSMutableDictionary* unarchivedRules = nil;
+    
+    //snapshot
+    RulesSnapshot* snapshot = nil;
+    
+    //loaded version
+    RuleSet* loaded = nil;
+    
+    //replayed version
+    __block RuleSet* replayed = nil;
+    
+    //flag
+    BOOL migrate = NO;
+    
+    //flag
+    BOOL rebuild = NO;
+    
+    //(re)mapped snapshot
+    // to verify it, before removing legacy rules
+    RulesSnapshot* verified = nil;
+    
     //init path to rule's file
     rulesFile = [INSTALL_DIRECTORY stringByAppendingPathComponent:RULES_FILE];
     
+    //init path to snapshot file
+    snapshotFile = [INSTALL_DIRECTORY stringByAppendingPathComponent:RULES_SNAPSHOT_FILE];
+    
     //dbg msg
-    os_log_debug(logHandle, "loading rules from: %{public}@", rulesFile);
+    os_log_debug(logHandle, "loading rules from: %{public}@", snapshotFile);
     
-    //no rules (yet)?
-    if(YES != [[NSFileManager defaultManager] fileExistsAtPath:rulesFile])
+    //sync
+    // w/ writers
+    @synchronized(self)
     {
-        //dbg msg
-        os_log_debug(logHandle, "%{public}@ not found, no rules yet?", rulesFile);
-        
-        //no error though...
-        result = YES;
-        
-        //bail
-        goto bail;
+    
+    //map snapshot
+    // rules are matched in place, so nothing (else) to load
+    if(YES == [[NSFileManager defaultManager] fileExistsAtPath:snapshotFile])
+    {
+        //map
+        snapshot = [[RulesSnapshot alloc] initWithFile:snapshotFile];
+        if(nil == snapshot)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: rules snapshot %{public}@ is corrupt, will move aside and rebuild", RULES_SNAPSHOT_FILE);
+            
+            //move aside
+            // so it's kept (for analysis), but not loaded again
+            [self moveAside:snapshotFile];
+            
+            //set flag
+            // save rebuilt rules, as new snapshot
+            rebuild = YES;
+        }
     }
     
-    //load archived rules from disk
-    archivedRules = [NSData dataWithContentsOfFile:rulesFile];
-    if(nil == archivedRules)
+    //no snapshot?
+    // load legacy rules (if any)
+    if(nil == snapshot)
     {
-        //err msg
-        os_log_error(logHandle, "ERROR: failed to load rules from: %{public}@", RULES_FILE);
-        
-        //bail
-        goto bail;
+        //no legacy rules?
+        if(YES != [[NSFileManager defaultManager] fileExistsAtPath:rulesFile])
+        {
+            //dbg msg
+            os_log_debug(logHandle, "%{public}@ not found, no rules yet?", rulesFile);
+        }
+        //legacy rules
+        // load, then migrate (below)
+        else
+        {
+            //dbg msg
+            os_log_debug(logHandle, "found legacy rules, %{public}@, will migrate", rulesFile);
+            
+            //load archived rules from disk
+            archivedRules = [NSData dataWithContentsOfFile:rulesFile];
+            if(nil != archivedRules)
+            {
+                //unarchive
+                unarchivedRules = [NSKeyedUnarchiver unarchivedObjectOfClasses:[NSSet setWithArray: @[[NSMutableDictionary class], [NSMutableArray class], [NSString class], [NSNumber class], [Rule class]]]
+                                                                      fromData:archivedRules error:&error];
+            }
+            
+            //failed?
+            // don't bail, just (re)build from journal, over an empty set
+            if(nil == unarchivedRules)
+            {
+                //err msg
+                os_log_error(logHandle, "ERROR: failed to load/unarchive rules from: %{public}@ (%{public}@), will rebuild from journal", RULES_FILE, error);
+            }
+            //set flag
+            else
+            {
+                migrate = YES;
+            }
+        }
     }
     
-    //unarchive
-    self. rules = [NSKeyedUnarchiver unarchivedObjectOfClasses:[NSSet setWithArray: @[[NSMutableDictionary class], [NSMutableArray class], [NSString class], [NSNumber class], [Rule class]]]
-                                                       fromData:archivedRules error:&error];
-    if(nil == self.rules)
+    //init version
+    // (also) indexes any in-memory rules
+    loaded = [[RuleSet alloc] initWithRules:unarchivedRules snapshot:snapshot];
+    
+    //replay journal
+    // any changes since snapshot, into a single (new) version
+    if(YES != [self.journal replay:^(NSUInteger op, Rule* rule) {
+        
+        //draft
+        // once, for all records
+        if(nil == replayed) replayed = [loaded draft];
+        
+        //add
+        if(JournalOpAdd == op)
+        {
+            //insert
+            [replayed insert:rule];
+        }
+        //delete
+        else if(JournalOpDelete == op)
+        {
+            //remove
+            [replayed remove:rule];
+        }
+    }])
     {
         //err msg
-        os_log_error(logHandle, "ERROR: failed to unarchive rules from: %{public}@ (%{public}@)", RULES_FILE, error);
+        os_log_error(logHandle, "ERROR: failed to replay rules journal");
         
-        //bail
-        goto bail;
+        //don't bail, as snapshot was loaded
+    }
+    
+    //publish
+    self.current = (nil != replayed) ? replayed : loaded;
+    
+    //migrate legacy rules?
+    // or rebuilt (corrupt) snapshot? save as (new) snapshot
+    if( (YES == migrate) ||
+        (YES == rebuild) )
+    {
+        //save
+        if(YES != [self save])
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to save (migrated/rebuilt) rules to: %{public}@", RULES_SNAPSHOT_FILE);
+        }
+        //migrated?
+        // only remove legacy rules once (new) snapshot is verified
+        else if(YES == migrate)
+        {
+            //verify
+            // i.e. (re)map and validate
+            verified = [[RulesSnapshot alloc] initWithFile:snapshotFile];
+            if(nil == verified)
+            {
+                //err msg
+                os_log_error(logHandle, "ERROR: failed to verify migrated rules in: %{public}@, keeping %{public}@", RULES_SNAPSHOT_FILE, RULES_FILE);
+            }
+            //remove legacy
+            else if(YES != [[NSFileManager defaultManager] removeItemAtPath:rulesFile error:&error])
+            {
+                //err msg
+                os_log_error(logHandle, "ERROR: failed to remove legacy rules: %{public}@ (%{public}@)", rulesFile, error);
+            }
+            else
+            {
+                //dbg msg
+                os_log_debug(logHandle, "migrated legacy rules to: %{public}@", RULES_SNAPSHOT_FILE);
+            }
+        }
     }
+        
+    } //sync
     
     //dbg msg
-    os_log_debug(logHandle, "loaded %lu rules from: %{public}@", (unsigned long)self.rules.count, RULES_FILE);
+    os_log_debug(logHandle, "loaded rules (%lu processes) from: %{public}@", (nil != self.current.snapshot) ? (unsigned long)self.current.snapshot.processCount : (unsigned long)self.current.rules.count, RULES_SNAPSHOT_FILE);
     
     //happy
     result = YES;
     
-bail:
-    
     return result;
 }
 
+//move (corrupt) file aside
+// renamed w/ timestamp, or if that fails, removed
+-(void)moveAside:(NSString*)path
+{
+    //error
+    NSError* error = nil;
+    
+    //destination
+    NSString* destination = nil;
+    
+    //init destination
+    destination = [NSString stringWithFormat:@"%@.corrupt.%lu", path, (unsigned long)time(NULL)];
+    
+    //move
+    if(YES == [[NSFileManager defaultManager] moveItemAtPath:path toPath:destination error:&error])
+    {
+        //dbg msg
+        os_log_debug(logHandle, "moved %{public}@ to %{public}@", path, destination);
+        
+        //done
+        return;
+    }
+    
+    //err msg
+    os_log_error(logHandle, "ERROR: failed to move %{public}@ aside (%{public}@), removing", path, error);
+    
+    //remove
+    if(YES != [[NSFileManager defaultManager] removeItemAtPath:path error:&error])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to remove %{public}@ (%{public}@)", path, error);
+    }
+    
+    return;
+}
+
 //add a rule
+// publishes a new version, then journals it
 -(BOOL)add:(Event*)event
 {
     //result
@@ -130,12 +810,19 @@ bail:
     
     //key
     NSString* key = nil;
+    
+    //draft
+    RuleSet* draft = nil;
+    
+    //journal sequence
+    uint64_t sequence = 0;
  
     //log msg
     os_log_debug(logHandle, "adding rule");
     
-    //sync to access
-    @synchronized(self.rules)
+    //sync
+    // w/ (other) writers, readers don't lock
+    @synchronized(self)
     {
         
     //existing rule?
@@ -163,24 +850,23 @@ bail:
     //dbg msg
     os_log_debug(logHandle, "key for rule: %{public}@", key);
     
-    //new process?
-    if(nil == self.rules[key])
-    {
-        //init
-        self.rules[key] = [NSMutableDictionary dictionary];
-        
-        //init (proc) rules
-        self.rules[key][KEY_RULES] = [NSMutableArray array];
-        
-        //add cs flags
-        self.rules[key][KEY_CS_FLAGS] = event.file.process.csFlags;
-    }
+    //draft
+    draft = [self.current draft];
     
     //(now) add rule
-    [self.rules[key][KEY_RULES] addObject:rule];
+    [draft insert:rule];
     
-    //save to disk
-    if(YES != [self save])
+    //publish
+    self.current = draft;
+    
+    //journal
+    sequence = [self.journal append:JournalOpAdd rule:rule];
+        
+    } //sync
+    
+    //commit
+    // outside of lock, so other writers aren't blocked by disk i/o
+    if(YES != [self.journal commit:sequence])
     {
         //err msg
         os_log_error(logHandle, "ERROR: failed to save rules");
@@ -191,8 +877,6 @@ bail:
     
     //happy
     added = YES;
-        
-    } //sync
     
 bail:
     
@@ -200,126 +884,38 @@ bail:
 }
 
 //find (matching) rule
+// in current version, w/o any locks
 -(Rule*)find:(Event*)event
 {
-    //matching rule
-    Rule* matchingRule = nil;
-    
-    //key
-    NSString* key = nil;
-    
-    //sync to access
-    @synchronized(self.rules)
-    {
-        //key
-        // bundle ID or path
-        key = (0 != event.file.process.signingID.length) ? event.file.process.signingID : event.file.process.path;
-        
-        //dbg msg
-        os_log_debug(logHandle, "key for rule: %{public}@", key);
-        
-        //no match on process
-        if(nil == self.rules[key])
-        {
-            //dbg msg
-            os_log_debug(logHandle, "%{public}@ didn't match any rules", key);
-            
-            //bail
-            goto bail;
-        }
-        
-        //check all (process's) rules
-        // same startup item and same path
-        // note: * is a wildcard, meaning any match
-        NSArray<Rule *> *rules = self.rules[key][KEY_RULES];
-        NSUInteger idx = [rules indexOfObjectWithOptions:NSEnumerationConcurrent passingTest:^BOOL(Rule * _Nonnull rule, NSUInteger idx, BOOL * _Nonnull stop) {
-            //rule has signing id?
-            //  make sure if was valid, still is
-            if(0 != rule.processSigningID.length)
-            {
-                //(still) valid?
-                if( (CS_VALID & rule.processCSFlags.unsignedIntegerValue) &&
-                    !(CS_VALID & event.file.process.csFlags.unsignedIntegerValue) )
-                {
-                    //err msg
-                    os_log_error(logHandle, "ERROR: %{public}@ is not longer validly signed (csflags: %#lx -> %#lx", key, (unsigned long)rule.processCSFlags.unsignedIntegerValue, event.file.process.csFlags.unsignedIntegerValue);
-
-                    //bail here
-                    *stop = YES;
-                    return NO;
-                }
-            }
-
-            //path mismatch?
-            if( (YES != [rule.itemFile isEqualToString:@"*"]) &&
-                (YES != [rule.itemFile isEqualToString:event.file.destinationPath]) )
-            {
-                //next
-                return NO;
-            }
-
-            //item mismatch
-            if( (YES != [rule.itemObject isEqualToString:@"*"]) &&
-                (YES != [rule.itemObject isEqualToString:event.item.object]) )
-            {
-                //next
-                return NO;
-            }
-
-            return YES;
-        }];
-
-        if (idx != NSNotFound) {
-            matchingRule = rules[idx];
-        }
-    }
-    
-bail:
-    return matchingRule;
+    //find
+    return [self.current find:event];
 }
 
 //delete rule
+// publishes a new version, then journals it
 -(BOOL)delete:(Rule*)rule
 {
     //result
     BOOL result = NO;
     
-    //key
-    NSString* key = nil;
+    //draft
+    RuleSet* draft = nil;
     
-    //(process) rules
-
-    //rule index
-    __block NSUInteger ruleIndex = -1;
+    //journal sequence
+    uint64_t sequence = 0;
     
     //dbg msg
     os_log_debug(logHandle, "deleting rule, %{public}@", rule);
     
-    //sync to access
-    @synchronized(self.rules)
+    //sync
+    // w/ (other) writers, readers don't lock
+    @synchronized(self)
     {
-        //key
-        // bundle ID or path
-        key = (0 != rule.processSigningID.length) ? rule.processSigningID : rule.processPath;
+        //draft
+        draft = [self.current draft];
         
-        //remove matching rule
-        [self.rules[key][KEY_RULES] enumerateObjectsUsingBlock:^(Rule* currentRule, NSUInteger index, BOOL* stop)
-        {
-            //is match?
-            if( (YES == [currentRule.itemFile isEqualToString:rule.itemFile]) &&
-                 ( ((nil == currentRule.itemObject) && (nil == rule.itemObject)) ||
-                   (YES == [currentRule.itemObject isEqualToString:rule.itemObject]) ) )
-            {
-                //save index
-                ruleIndex = index;
-            
-                //stop
-                *stop = YES;
-            }
-        }];
-        
-        //not found!?
-        if(-1 == ruleIndex)
+        //remove
+        if(YES != [draft remove:rule])
         {
             //err msg
             os_log_error(logHandle, "ERROR: failed to find rule");
@@ -328,35 +924,22 @@ bail:
             goto bail;
         }
         
-        //remove
-        if(-1 != ruleIndex)
-        {
-            //dbg msg
-            os_log_debug(logHandle, "found rule at index: %lu", (unsigned long)ruleIndex);
-            
-            //remove
-            [self.rules[key][KEY_RULES] removeObjectAtIndex:ruleIndex];
-            
-            //last (process rule?)
-            if(0 == ((NSMutableArray*)self.rules[key][KEY_RULES]).count)
-            {
-                //dbg msg
-                os_log_debug(logHandle, "rule was only one for process, so removing process entry");
-                
-                //remove process
-                [self.rules removeObjectForKey:key];
-            }
-        }
+        //publish
+        self.current = draft;
         
-        //save to disk
-        if(YES != [self save])
-        {
-            //err msg
-            os_log_error(logHandle, "ERROR: failed to save (updated) rules");
-            
-            //bail
-            goto bail;
-        }
+        //journal
+        sequence = [self.journal append:JournalOpDelete rule:rule];
+    }
+    
+    //commit
+    // outside of lock, so other writers aren't blocked by disk i/o
+    if(YES != [self.journal commit:sequence])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to save (updated) rules");
+        
+        //bail
+        goto bail;
     }
         
     //happy
@@ -368,39 +951,42 @@ bail:
 }
 
 //save to disk
+// i.e. (full) snapshot, that journal is compacted into
+// note: caller must hold (writer) lock, so version is (also) latest journaled
 -(BOOL)save
 {
     //result
     BOOL result = NO;
     
-    //error
-    NSError* error = nil;
+    //version
+    RuleSet* version = nil;
     
-    //rule's file
-    NSString* rulesFile = nil;
+    //snapshot file
+    NSString* snapshotFile = nil;
     
-    //archived rules
-    NSData* archivedRules = nil;
+    //init path to snapshot file
+    snapshotFile = [INSTALL_DIRECTORY stringByAppendingPathComponent:RULES_SNAPSHOT_FILE];
     
-    //init path to rule's file
-    rulesFile = [INSTALL_DIRECTORY stringByAppendingPathComponent:RULES_FILE];
+    //grab current version
+    version = self.current;
     
-    //archive rules
-    archivedRules = [NSKeyedArchiver archivedDataWithRootObject:self.rules requiringSecureCoding:YES error:&error];
-    if(nil == archivedRules)
+    //(still) mapped snapshot?
+    // no changes, so nothing to save
+    if(nil != version.snapshot)
     {
-        //err msg
-        os_log_error(logHandle, "ERROR: failed to archive rules: %{public}@", error);
+        //happy
+        result = YES;
         
         //bail
         goto bail;
     }
     
     //write out
-    if(YES != [archivedRules writeToFile:rulesFile atomically:YES])
+    // also syncs, as journal is truncated once snapshot is saved
+    if(YES != [RulesSnapshot write:version.rules toFile:snapshotFile])
     {
         //err msg
-        os_log_error(logHandle, "ERROR: failed to save archived rules to: %{public}@", rulesFile);
+        os_log_error(logHandle, "ERROR: failed to save rules to: %{public}@", snapshotFile);
         
         //bail
         goto bail;
@@ -414,4 +1000,25 @@ bail:
     return result;
 }
 
+//archive (all) rules
+// from current version, so consistent w/o any locks
+-(NSData*)archive
+{
+    //archived rules
+    NSData* archivedRules = nil;
+    
+    //error
+    NSError* error = nil;
+    
+    //archive
+    archivedRules = [NSKeyedArchiver archivedDataWithRootObject:[self.current allRules] requiringSecureCoding:YES error:&error];
+    if(nil == archivedRules)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to archive rules: %{public}@", error);
+    }
+    
+    return archivedRules;
+}
+
 @end
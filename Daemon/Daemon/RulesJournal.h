@@ -0,0 +1,66 @@
+//
+//  file: RulesJournal.h
+//  project: BlockBlock (launch daemon)
+//  description: append-only journal of rule changes (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+#ifndef RulesJournal_h
+#define RulesJournal_h
+
+@import Foundation;
+
+@class Rule;
+
+/* CONSTS */
+
+//record magic
+#define JOURNAL_RECORD_MAGIC 0x524a4242
+
+//journal size (bytes) that triggers compaction
+#define JOURNAL_COMPACT_SIZE (512 * 1024)
+
+//journal records that trigger compaction
+#define JOURNAL_COMPACT_RECORDS 1024
+
+//ops
+enum JournalOp{JournalOpAdd = 1, JournalOpDelete = 2};
+
+/* TYPEDEFS */
+
+//block for replay
+typedef void (^JournalReplayBlock)(NSUInteger op, Rule* rule);
+
+//block for snapshot
+// writes (all) rules to disk, returns YES on success
+typedef BOOL (^JournalSnapshotBlock)(void);
+
+@interface RulesJournal : NSObject
+
+/* METHODS */
+
+//init
+// snapshot block is invoked (in the background) to compact the journal
+-(id)init:(NSString*)path snapshot:(JournalSnapshotBlock)snapshot;
+
+//replay journal
+// stops at first torn/corrupt record, which (and anything after) is truncated
+-(BOOL)replay:(JournalReplayBlock)block;
+
+//append a record
+// buffered till commit, returns its sequence number (0 on error)
+-(uint64_t)append:(NSUInteger)op rule:(Rule*)rule;
+
+//commit
+// waits until record (and all before it) is durable, batching concurrent commits into one write/fsync
+-(BOOL)commit:(uint64_t)sequence;
+
+//compact
+// (background) snapshot all rules, then truncate journal
+-(void)compact;
+
+@end
+
+#endif /* RulesJournal_h */
@@ -0,0 +1,533 @@
+//
+//  file: RulesJournal.m
+//  project: BlockBlock (launch daemon)
+//  description: append-only journal of rule changes
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+//  instead of re-archiving all rules on each add/delete, a (small) record is appended to a
+//  journal. records are buffered, and concurrent commits are written (and fsync'd) together.
+//  once the journal grows, it's compacted: all rules are written to the (rules.db) snapshot,
+//  and the journal is truncated. on load, the journal is replayed on top of the snapshot.
+//
+//  note: records are add/delete of a rule (i.e. set semantics), so replaying records whose
+//  changes are already in the snapshot (e.g. crash between snapshot and truncation) is harmless
+
+@import OSLog;
+
+#import <fcntl.h>
+#import <unistd.h>
+
+#import "Rule.h"
+#import "RulesJournal.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+/* TYPEDEFS */
+
+//record header
+// followed by (archived rule) payload
+typedef struct
+{
+    //magic
+    uint32_t magic;
+
+    //length of payload
+    uint32_t length;
+
+    //checksum
+    // crc32, over op and payload
+    uint32_t checksum;
+
+    //op
+    uint32_t op;
+
+} JournalRecordHeader;
+
+/* FUNCTIONS */
+
+//crc32
+static uint32_t crc32Update(uint32_t crc, const uint8_t* bytes, size_t length);
+
+@interface RulesJournal ()
+{
+    //journal fd
+    int fd;
+
+    //sequence of last appended record
+    uint64_t appended;
+
+    //sequence of last durable record
+    uint64_t durable;
+
+    //records buffered
+    uint64_t buffered;
+
+    //records in journal
+    uint64_t records;
+
+    //size of journal
+    off_t size;
+}
+
+//path
+@property(nonatomic, retain)NSString* path;
+
+//snapshot block
+@property(nonatomic, copy)JournalSnapshotBlock snapshot;
+
+//queue
+// serializes writes, and compaction
+@property(nonatomic, retain)dispatch_queue_t queue;
+
+//buffered records
+@property(nonatomic, retain)NSMutableData* buffer;
+
+@end
+
+@implementation RulesJournal
+
+@synthesize path;
+@synthesize queue;
+@synthesize buffer;
+@synthesize snapshot;
+
+//init
+-(id)init:(NSString*)journalPath snapshot:(JournalSnapshotBlock)snapshotBlock
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init
+        fd = -1;
+        path = journalPath;
+        snapshot = snapshotBlock;
+        buffer = [NSMutableData data];
+        queue = dispatch_queue_create("com.objective-see.blockblock.journal", DISPATCH_QUEUE_SERIAL);
+    }
+
+    return self;
+}
+
+//dealloc
+// close journal
+-(void)dealloc
+{
+    //close
+    if(-1 != fd)
+    {
+        close(fd);
+    }
+
+    return;
+}
+
+//replay journal
+// invoke block for each (valid) record, then truncate anything after last valid one
+-(BOOL)replay:(JournalReplayBlock)block
+{
+    //result
+    BOOL result = NO;
+
+    //journal
+    NSData* journal = nil;
+
+    //offset
+    NSUInteger offset = 0;
+
+    //header
+    JournalRecordHeader header = {0};
+
+    //count
+    NSUInteger count = 0;
+
+    //no journal (yet)?
+    if(YES != [[NSFileManager defaultManager] fileExistsAtPath:self.path])
+    {
+        //happy
+        result = YES;
+
+        //bail
+        goto bail;
+    }
+
+    //load
+    journal = [NSData dataWithContentsOfFile:self.path options:NSDataReadingMappedIfSafe error:nil];
+    if(nil == journal)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to load rules journal from: %{public}@", self.path);
+
+        //bail
+        goto bail;
+    }
+
+    //replay each record
+    while(offset + sizeof(header) <= journal.length)
+    {
+        //rule
+        Rule* rule = nil;
+
+        //payload
+        NSData* payload = nil;
+
+        //checksum
+        uint32_t checksum = 0;
+
+        //header
+        memcpy(&header, (const uint8_t*)journal.bytes + offset, sizeof(header));
+
+        //bad magic, or torn?
+        if( (JOURNAL_RECORD_MAGIC != header.magic) ||
+            (offset + sizeof(header) + header.length > journal.length) )
+        {
+            //done
+            break;
+        }
+
+        //payload
+        payload = [journal subdataWithRange:NSMakeRange(offset + sizeof(header), header.length)];
+
+        //checksum
+        checksum = crc32Update(0, (const uint8_t*)&header.op, sizeof(header.op));
+        checksum = crc32Update(checksum, payload.bytes, payload.length);
+        if(checksum != header.checksum)
+        {
+            //done
+            break;
+        }
+
+        //unarchive rule
+        rule = [NSKeyedUnarchiver unarchivedObjectOfClass:[Rule class] fromData:payload error:nil];
+        if(nil == rule)
+        {
+            //done
+            break;
+        }
+
+        //replay
+        block(header.op, rule);
+
+        //next
+        offset += sizeof(header) + header.length;
+        count++;
+    }
+
+    //torn/corrupt tail?
+    // truncate, so new records are appended after last valid one
+    if(offset != journal.length)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: rules journal is torn/corrupt at offset %lu (of %lu), truncating", (unsigned long)offset, (unsigned long)journal.length);
+
+        //truncate
+        if(0 != truncate(self.path.fileSystemRepresentation, (off_t)offset))
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to truncate rules journal (error: %d)", errno);
+
+            //bail
+            goto bail;
+        }
+    }
+
+    //save
+    records = count;
+    size = (off_t)offset;
+
+    //dbg msg
+    os_log_debug(logHandle, "replayed %lu record(s) from rules journal", (unsigned long)count);
+
+    //replayed records?
+    // fold them into snapshot
+    if(0 != count)
+    {
+        //compact
+        [self compact];
+    }
+
+    //happy
+    result = YES;
+
+bail:
+
+    return result;
+}
+
+//append a record
+// buffered till commit
+-(uint64_t)append:(NSUInteger)op rule:(Rule*)rule
+{
+    //sequence
+    uint64_t sequence = 0;
+
+    //header
+    JournalRecordHeader header = {0};
+
+    //payload
+    NSData* payload = nil;
+
+    //error
+    NSError* error = nil;
+
+    //archive rule
+    payload = [NSKeyedArchiver archivedDataWithRootObject:rule requiringSecureCoding:YES error:&error];
+    if(nil == payload)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to archive rule: %{public}@", error);
+
+        //bail
+        goto bail;
+    }
+
+    //init header
+    header.magic = JOURNAL_RECORD_MAGIC;
+    header.length = (uint32_t)payload.length;
+    header.op = (uint32_t)op;
+    header.checksum = crc32Update(0, (const uint8_t*)&header.op, sizeof(header.op));
+    header.checksum = crc32Update(header.checksum, payload.bytes, payload.length);
+
+    //sync
+    @synchronized(self)
+    {
+        //add
+        [self.buffer appendBytes:&header length:sizeof(header)];
+        [self.buffer appendData:payload];
+
+        //inc
+        buffered++;
+        sequence = ++appended;
+    }
+
+bail:
+
+    return sequence;
+}
+
+//commit
+// waits until record (and all before it) is durable
+-(BOOL)commit:(uint64_t)sequence
+{
+    //flag
+    __block BOOL committed = NO;
+
+    //sanity check
+    if(0 == sequence) return NO;
+
+    //flush (on queue)
+    // any commits waiting behind this one find their records already durable
+    dispatch_sync(self.queue, ^{
+
+        //not yet durable?
+        if(sequence > self->durable)
+        {
+            //flush
+            [self flush];
+        }
+
+        //durable?
+        committed = (sequence <= self->durable);
+    });
+
+    return committed;
+}
+
+//flush
+// write all buffered records, then fsync
+// note: must be called on queue
+-(void)flush
+{
+    //data
+    NSData* data = nil;
+
+    //last sequence
+    uint64_t last = 0;
+
+    //count
+    uint64_t count = 0;
+
+    //written
+    size_t written = 0;
+
+    //grab buffered records
+    @synchronized(self)
+    {
+        //grab
+        data = [self.buffer copy];
+        last = appended;
+        count = buffered;
+
+        //reset
+        [self.buffer setLength:0];
+        buffered = 0;
+    }
+
+    //nothing to write?
+    if(0 == data.length)
+    {
+        //done
+        durable = last;
+        return;
+    }
+
+    //open
+    if( (-1 == fd) &&
+        (-1 == (fd = open(self.path.fileSystemRepresentation, O_WRONLY|O_APPEND|O_CREAT, 0644))) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to open rules journal %{public}@ (error: %d)", self.path, errno);
+
+        //bail
+        goto bail;
+    }
+
+    //write
+    // handle partial writes
+    while(written < data.length)
+    {
+        //write
+        ssize_t result = write(fd, (const uint8_t*)data.bytes + written, data.length - written);
+        if(result < 0)
+        {
+            //retry?
+            if(EINTR == errno) continue;
+
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to write rules journal (error: %d)", errno);
+
+            //bail
+            goto bail;
+        }
+
+        //inc
+        written += (size_t)result;
+    }
+
+    //sync
+    if(0 != fsync(fd))
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to sync rules journal (error: %d)", errno);
+
+        //bail
+        goto bail;
+    }
+
+    //durable
+    durable = last;
+    size += (off_t)data.length;
+    records += count;
+
+    //big enough to compact?
+    if( (size > JOURNAL_COMPACT_SIZE) ||
+        (records > JOURNAL_COMPACT_RECORDS) )
+    {
+        //compact
+        [self compact];
+    }
+
+    //done
+    return;
+
+bail:
+
+    //failed
+    // remove any partial write, and put records back, so they're retried on next commit
+    if( (-1 != fd) &&
+        (0 != written) )
+    {
+        //truncate
+        ftruncate(fd, size);
+    }
+
+    //put back
+    @synchronized(self)
+    {
+        //put back
+        [self.buffer replaceBytesInRange:NSMakeRange(0, 0) withBytes:data.bytes length:data.length];
+        buffered += count;
+    }
+
+    return;
+}
+
+//compact
+// in the background
+-(void)compact
+{
+    //compact (on queue)
+    dispatch_async(self.queue, ^{
+
+        //flush
+        // ...so all records are in the journal
+        [self flush];
+
+        //snapshot
+        // will also include any records (since) buffered
+        if(YES != self.snapshot())
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to snapshot rules, won't compact journal");
+
+            return;
+        }
+
+        //open
+        if(-1 == self->fd)
+        {
+            //open
+            self->fd = open(self.path.fileSystemRepresentation, O_WRONLY|O_APPEND|O_CREAT, 0644);
+        }
+
+        //truncate
+        if( (-1 == self->fd) ||
+            (0 != ftruncate(self->fd, 0)) ||
+            (0 != fsync(self->fd)) )
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to truncate rules journal (error: %d)", errno);
+
+            return;
+        }
+
+        //dbg msg
+        os_log_debug(logHandle, "compacted rules journal (%llu record(s))", self->records);
+
+        //reset
+        self->size = 0;
+        self->records = 0;
+    });
+
+    return;
+}
+
+@end
+
+//crc32
+// bitwise (records are small, and rarely written)
+static uint32_t crc32Update(uint32_t crc, const uint8_t* bytes, size_t length)
+{
+    //init
+    crc = ~crc;
+
+    for(size_t i = 0; i < length; i++)
+    {
+        //add byte
+        crc ^= bytes[i];
+
+        //each bit
+        for(int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+
+    return ~crc;
+}
@@ -0,0 +1,65 @@
+//
+//  file: RulesSnapshot.h
+//  project: BlockBlock (launch daemon)
+//  description: memory-mapped, binary snapshot of rules (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+#ifndef RulesSnapshot_h
+#define RulesSnapshot_h
+
+@import Foundation;
+
+@class Rule;
+
+/* CONSTS */
+
+//snapshot magic
+#define SNAPSHOT_MAGIC 0x53524242
+
+//snapshot (format) version
+#define SNAPSHOT_VERSION 1
+
+//no string
+// e.g. rule w/o a signing id
+#define SNAPSHOT_NO_STRING 0xFFFFFFFF
+
+//process flag: cs flags (were) set
+#define SNAPSHOT_HAS_CS_FLAGS 0x1
+
+//process flag: rule(s) for a (then) validly signed process
+#define SNAPSHOT_REQUIRES_VALID 0x2
+
+@interface RulesSnapshot : NSObject
+
+/* PROPERTIES */
+
+//number of processes
+@property(readonly)NSUInteger processCount;
+
+//number of rules
+@property(readonly)NSUInteger ruleCount;
+
+/* METHODS */
+
+//map a snapshot
+// read-only, and validates header, sections, and their checksums
+-(id)initWithFile:(NSString*)path;
+
+//find (matching) rule
+// hashes process key, then scans its rules, so only the matching rule is materialized
+-(Rule*)find:(NSString*)key csFlags:(NSNumber*)csFlags itemFile:(NSString*)itemFile itemObject:(NSString*)itemObject;
+
+//materialize all rules
+// in format of (in-memory) rules dictionary
+-(NSMutableDictionary*)rules;
+
+//write a snapshot
+// interns strings, and builds hash index, then (atomically) writes and syncs
++(BOOL)write:(NSDictionary*)rules toFile:(NSString*)path;
+
+@end
+
+#endif /* RulesSnapshot_h */
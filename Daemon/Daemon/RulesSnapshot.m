@@ -0,0 +1,1004 @@
+//
+//  file: RulesSnapshot.m
+//  project: BlockBlock (launch daemon)
+//  description: memory-mapped, binary snapshot of rules
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+//  instead of unarchiving (all) rules at startup, the snapshot is mapped (read-only) and
+//  matched against in place. only the rule that matches an event is materialized.
+//
+//  layout (all offsets are from start of file, and 4-byte aligned):
+//    header:    magic, version, counts, offset/checksum of each section
+//    strings:   interned strings, each a (uint32) length, utf-8 bytes, then a NUL
+//    processes: one record per key (signing id or path), w/ range of its rules
+//    rules:     one (fixed size) record per rule, strings are offsets into string table
+//    slots:     open addressed hash index of processes (by key), 0 is empty, else index + 1
+
+@import OSLog;
+
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+
+#import "consts.h"
+#import "Rule.h"
+#import "RulesSnapshot.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+/* TYPEDEFS */
+
+//header
+typedef struct
+{
+    //magic
+    uint32_t magic;
+
+    //version
+    uint32_t version;
+
+    //length of (entire) snapshot
+    uint32_t length;
+
+    //checksum
+    // crc32, over header (w/ this field zero'd)
+    uint32_t checksum;
+
+    //counts
+    uint32_t processCount;
+    uint32_t ruleCount;
+    uint32_t slotCount;
+
+    //strings
+    uint32_t stringsOffset;
+    uint32_t stringsLength;
+    uint32_t stringsChecksum;
+
+    //processes
+    uint32_t processesOffset;
+    uint32_t processesChecksum;
+
+    //rules
+    uint32_t rulesOffset;
+    uint32_t rulesChecksum;
+
+    //slots
+    uint32_t slotsOffset;
+    uint32_t slotsChecksum;
+
+} SnapshotHeader;
+
+//process record
+typedef struct
+{
+    //key
+    uint32_t key;
+
+    //hash of key
+    uint32_t hash;
+
+    //flags
+    uint32_t flags;
+
+    //cs flags
+    uint32_t csFlags;
+
+    //index of first rule
+    uint32_t firstRule;
+
+    //number of rules
+    uint32_t ruleCount;
+
+} SnapshotProcess;
+
+//rule record
+typedef struct
+{
+    //process info
+    uint32_t processPath;
+    uint32_t processName;
+    uint32_t processSigningID;
+
+    //item info
+    uint32_t itemFile;
+    uint32_t itemObject;
+
+    //flags
+    uint32_t flags;
+
+    //process cs flags
+    uint32_t csFlags;
+
+    //action
+    uint32_t action;
+
+    //scope
+    int32_t scope;
+
+} SnapshotRule;
+
+/* FUNCTIONS */
+
+//fnv-1a hash
+static uint32_t hashBytes(const char* bytes, size_t length);
+
+//crc32
+static uint32_t crc32Bytes(const uint8_t* bytes, size_t length);
+
+//intern a string
+// returns its offset in string table
+static uint32_t internString(NSString* string, NSMutableData* strings, NSMutableDictionary* interned);
+
+//sync a file (or directory) to disk
+static BOOL syncPath(NSString* path);
+
+@interface RulesSnapshot ()
+{
+    //mapping
+    const uint8_t* base;
+
+    //length of mapping
+    size_t length;
+
+    //header
+    const SnapshotHeader* header;
+
+    //sections
+    const uint8_t* strings;
+    const SnapshotProcess* processes;
+    const SnapshotRule* records;
+    const uint32_t* slots;
+}
+
+@end
+
+@implementation RulesSnapshot
+
+//init
+// map, then validate
+-(id)initWithFile:(NSString*)path
+{
+    //fd
+    int fd = -1;
+
+    //file info
+    struct stat fileInfo = {0};
+
+    //mapping
+    void* mapping = MAP_FAILED;
+
+    //init super
+    self = [super init];
+    if(nil == self)
+    {
+        //bail
+        goto bail;
+    }
+
+    //open
+    fd = open(path.fileSystemRepresentation, O_RDONLY);
+    if(-1 == fd)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to open rules snapshot %{public}@ (error: %d)", path, errno);
+
+        //unset
+        self = nil;
+
+        //bail
+        goto bail;
+    }
+
+    //size
+    if( (0 != fstat(fd, &fileInfo)) ||
+        (fileInfo.st_size < (off_t)sizeof(SnapshotHeader)) ||
+        (fileInfo.st_size > (off_t)UINT32_MAX) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: rules snapshot %{public}@ has invalid size (%lld)", path, (long long)fileInfo.st_size);
+
+        //unset
+        self = nil;
+
+        //bail
+        goto bail;
+    }
+
+    //map
+    // read only, so it's shared w/ page cache
+    mapping = mmap(NULL, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(MAP_FAILED == mapping)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to map rules snapshot %{public}@ (error: %d)", path, errno);
+
+        //unset
+        self = nil;
+
+        //bail
+        goto bail;
+    }
+
+    //save
+    base = mapping;
+    length = (size_t)fileInfo.st_size;
+    header = (const SnapshotHeader*)base;
+
+    //validate
+    if(YES != [self validate])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: rules snapshot %{public}@ is invalid", path);
+
+        //unset
+        // note: dealloc will unmap
+        self = nil;
+
+        //bail
+        goto bail;
+    }
+
+    //dbg msg
+    os_log_debug(logHandle, "mapped rules snapshot (%u processes, %u rules)", header->processCount, header->ruleCount);
+
+bail:
+
+    //close
+    // mapping stays valid
+    if(-1 != fd)
+    {
+        close(fd);
+    }
+
+    return self;
+}
+
+//dealloc
+// unmap
+-(void)dealloc
+{
+    //unmap
+    if(NULL != base)
+    {
+        munmap((void*)base, length);
+    }
+
+    return;
+}
+
+//validate
+// header, section bounds, and checksums
+-(BOOL)validate
+{
+    //header copy
+    SnapshotHeader copy = {0};
+
+    //processes length
+    uint64_t processesLength = 0;
+
+    //rules length
+    uint64_t rulesLength = 0;
+
+    //slots length
+    uint64_t slotsLength = 0;
+
+    //magic/version/length
+    if( (SNAPSHOT_MAGIC != header->magic) ||
+        (SNAPSHOT_VERSION != header->version) ||
+        (length != header->length) )
+    {
+        return NO;
+    }
+
+    //header checksum
+    copy = *header;
+    copy.checksum = 0;
+    if(header->checksum != crc32Bytes((const uint8_t*)&copy, sizeof(copy)))
+    {
+        return NO;
+    }
+
+    //slot count
+    // must be power of two, and larger than number of processes (so probing terminates)
+    if( (0 == header->slotCount) ||
+        (0 != (header->slotCount & (header->slotCount - 1))) ||
+        (header->slotCount <= header->processCount) )
+    {
+        return NO;
+    }
+
+    //section lengths
+    processesLength = (uint64_t)header->processCount * sizeof(SnapshotProcess);
+    rulesLength = (uint64_t)header->ruleCount * sizeof(SnapshotRule);
+    slotsLength = (uint64_t)header->slotCount * sizeof(uint32_t);
+
+    //section bounds/alignment
+    if( (0 != (header->stringsOffset % 4)) || ((uint64_t)header->stringsOffset + header->stringsLength > length) ||
+        (0 != (header->processesOffset % 4)) || ((uint64_t)header->processesOffset + processesLength > length) ||
+        (0 != (header->rulesOffset % 4)) || ((uint64_t)header->rulesOffset + rulesLength > length) ||
+        (0 != (header->slotsOffset % 4)) || ((uint64_t)header->slotsOffset + slotsLength > length) )
+    {
+        return NO;
+    }
+
+    //init sections
+    strings = base + header->stringsOffset;
+    processes = (const SnapshotProcess*)(base + header->processesOffset);
+    records = (const SnapshotRule*)(base + header->rulesOffset);
+    slots = (const uint32_t*)(base + header->slotsOffset);
+
+    //section checksums
+    if( (header->stringsChecksum != crc32Bytes(strings, header->stringsLength)) ||
+        (header->processesChecksum != crc32Bytes((const uint8_t*)processes, (size_t)processesLength)) ||
+        (header->rulesChecksum != crc32Bytes((const uint8_t*)records, (size_t)rulesLength)) ||
+        (header->slotsChecksum != crc32Bytes((const uint8_t*)slots, (size_t)slotsLength)) )
+    {
+        return NO;
+    }
+
+    //processes
+    // rule ranges must be in bounds
+    for(uint32_t i = 0; i < header->processCount; i++)
+    {
+        //check
+        if((uint64_t)processes[i].firstRule + processes[i].ruleCount > header->ruleCount) return NO;
+    }
+
+    //slots
+    // must reference valid process
+    for(uint32_t i = 0; i < header->slotCount; i++)
+    {
+        //check
+        if(slots[i] > header->processCount) return NO;
+    }
+
+    //note: string references are bounds checked on access
+
+    return YES;
+}
+
+//number of processes
+-(NSUInteger)processCount
+{
+    return header->processCount;
+}
+
+//number of rules
+-(NSUInteger)ruleCount
+{
+    return header->ruleCount;
+}
+
+//get string
+// bounds checked, returns NO for missing/invalid string
+-(BOOL)string:(uint32_t)reference bytes:(const char**)bytes length:(uint32_t*)stringLength
+{
+    //no string?
+    if(SNAPSHOT_NO_STRING == reference) return NO;
+
+    //length in bounds?
+    if((uint64_t)reference + sizeof(uint32_t) > header->stringsLength) return NO;
+
+    //length
+    memcpy(stringLength, strings + reference, sizeof(uint32_t));
+
+    //bytes (and NUL) in bounds?
+    if((uint64_t)reference + sizeof(uint32_t) + *stringLength + 1 > header->stringsLength) return NO;
+
+    //bytes
+    *bytes = (const char*)(strings + reference + sizeof(uint32_t));
+
+    return YES;
+}
+
+//compare string
+-(BOOL)string:(uint32_t)reference equals:(const char*)bytes length:(size_t)bytesLength
+{
+    //string
+    const char* string = NULL;
+
+    //length
+    uint32_t stringLength = 0;
+
+    //get string
+    if(YES != [self string:reference bytes:&string length:&stringLength]) return NO;
+
+    return ( (stringLength == bytesLength) &&
+             (0 == memcmp(string, bytes, bytesLength)) );
+}
+
+//materialize string
+// interned, so each is only created once
+-(NSString*)string:(uint32_t)reference interned:(NSMutableDictionary*)interned
+{
+    //string
+    NSString* string = nil;
+
+    //bytes
+    const char* bytes = NULL;
+
+    //length
+    uint32_t stringLength = 0;
+
+    //get string
+    if(YES != [self string:reference bytes:&bytes length:&stringLength]) return nil;
+
+    //already created?
+    string = interned[@(reference)];
+    if(nil == string)
+    {
+        //create
+        string = [[NSString alloc] initWithBytes:bytes length:stringLength encoding:NSUTF8StringEncoding];
+
+        //save
+        if(nil != string) interned[@(reference)] = string;
+    }
+
+    return string;
+}
+
+//materialize rule
+-(Rule*)rule:(const SnapshotRule*)record interned:(NSMutableDictionary*)interned
+{
+    //rule
+    Rule* rule = nil;
+
+    //init
+    rule = [[Rule alloc] init];
+
+    //process info
+    rule.processPath = [self string:record->processPath interned:interned];
+    rule.processName = [self string:record->processName interned:interned];
+    rule.processSigningID = [self string:record->processSigningID interned:interned];
+
+    //cs flags
+    if(SNAPSHOT_HAS_CS_FLAGS & record->flags)
+    {
+        //add
+        rule.processCSFlags = @(record->csFlags);
+    }
+
+    //item info
+    rule.itemFile = [self string:record->itemFile interned:interned];
+    rule.itemObject = [self string:record->itemObject interned:interned];
+
+    //action/scope
+    rule.action = record->action;
+    rule.scope = record->scope;
+
+    return rule;
+}
+
+//find process
+// via hash index (linear probing)
+-(const SnapshotProcess*)findProcess:(NSString*)key
+{
+    //bytes
+    const char* bytes = key.UTF8String;
+
+    //length
+    size_t bytesLength = 0;
+
+    //hash
+    uint32_t hash = 0;
+
+    //slot
+    uint32_t slot = 0;
+
+    //sanity check
+    if(NULL == bytes) return NULL;
+
+    //init
+    bytesLength = strlen(bytes);
+    hash = hashBytes(bytes, bytesLength);
+    slot = hash & (header->slotCount - 1);
+
+    //probe
+    // note: slot count > process count, so there's always an empty slot
+    for(uint32_t i = 0; i < header->slotCount; i++)
+    {
+        //process
+        const SnapshotProcess* process = NULL;
+
+        //empty?
+        if(0 == slots[slot]) break;
+
+        //match?
+        process = &processes[slots[slot] - 1];
+        if( (hash == process->hash) &&
+            (YES == [self string:process->key equals:bytes length:bytesLength]) )
+        {
+            return process;
+        }
+
+        //next
+        slot = (slot + 1) & (header->slotCount - 1);
+    }
+
+    return NULL;
+}
+
+//find (matching) rule
+// most specific first: (file, object), (file, *), (*, *), then (*, object)
+// note: same as (in-memory) index, earliest rule wins for each
+-(Rule*)find:(NSString*)key csFlags:(NSNumber*)csFlags itemFile:(NSString*)itemFile itemObject:(NSString*)itemObject
+{
+    //process
+    const SnapshotProcess* process = NULL;
+
+    //item file (bytes)
+    const char* file = itemFile.UTF8String;
+
+    //item file length
+    size_t fileLength = (NULL != file) ? strlen(file) : 0;
+
+    //item object (bytes)
+    const char* object = itemObject.UTF8String;
+
+    //item object length
+    size_t objectLength = (NULL != object) ? strlen(object) : 0;
+
+    //candidates
+    const SnapshotRule* fileMatch = NULL;
+    const SnapshotRule* processMatch = NULL;
+    const SnapshotRule* objectMatch = NULL;
+
+    //match
+    const SnapshotRule* match = NULL;
+
+    //find process
+    process = (nil != key) ? [self findProcess:key] : NULL;
+    if(NULL == process)
+    {
+        //dbg msg
+        os_log_debug(logHandle, "%{public}@ didn't match any rules", key);
+
+        //bail
+        goto bail;
+    }
+
+    //rule(s) for validly signed process?
+    //  make sure if was valid, still is
+    if( (SNAPSHOT_REQUIRES_VALID & process->flags) &&
+        !(CS_VALID & csFlags.unsignedIntegerValue) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: %{public}@ is not longer validly signed (csflags: %#lx)", key, csFlags.unsignedIntegerValue);
+
+        //bail
+        goto bail;
+    }
+
+    //scan process's rules
+    for(uint32_t i = process->firstRule; i < process->firstRule + process->ruleCount; i++)
+    {
+        //rule
+        const SnapshotRule* record = &records[i];
+
+        //any file?
+        BOOL anyFile = [self string:record->itemFile equals:"*" length:1];
+
+        //any object
+        if(YES == [self string:record->itemObject equals:"*" length:1])
+        {
+            //any file, any object
+            if(YES == anyFile)
+            {
+                if(NULL == processMatch) processMatch = record;
+            }
+            //file, any object
+            else if( (NULL == fileMatch) &&
+                     (NULL != file) &&
+                     (YES == [self string:record->itemFile equals:file length:fileLength]) )
+            {
+                fileMatch = record;
+            }
+
+            continue;
+        }
+
+        //no object?
+        if(NULL == object) continue;
+
+        //file and object
+        // most specific, so done
+        if( (NULL != file) &&
+            (YES == [self string:record->itemFile equals:file length:fileLength]) &&
+            (YES == [self string:record->itemObject equals:object length:objectLength]) )
+        {
+            match = record;
+            break;
+        }
+
+        //any file, object
+        if( (NULL == objectMatch) &&
+            (YES == anyFile) &&
+            (YES == [self string:record->itemObject equals:object length:objectLength]) )
+        {
+            objectMatch = record;
+        }
+    }
+
+    //most specific
+    if(NULL == match) match = fileMatch;
+    if(NULL == match) match = processMatch;
+    if(NULL == match) match = objectMatch;
+
+bail:
+
+    return (NULL != match) ? [self rule:match interned:[NSMutableDictionary dictionary]] : nil;
+}
+
+//materialize all rules
+// in format of (in-memory) rules dictionary
+-(NSMutableDictionary*)rules
+{
+    //rules
+    NSMutableDictionary* rules = nil;
+
+    //interned strings
+    NSMutableDictionary* interned = nil;
+
+    //alloc
+    rules = [NSMutableDictionary dictionary];
+    interned = [NSMutableDictionary dictionary];
+
+    //each process
+    for(uint32_t i = 0; i < header->processCount; i++)
+    {
+        //process
+        const SnapshotProcess* process = &processes[i];
+
+        //key
+        NSString* key = [self string:process->key interned:interned];
+
+        //process's rules
+        NSMutableArray* processRules = nil;
+
+        //skip invalid
+        if(nil == key) continue;
+
+        //alloc
+        processRules = [NSMutableArray arrayWithCapacity:process->ruleCount];
+
+        //each rule
+        for(uint32_t j = process->firstRule; j < process->firstRule + process->ruleCount; j++)
+        {
+            //add
+            [processRules addObject:[self rule:&records[j] interned:interned]];
+        }
+
+        //add
+        rules[key] = [NSMutableDictionary dictionaryWithObject:processRules forKey:KEY_RULES];
+
+        //add cs flags
+        if(SNAPSHOT_HAS_CS_FLAGS & process->flags)
+        {
+            //add
+            rules[key][KEY_CS_FLAGS] = @(process->csFlags);
+        }
+    }
+
+    return rules;
+}
+
+//write a snapshot
++(BOOL)write:(NSDictionary*)rules toFile:(NSString*)path
+{
+    //result
+    BOOL result = NO;
+
+    //header
+    SnapshotHeader snapshotHeader = {0};
+
+    //sections
+    NSMutableData* stringTable = nil;
+    NSMutableData* processTable = nil;
+    NSMutableData* ruleTable = nil;
+    NSMutableData* slotTable = nil;
+
+    //interned strings
+    NSMutableDictionary* interned = nil;
+
+    //snapshot
+    NSMutableData* snapshot = nil;
+
+    //error
+    NSError* error = nil;
+
+    //alloc
+    stringTable = [NSMutableData data];
+    processTable = [NSMutableData data];
+    ruleTable = [NSMutableData data];
+    interned = [NSMutableDictionary dictionary];
+
+    //each process
+    for(NSString* key in rules)
+    {
+        //process
+        SnapshotProcess process = {0};
+
+        //init
+        process.key = internString(key, stringTable, interned);
+        process.hash = hashBytes(key.UTF8String, strlen(key.UTF8String));
+        process.firstRule = snapshotHeader.ruleCount;
+
+        //cs flags
+        if(nil != rules[key][KEY_CS_FLAGS])
+        {
+            //add
+            process.flags |= SNAPSHOT_HAS_CS_FLAGS;
+            process.csFlags = [rules[key][KEY_CS_FLAGS] unsignedIntValue];
+        }
+
+        //each rule
+        for(Rule* rule in rules[key][KEY_RULES])
+        {
+            //record
+            SnapshotRule record = {0};
+
+            //process info
+            record.processPath = internString(rule.processPath, stringTable, interned);
+            record.processName = internString(rule.processName, stringTable, interned);
+            record.processSigningID = internString(rule.processSigningID, stringTable, interned);
+
+            //cs flags
+            if(nil != rule.processCSFlags)
+            {
+                //add
+                record.flags |= SNAPSHOT_HAS_CS_FLAGS;
+                record.csFlags = rule.processCSFlags.unsignedIntValue;
+            }
+
+            //item info
+            record.itemFile = internString(rule.itemFile, stringTable, interned);
+            record.itemObject = internString(rule.itemObject, stringTable, interned);
+
+            //action/scope
+            record.action = (uint32_t)rule.action;
+            record.scope = (int32_t)rule.scope;
+
+            //rule for validly signed process?
+            if( (0 != rule.processSigningID.length) &&
+                (CS_VALID & rule.processCSFlags.unsignedIntegerValue) )
+            {
+                //set
+                process.flags |= SNAPSHOT_REQUIRES_VALID;
+            }
+
+            //add
+            [ruleTable appendBytes:&record length:sizeof(record)];
+
+            //inc
+            process.ruleCount++;
+            snapshotHeader.ruleCount++;
+        }
+
+        //add
+        [processTable appendBytes:&process length:sizeof(process)];
+        snapshotHeader.processCount++;
+    }
+
+    //slot count
+    // power of two, at least twice number of processes
+    snapshotHeader.slotCount = 2;
+    while(snapshotHeader.slotCount < (2 * snapshotHeader.processCount)) snapshotHeader.slotCount <<= 1;
+
+    //alloc slots
+    slotTable = [NSMutableData dataWithLength:snapshotHeader.slotCount * sizeof(uint32_t)];
+
+    //build index
+    for(uint32_t i = 0; i < snapshotHeader.processCount; i++)
+    {
+        //slot
+        uint32_t slot = ((const SnapshotProcess*)processTable.bytes)[i].hash & (snapshotHeader.slotCount - 1);
+
+        //find empty
+        while(0 != ((uint32_t*)slotTable.mutableBytes)[slot]) slot = (slot + 1) & (snapshotHeader.slotCount - 1);
+
+        //add
+        ((uint32_t*)slotTable.mutableBytes)[slot] = i + 1;
+    }
+
+    //init header
+    snapshotHeader.magic = SNAPSHOT_MAGIC;
+    snapshotHeader.version = SNAPSHOT_VERSION;
+
+    //layout
+    // note: string table is padded, so all sections are aligned
+    snapshotHeader.stringsOffset = sizeof(SnapshotHeader);
+    snapshotHeader.stringsLength = (uint32_t)stringTable.length;
+    snapshotHeader.processesOffset = snapshotHeader.stringsOffset + snapshotHeader.stringsLength;
+    snapshotHeader.rulesOffset = snapshotHeader.processesOffset + (uint32_t)processTable.length;
+    snapshotHeader.slotsOffset = snapshotHeader.rulesOffset + (uint32_t)ruleTable.length;
+    snapshotHeader.length = snapshotHeader.slotsOffset + (uint32_t)slotTable.length;
+
+    //checksums
+    snapshotHeader.stringsChecksum = crc32Bytes(stringTable.bytes, stringTable.length);
+    snapshotHeader.processesChecksum = crc32Bytes(processTable.bytes, processTable.length);
+    snapshotHeader.rulesChecksum = crc32Bytes(ruleTable.bytes, ruleTable.length);
+    snapshotHeader.slotsChecksum = crc32Bytes(slotTable.bytes, slotTable.length);
+    snapshotHeader.checksum = crc32Bytes((const uint8_t*)&snapshotHeader, sizeof(snapshotHeader));
+
+    //build snapshot
+    snapshot = [NSMutableData dataWithBytes:&snapshotHeader length:sizeof(snapshotHeader)];
+    [snapshot appendData:stringTable];
+    [snapshot appendData:processTable];
+    [snapshot appendData:ruleTable];
+    [snapshot appendData:slotTable];
+
+    //write out
+    // atomically, so any existing mapping (of old snapshot) is unaffected
+    if(YES != [snapshot writeToFile:path options:NSDataWritingAtomic error:&error])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to save rules snapshot to: %{public}@ (%{public}@)", path, error);
+
+        //bail
+        goto bail;
+    }
+
+    //sync file, then its directory
+    // as journal is truncated once snapshot is saved, so (atomic) rename must be durable too
+    if( (YES != syncPath(path)) ||
+        (YES != syncPath([path stringByDeletingLastPathComponent])) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to sync rules snapshot %{public}@ (error: %d)", path, errno);
+
+        //bail
+        goto bail;
+    }
+
+    //dbg msg
+    os_log_debug(logHandle, "saved rules snapshot (%u processes, %u rules, %lu bytes)", snapshotHeader.processCount, snapshotHeader.ruleCount, (unsigned long)snapshot.length);
+
+    //happy
+    result = YES;
+
+bail:
+
+    return result;
+}
+
+@end
+
+//fnv-1a hash
+static uint32_t hashBytes(const char* bytes, size_t length)
+{
+    //hash
+    uint32_t hash = 2166136261u;
+
+    //each byte
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+//crc32
+// table driven, as snapshot is checksummed on each (daemon) start
+static uint32_t crc32Bytes(const uint8_t* bytes, size_t length)
+{
+    //table
+    static uint32_t table[256];
+
+    //once token
+    static dispatch_once_t onceToken;
+
+    //crc
+    uint32_t crc = 0xFFFFFFFF;
+
+    //init table
+    dispatch_once(&onceToken, ^{
+
+        //each byte
+        for(uint32_t i = 0; i < 256; i++)
+        {
+            //entry
+            uint32_t entry = i;
+
+            //each bit
+            for(int bit = 0; bit < 8; bit++)
+            {
+                entry = (entry >> 1) ^ (0xEDB88320 & (0 - (entry & 1)));
+            }
+
+            //save
+            table[i] = entry;
+        }
+    });
+
+    //each byte
+    for(size_t i = 0; i < length; i++)
+    {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+//intern a string
+// length, bytes, NUL, then padding (so next entry is aligned)
+static uint32_t internString(NSString* string, NSMutableData* strings, NSMutableDictionary* interned)
+{
+    //offset
+    uint32_t offset = SNAPSHOT_NO_STRING;
+
+    //bytes
+    const char* bytes = NULL;
+
+    //length
+    uint32_t length = 0;
+
+    //padding
+    uint8_t padding[4] = {0};
+
+    //no string?
+    bytes = string.UTF8String;
+    if(NULL == bytes) goto bail;
+
+    //already interned?
+    if(nil != interned[string])
+    {
+        //offset
+        offset = [interned[string] unsignedIntValue];
+
+        //bail
+        goto bail;
+    }
+
+    //init
+    offset = (uint32_t)strings.length;
+    length = (uint32_t)strlen(bytes);
+
+    //add
+    [strings appendBytes:&length length:sizeof(length)];
+    [strings appendBytes:bytes length:length];
+    [strings appendBytes:padding length:4 - (length % 4)];
+
+    //save
+    interned[string] = @(offset);
+
+bail:
+
+    return offset;
+}
+
+//sync a file (or directory) to disk
+// for a directory, makes (new) entries, e.g. from a rename, durable
+static BOOL syncPath(NSString* path)
+{
+    //result
+    BOOL result = NO;
+
+    //fd
+    int fd = -1;
+
+    //open
+    fd = open(path.fileSystemRepresentation, O_RDONLY);
+    if(-1 == fd) goto bail;
+
+    //sync
+    if(0 != fsync(fd)) goto bail;
+
+    //happy
+    result = YES;
+
+bail:
+
+    //close
+    if(-1 != fd) close(fd);
+
+    return result;
+}
@@ -0,0 +1,44 @@
+//
+//  file: SubscriptionPlanner.h
+//  project: BlockBlock (launch daemon)
+//  description: derives (ES) target path prefixes from the watch list (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+#ifndef SubscriptionPlanner_h
+#define SubscriptionPlanner_h
+
+@import Foundation;
+
+@class PathMatcher;
+
+/* CONSTS */
+
+//max number of prefixes
+// any more, and we just don't restrict file events
+#define PLANNER_MAX_PREFIXES 64
+
+@interface SubscriptionPlanner : NSObject
+
+/* PROPERTIES */
+
+//directories whose entries were expanded (e.g. '/Users/')
+// any change to these means prefixes should be re-planned
+@property(nonatomic, retain)NSMutableSet<NSString*>* expanded;
+
+/* METHODS */
+
+//derive (minimal) set of target path prefixes that covers all of a matcher's patterns
+// returns nil if any pattern can't be covered (e.g. it's unanchored), meaning watch everything
+-(NSArray<NSString*>*)targetPrefixes:(PathMatcher*)matcher;
+
+//derive the literal prefixes any match of a (anchored) regex must start with
+// returns nil if there are none (e.g. regex is unanchored)
+// note: a component wildcard (e.g. '/Users/[^/]+/') is expanded to the directory's (current) entries
+-(NSArray<NSString*>*)prefixesForRegex:(NSString*)pattern;
+
+@end
+
+#endif /* SubscriptionPlanner_h */
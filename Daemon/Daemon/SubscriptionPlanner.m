@@ -0,0 +1,784 @@
+//
+//  file: SubscriptionPlanner.m
+//  project: BlockBlock (launch daemon)
+//  description: derives (ES) target path prefixes from the watch list
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+//  all watch list regexes are anchored, and start with literals (or alternations of literals)
+//  e.g. '^(\/System|)\/Library\/Extensions\/...' can only match under '/System/Library/Extensions/'
+//  or '/Library/Extensions/'. such prefixes are then (inverted) muted, so the kernel only delivers
+//  file events under persistence locations, instead of every file event on the system
+//
+//  note: ES path muting is case-sensitive, whereas the watch list regexes are not. however the
+//  prefixes are of existing (system) directories, whose paths are reported in their on-disk case
+//
+//  a component wildcard followed by a '/' (e.g. '/Users/[^\/]+/Library/...') is expanded to the
+//  directory's current entries (e.g. '/Users/<user>/Library/...'), instead of closing the prefix
+//  at '/Users/' (which would then deliver every file event under any home directory). such
+//  directories are tracked, so the caller can re-plan when (e.g.) a user is added
+
+@import OSLog;
+
+#import "PathMatcher.h"
+#import "SubscriptionPlanner.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+/* DEFINES */
+
+//chars that are literals when escaped
+#define PLANNER_ESCAPED_LITERALS "/.-\\()[]{}|^$*+? "
+
+/* FUNCTIONS */
+
+//expand a (sub)sequence of a regex into its literal prefixes
+// stops at end of pattern, or (if in group) at end of the alternative
+static BOOL expandSequence(NSString* pattern, NSUInteger* index, BOOL inGroup, NSMutableArray* open, NSMutableArray* closed, NSMutableSet* expanded);
+
+//expand (open) branches w/ their directory's entries
+// returns nil if any branch isn't a (readable) directory, or there'd be too many
+static NSArray* expandComponent(NSArray* open, NSMutableSet* expanded);
+
+//is next term (after a component wildcard) a '/'?
+// looks past the end of any enclosing groups
+static BOOL followedBySlash(NSString* pattern, NSUInteger index);
+
+//skip a single term
+// char, escape, class, or (balanced) group
+static BOOL skipTerm(NSString* pattern, NSUInteger* index);
+
+@implementation SubscriptionPlanner
+
+@synthesize expanded;
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //alloc
+        expanded = [NSMutableSet set];
+    }
+
+    return self;
+}
+
+//derive (minimal) set of target path prefixes that covers all of a matcher's patterns
+// any pattern that can't be covered means we can't restrict file events at all
+-(NSArray<NSString*>*)targetPrefixes:(PathMatcher*)matcher
+{
+    //prefixes
+    NSMutableArray* prefixes = nil;
+
+    //all (derived) prefixes
+    __block NSMutableSet* derived = nil;
+
+    //flag
+    __block BOOL covered = YES;
+
+    //alloc
+    derived = [NSMutableSet set];
+
+    //reset
+    // as directories (and their entries) may have changed since last plan
+    [self.expanded removeAllObjects];
+
+    //derive prefixes for each pattern
+    [matcher enumeratePatterns:^(NSString* pattern, BOOL isPrefix)
+    {
+        //regex prefixes
+        NSArray* regexPrefixes = nil;
+
+        //prefix?
+        // use as is, if absolute
+        if(YES == isPrefix)
+        {
+            //not absolute?
+            if( (pattern.length < 2) ||
+                (YES != [pattern hasPrefix:@"/"]) )
+            {
+                //err msg
+                os_log_error(logHandle, "ERROR: watch prefix %{public}@ is not absolute", pattern);
+
+                //not covered
+                covered = NO;
+                return;
+            }
+
+            //add
+            [derived addObject:pattern];
+            return;
+        }
+
+        //regex
+        // derive its prefixes
+        regexPrefixes = [self prefixesForRegex:pattern];
+        if(nil == regexPrefixes)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to derive prefixes for watch regex %{public}@", pattern);
+
+            //not covered
+            covered = NO;
+            return;
+        }
+
+        //add
+        [derived addObjectsFromArray:regexPrefixes];
+    }];
+
+    //not covered?
+    // or nothing to restrict to
+    if( (YES != covered) ||
+        (0 == derived.count) )
+    {
+        //bail
+        goto bail;
+    }
+
+    //alloc
+    prefixes = [NSMutableArray array];
+
+    //minimize
+    // drop any prefix that's already under a (shorter) one
+    for(NSString* prefix in [derived.allObjects sortedArrayUsingComparator:^NSComparisonResult(NSString* first, NSString* second) {
+        return (first.length < second.length) ? NSOrderedAscending : (first.length > second.length) ? NSOrderedDescending : [first compare:second];
+    }])
+    {
+        //covered?
+        BOOL isCovered = NO;
+
+        //check against existing
+        for(NSString* existing in prefixes)
+        {
+            //covered?
+            if(YES == [prefix hasPrefix:existing])
+            {
+                //set
+                isCovered = YES;
+                break;
+            }
+        }
+
+        //add
+        if(YES != isCovered)
+        {
+            [prefixes addObject:prefix];
+        }
+    }
+
+    //too many?
+    if(prefixes.count > PLANNER_MAX_PREFIXES)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: too many (%lu) target prefixes", (unsigned long)prefixes.count);
+
+        //unset
+        prefixes = nil;
+
+        //bail
+        goto bail;
+    }
+
+    //dbg msg
+    os_log_debug(logHandle, "target prefixes: %{public}@", prefixes);
+
+bail:
+
+    return prefixes;
+}
+
+//derive the literal prefixes any match of a (anchored) regex must start with
+// expands alternations of literals, stopping (per branch) at the first wildcard
+-(NSArray<NSString*>*)prefixesForRegex:(NSString*)pattern
+{
+    //prefixes
+    NSMutableArray* prefixes = nil;
+
+    //index
+    NSUInteger index = 0;
+
+    //branches that can still grow
+    NSMutableArray* open = nil;
+
+    //branches ended by a wildcard
+    NSMutableArray* closed = nil;
+
+    //unanchored?
+    // could match anywhere
+    if(YES != [pattern hasPrefix:@"^"])
+    {
+        //bail
+        goto bail;
+    }
+
+    //init
+    // start (after anchor) w/ a single empty branch
+    index = 1;
+    open = [NSMutableArray arrayWithObject:@""];
+    closed = [NSMutableArray array];
+
+    //expand
+    if(YES != expandSequence(pattern, &index, NO, open, closed, self.expanded))
+    {
+        //bail
+        goto bail;
+    }
+
+    //all branches
+    prefixes = [NSMutableArray arrayWithArray:closed];
+    [prefixes addObjectsFromArray:open];
+
+    //each must be absolute
+    // otherwise, it'd cover (almost) everything
+    for(NSString* prefix in prefixes)
+    {
+        //not absolute?
+        if( (prefix.length < 2) ||
+            (YES != [prefix hasPrefix:@"/"]) )
+        {
+            //unset
+            prefixes = nil;
+
+            //bail
+            goto bail;
+        }
+    }
+
+bail:
+
+    return prefixes;
+}
+
+@end
+
+//expand a (sub)sequence of a regex into its literal prefixes
+// literals grow all open branches, groups cross them w/ each alternative, wildcards close them
+static BOOL expandSequence(NSString* pattern, NSUInteger* index, BOOL inGroup, NSMutableArray* open, NSMutableArray* closed, NSMutableSet* expanded)
+{
+    //char
+    unichar c = 0;
+
+    //next char
+    unichar next = 0;
+
+    while(*index < pattern.length)
+    {
+        //literal of term
+        unichar literal = 0;
+
+        //term is wildcard
+        BOOL wildcard = NO;
+
+        //close all branches after term
+        BOOL closeAfter = NO;
+
+        //branches of group term
+        NSMutableArray* groupOpen = nil;
+        NSMutableArray* groupClosed = nil;
+
+        //char
+        c = [pattern characterAtIndex:*index];
+
+        //end of alternative?
+        // only valid in a group (top-level alternation isn't anchored)
+        if( ('|' == c) ||
+            (')' == c) )
+        {
+            return inGroup;
+        }
+
+        //all branches closed?
+        // rest of sequence doesn't matter, so just skip
+        if(0 == open.count)
+        {
+            if(YES != skipTerm(pattern, index)) return NO;
+            continue;
+        }
+
+        switch(c)
+        {
+            //escape
+            case '\\':
+            {
+                //truncated?
+                if(*index + 1 >= pattern.length) return NO;
+
+                //escaped char
+                next = [pattern characterAtIndex:*index + 1];
+
+                //literal (e.g. '\/')?
+                // otherwise, a class (e.g. '\d')
+                if( (next < 0x80) &&
+                    (NULL != strchr(PLANNER_ESCAPED_LITERALS, (int)next)) )
+                {
+                    literal = next;
+                }
+                else
+                {
+                    wildcard = YES;
+                }
+
+                *index += 2;
+                break;
+            }
+
+            //group
+            case '(':
+            {
+                //skip '('
+                *index += 1;
+
+                //special group?
+                // e.g. inline flags, non-capturing, lookaround, etc
+                if( (*index < pattern.length) &&
+                    ('?' == [pattern characterAtIndex:*index]) )
+                {
+                    //flags end
+                    NSUInteger end = *index + 1;
+
+                    //skip flags
+                    while( (end < pattern.length) &&
+                           ((YES == [[NSCharacterSet letterCharacterSet] characterIsMember:[pattern characterAtIndex:end]]) || ('-' == [pattern characterAtIndex:end])) )
+                    {
+                        end++;
+                    }
+
+                    //truncated?
+                    if(end >= pattern.length) return NO;
+
+                    //inline flags (e.g. '(?i)')
+                    // don't match anything, so skip
+                    if(')' == [pattern characterAtIndex:end])
+                    {
+                        *index = end + 1;
+                        continue;
+                    }
+
+                    //non-capturing group (e.g. '(?:' or '(?i:')
+                    if(':' == [pattern characterAtIndex:end])
+                    {
+                        *index = end + 1;
+                    }
+                    //anything else (lookaround, etc)
+                    // treat as wildcard
+                    else
+                    {
+                        *index -= 1;
+                        if(YES != skipTerm(pattern, index)) return NO;
+
+                        wildcard = YES;
+                        break;
+                    }
+                }
+
+                //alloc
+                groupOpen = [NSMutableArray array];
+                groupClosed = [NSMutableArray array];
+
+                //expand each alternative
+                while(YES)
+                {
+                    //alternative's branches
+                    NSMutableArray* alternativeOpen = [NSMutableArray arrayWithObject:@""];
+                    NSMutableArray* alternativeClosed = [NSMutableArray array];
+
+                    //expand
+                    if(YES != expandSequence(pattern, index, YES, alternativeOpen, alternativeClosed, expanded)) return NO;
+
+                    //unterminated?
+                    if(*index >= pattern.length) return NO;
+
+                    //add
+                    [groupOpen addObjectsFromArray:alternativeOpen];
+                    [groupClosed addObjectsFromArray:alternativeClosed];
+
+                    //end of group?
+                    if(')' == [pattern characterAtIndex:(*index)++]) break;
+                }
+
+                break;
+            }
+
+            //class
+            // component wildcard (i.e. '[^/]+'), that's followed by a '/'? expand to directory's entries
+            case '[':
+            {
+                //start
+                NSUInteger start = *index;
+
+                //expanded branches
+                NSArray* entries = nil;
+
+                //skip class
+                if(YES != skipTerm(pattern, index)) return NO;
+
+                //component wildcard?
+                // and is followed by a '/', so it matches a whole component
+                if( ((YES == [[pattern substringWithRange:NSMakeRange(start, *index - start)] isEqualToString:@"[^\\/]"]) ||
+                     (YES == [[pattern substringWithRange:NSMakeRange(start, *index - start)] isEqualToString:@"[^/]"])) &&
+                    (*index < pattern.length) &&
+                    ('+' == [pattern characterAtIndex:*index]) &&
+                    (YES == followedBySlash(pattern, *index + 1)) )
+                {
+                    //expand
+                    entries = expandComponent(open, expanded);
+                }
+
+                //couldn't expand?
+                // treat as wildcard
+                if(nil == entries)
+                {
+                    wildcard = YES;
+                    break;
+                }
+
+                //skip '+'
+                *index += 1;
+
+                //update
+                // branches (now) end w/ an entry, so can keep growing
+                [open setArray:entries];
+
+                //too many?
+                if(open.count + closed.count > PLANNER_MAX_PREFIXES) return NO;
+
+                continue;
+            }
+
+            //wildcards
+            // any char, anchors
+            case '.':
+            case '^':
+            case '$':
+            {
+                wildcard = YES;
+                if(YES != skipTerm(pattern, index)) return NO;
+
+                break;
+            }
+
+            //dangling quantifier
+            case '*':
+            case '+':
+            case '?':
+            case '{':
+                return NO;
+
+            //literal
+            default:
+            {
+                literal = c;
+                *index += 1;
+
+                break;
+            }
+        }
+
+        //quantified?
+        // optional/repeated terms are treated as wildcards, '+' terms occur at least once
+        if(*index < pattern.length)
+        {
+            //quantifier
+            next = [pattern characterAtIndex:*index];
+
+            //optional
+            if( ('?' == next) ||
+                ('*' == next) ||
+                ('{' == next) )
+            {
+                wildcard = YES;
+            }
+            //at least once
+            else if('+' == next)
+            {
+                closeAfter = YES;
+            }
+        }
+
+        //wildcard
+        // close all branches
+        if(YES == wildcard)
+        {
+            [closed addObjectsFromArray:open];
+            [open removeAllObjects];
+        }
+        //group
+        // cross each branch w/ each alternative
+        else if(nil != groupOpen)
+        {
+            //new open branches
+            NSMutableArray* crossed = [NSMutableArray array];
+
+            for(NSString* branch in open)
+            {
+                //open alternatives
+                for(NSString* alternative in groupOpen)
+                {
+                    [crossed addObject:[branch stringByAppendingString:alternative]];
+                }
+
+                //closed alternatives
+                for(NSString* alternative in groupClosed)
+                {
+                    [closed addObject:[branch stringByAppendingString:alternative]];
+                }
+            }
+
+            //update
+            [open setArray:crossed];
+        }
+        //literal
+        // grow each branch
+        else
+        {
+            for(NSUInteger i = 0; i < open.count; i++)
+            {
+                open[i] = [open[i] stringByAppendingFormat:@"%C", literal];
+            }
+        }
+
+        //close?
+        if(YES == closeAfter)
+        {
+            [closed addObjectsFromArray:open];
+            [open removeAllObjects];
+        }
+
+        //too many?
+        if(open.count + closed.count > PLANNER_MAX_PREFIXES) return NO;
+    }
+
+    return YES;
+}
+
+//expand (open) branches w/ their directory's entries
+// e.g. '/Users/' -> '/Users/<user>', for each (non-hidden) directory in '/Users/'
+static NSArray* expandComponent(NSArray* open, NSMutableSet* expanded)
+{
+    //expanded branches
+    NSMutableArray* entries = nil;
+
+    //directory entries
+    NSArray* contents = nil;
+
+    //alloc
+    entries = [NSMutableArray array];
+
+    //expand each branch
+    for(NSString* branch in open)
+    {
+        //not an absolute directory?
+        if( (YES != [branch hasPrefix:@"/"]) ||
+            (YES != [branch hasSuffix:@"/"]) )
+        {
+            //bail
+            return nil;
+        }
+
+        //get entries
+        contents = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:branch error:nil];
+        if(nil == contents)
+        {
+            //bail
+            return nil;
+        }
+
+        //add (non-hidden) directories
+        for(NSString* entry in contents)
+        {
+            //directory flag
+            BOOL isDirectory = NO;
+
+            //hidden?
+            if(YES == [entry hasPrefix:@"."]) continue;
+
+            //not a directory?
+            if( (YES != [[NSFileManager defaultManager] fileExistsAtPath:[branch stringByAppendingString:entry] isDirectory:&isDirectory]) ||
+                (YES != isDirectory) )
+            {
+                continue;
+            }
+
+            //add
+            [entries addObject:[branch stringByAppendingString:entry]];
+        }
+
+        //too many?
+        // just treat as wildcard
+        if(entries.count > PLANNER_MAX_PREFIXES/2) return nil;
+    }
+
+    //save
+    // so caller can re-plan when directories change
+    [expanded addObjectsFromArray:open];
+
+    return entries;
+}
+
+//is next term (after a component wildcard) a '/'?
+// e.g. '[^/]+\/' or '(\/Users\/[^/]+|)\/Library', but not '[^/]+\.kext'
+static BOOL followedBySlash(NSString* pattern, NSUInteger index)
+{
+    //char
+    unichar c = 0;
+
+    while(index < pattern.length)
+    {
+        //char
+        c = [pattern characterAtIndex:index];
+
+        //slash?
+        if('/' == c) return YES;
+
+        //escaped slash?
+        if('\\' == c) return ( (index + 1 < pattern.length) && ('/' == [pattern characterAtIndex:index + 1]) );
+
+        //another alternative?
+        // skip to end of group
+        if('|' == c)
+        {
+            //skip '|'
+            index += 1;
+
+            //skip terms
+            while( (index < pattern.length) &&
+                   (')' != [pattern characterAtIndex:index]) )
+            {
+                //alternative
+                if('|' == [pattern characterAtIndex:index])
+                {
+                    index += 1;
+                    continue;
+                }
+
+                //term
+                if(YES != skipTerm(pattern, &index)) return NO;
+            }
+
+            //top-level alternation?
+            if(index >= pattern.length) return NO;
+
+            continue;
+        }
+
+        //end of group?
+        // check what follows it (unless group is quantified)
+        if(')' == c)
+        {
+            //skip ')'
+            index += 1;
+
+            //quantified?
+            if( (index < pattern.length) &&
+                (NULL != strchr("?*+{", (int)[pattern characterAtIndex:index])) )
+            {
+                return NO;
+            }
+
+            continue;
+        }
+
+        //anything else
+        return NO;
+    }
+
+    return NO;
+}
+
+//skip a single term
+// char, escape, class, or (balanced) group
+static BOOL skipTerm(NSString* pattern, NSUInteger* index)
+{
+    //depth
+    NSUInteger depth = 0;
+
+    //char
+    unichar c = 0;
+
+    switch([pattern characterAtIndex:*index])
+    {
+        //escape
+        case '\\':
+            *index += 2;
+            return (*index <= pattern.length);
+
+        //class
+        case '[':
+        {
+            //skip '['
+            *index += 1;
+
+            //negation
+            if( (*index < pattern.length) &&
+                ('^' == [pattern characterAtIndex:*index]) ) *index += 1;
+
+            //leading ']' is a literal
+            if( (*index < pattern.length) &&
+                (']' == [pattern characterAtIndex:*index]) ) *index += 1;
+
+            //find end
+            while(*index < pattern.length)
+            {
+                c = [pattern characterAtIndex:*index];
+
+                //escape
+                if('\\' == c)
+                {
+                    *index += 2;
+                    continue;
+                }
+
+                //end
+                *index += 1;
+                if(']' == c) return YES;
+            }
+
+            return NO;
+        }
+
+        //group
+        case '(':
+        {
+            //skip '('
+            *index += 1;
+            depth = 1;
+
+            //find (balanced) end
+            while( (*index < pattern.length) &&
+                   (0 != depth) )
+            {
+                c = [pattern characterAtIndex:*index];
+
+                //escape/class
+                if( ('\\' == c) ||
+                    ('[' == c) )
+                {
+                    if(YES != skipTerm(pattern, index)) return NO;
+                    continue;
+                }
+
+                //nesting
+                if('(' == c) depth++;
+                else if(')' == c) depth--;
+
+                *index += 1;
+            }
+
+            return (0 == depth);
+        }
+
+        //single char
+        default:
+            *index += 1;
+            return YES;
+    }
+}
@@ -66,24 +66,15 @@ extern Preferences* preferences;
     //archived rules
     NSData* archivedRules = nil;
     
-    //error
-    NSError* error = nil;
-    
     //dbg msg
     os_log_debug(logHandle, "XPC request: '%s'", __PRETTY_FUNCTION__);
     
     //archive rules
-    archivedRules = [NSKeyedArchiver archivedDataWithRootObject:rules.rules requiringSecureCoding:YES error:&error];
-    if(nil == archivedRules)
-    {
-        //err msg
-        os_log_error(logHandle, "ERROR: failed to archive rules: %{public}@", error);
-        
-        //don't bail as still want to reply
-    }
+    // note: on error, don't bail as still want to reply
+    archivedRules = [rules archive];
     
     //dbg msg
-    os_log_debug(logHandle, "archived %lu rules, and sending to user...", (unsigned long)rules.rules.count);
+    os_log_debug(logHandle, "archived rules (%lu bytes), and sending to user...", (unsigned long)archivedRules.length);
 
     //return rules
     reply(archivedRules);
@@ -97,9 +88,6 @@ extern Preferences* preferences;
     //archived rules
     NSData* archivedRules = nil;
     
-    //error
-    NSError* error = nil;
-    
     //dbg msg
     os_log_debug(logHandle, "XPC request: '%s' (rule: %{public}@)", __PRETTY_FUNCTION__, rule);
     
@@ -113,17 +101,11 @@ extern Preferences* preferences;
     }
     
     //archive (updated) rules
-    archivedRules = [NSKeyedArchiver archivedDataWithRootObject:rules.rules requiringSecureCoding:YES error:&error];
-    if(nil == archivedRules)
-    {
-        //err msg
-        os_log_error(logHandle, "ERROR: failed to archive rules: %{public}@", error);
-        
-        //don't bail as still want to reply
-    }
+    // note: on error, don't bail as still want to reply
+    archivedRules = [rules archive];
     
     //dbg msg
-    os_log_debug(logHandle, "archived %lu rules, and sending to user...", (unsigned long)rules.rules.count);
+    os_log_debug(logHandle, "archived rules (%lu bytes), and sending to user...", (unsigned long)archivedRules.length);
 
     //return rules
     reply(archivedRules);
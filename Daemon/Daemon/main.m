@@ -96,11 +96,11 @@ int main(int argc, const char * argv[])
         [preferences update:@{PREF_GOT_FDA:@YES}];
         
         //load rules
+        // on failure, don't exit, as (new) rules can still be added and enforced
         if(YES != [rules load])
         {
             //err msg
-            os_log_error(logHandle, "ERROR: failed to load rules from %{public}@", RULES_FILE);
-            goto bail;
+            os_log_error(logHandle, "ERROR: failed to load rules from %{public}@, continuing w/o them", RULES_SNAPSHOT_FILE);
         }
         
         //dbg msg
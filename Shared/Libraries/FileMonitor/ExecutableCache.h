@@ -0,0 +1,94 @@
+//
+//  ExecutableCache.h
+//  FileMonitor
+//
+//  Created by Patrick Wardle
+//  Copyright © 2025 Objective-See. All rights reserved.
+//
+
+#ifndef ExecutableCache_h
+#define ExecutableCache_h
+
+#import <Foundation/Foundation.h>
+#import <EndpointSecurity/EndpointSecurity.h>
+
+/* CONSTS */
+
+//default max number of executables
+#define EXECUTABLE_CACHE_MAX_ENTRIES 2048
+
+/* TYPEDEFS */
+
+//key
+typedef struct
+{
+    //device
+    dev_t device;
+
+    //inode
+    ino_t inode;
+
+    //cd hash
+    es_cdhash_t cdHash;
+
+} ExecutableKey;
+
+/* OBJECT: EXECUTABLE INFO */
+
+//note: not modified once added to cache
+// as its (estimated) size is accounted for then
+@interface ExecutableInfo : NSObject
+
+/* PROPERTIES */
+
+//name
+@property(nonatomic, retain)NSString* _Nullable name;
+
+//signing ID
+@property(nonatomic, retain)NSString* _Nullable signingID;
+
+//team ID
+@property(nonatomic, retain)NSString* _Nullable teamID;
+
+//cd hash
+@property(nonatomic, retain)NSData* _Nullable cdHash;
+
+//csflags
+@property(nonatomic, retain)NSNumber* _Nullable csFlags;
+
+//signing info
+// only set once generated
+@property(nonatomic, retain)NSDictionary* _Nullable signingInfo;
+
+/* METHODS */
+
+//(estimated) size
+// in bytes
+-(NSUInteger)size;
+
+@end
+
+/* OBJECT: EXECUTABLE CACHE */
+
+@interface ExecutableCache : NSObject
+
+/* METHODS */
+
+//init
+-(id _Nonnull)initWithMaxEntries:(NSUInteger)maxEntries;
+
+//find info for executable
+// keyed by (device, inode) from ES' stat of executable, and cd hash
+-(ExecutableInfo* _Nullable)find:(const ExecutableKey* _Nonnull)key csFlags:(uint32_t)csFlags;
+
+//add info for executable
+// evicts oldest, if at max entries
+-(void)add:(ExecutableInfo* _Nonnull)info key:(const ExecutableKey* _Nonnull)key;
+
+//stats
+// entries, memory (per entry), hit ratio
+-(NSDictionary* _Nonnull)stats;
+
+@end
+
+#endif /* ExecutableCache_h */
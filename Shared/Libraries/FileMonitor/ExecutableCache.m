@@ -0,0 +1,228 @@
+//
+//  ExecutableCache.m
+//  FileMonitor
+//
+//  Created by Patrick Wardle
+//  Copyright © 2025 Objective-See. All rights reserved.
+//
+
+//  per-executable metadata (name, signing info, etc). unlike caching whole
+//  processes, this doesn't pin any process' args/ancestors. the key is the executable's
+//  (device, inode), from the stat ES includes w/ each process (so no syscall), plus its cd
+//  hash, so a binary that's been replaced in place (e.g. updated) won't match
+
+@import OSLog;
+
+#import <os/lock.h>
+#import <objc/runtime.h>
+
+#import "ExecutableCache.h"
+
+@implementation ExecutableInfo
+
+@synthesize name;
+@synthesize teamID;
+@synthesize cdHash;
+@synthesize csFlags;
+@synthesize signingID;
+@synthesize signingInfo;
+
+//(estimated) size
+// object, strings, and signing info
+-(NSUInteger)size
+{
+    //size
+    NSUInteger size = 0;
+
+    //object
+    size = class_getInstanceSize([self class]) + sizeof(ExecutableKey);
+
+    //strings
+    size += [self.name lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    size += [self.signingID lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    size += [self.teamID lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+
+    //cd hash
+    size += self.cdHash.length;
+
+    //signing info
+    // rough estimate, per key/value
+    size += self.signingInfo.count * 64;
+
+    return size;
+}
+
+@end
+
+@interface ExecutableCache ()
+{
+    //lock
+    os_unfair_lock lock;
+
+    //max entries
+    NSUInteger maxEntries;
+
+    //(estimated) memory
+    NSUInteger memory;
+
+    //counters
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+}
+
+//entries
+// key: ExecutableKey (as data)
+@property(nonatomic, retain)NSMutableDictionary<NSData*, ExecutableInfo*>* entries;
+
+//keys
+// in order added, for eviction
+// note: ordered set, so removing any (e.g. replaced/invalidated) key is O(1)
+@property(nonatomic, retain)NSMutableOrderedSet<NSData*>* keys;
+
+@end
+
+@implementation ExecutableCache
+
+@synthesize keys;
+@synthesize entries;
+
+//init
+-(id)initWithMaxEntries:(NSUInteger)max
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init
+        lock = OS_UNFAIR_LOCK_INIT;
+        maxEntries = MAX(max, 1);
+
+        //alloc
+        keys = [NSMutableOrderedSet orderedSet];
+        entries = [NSMutableDictionary dictionary];
+    }
+
+    return self;
+}
+
+//find info for executable
+// ...and make sure cs flags still match
+-(ExecutableInfo*)find:(const ExecutableKey*)executableKey csFlags:(uint32_t)csFlags
+{
+    //info
+    ExecutableInfo* info = nil;
+
+    //key
+    NSData* key = [NSData dataWithBytes:executableKey length:sizeof(ExecutableKey)];
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //find
+    info = self.entries[key];
+
+    //(basic) sanity check
+    // make sure cs flags still match
+    if( (nil != info) &&
+        (info.csFlags.unsignedIntValue != csFlags) )
+    {
+        //remove
+        [self remove:key];
+
+        //unset
+        info = nil;
+    }
+
+    //inc
+    if(nil != info) hits++;
+    else misses++;
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return info;
+}
+
+//add info for executable
+-(void)add:(ExecutableInfo*)info key:(const ExecutableKey*)executableKey
+{
+    //key
+    NSData* key = [NSData dataWithBytes:executableKey length:sizeof(ExecutableKey)];
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //existing?
+    // remove, so it's replaced
+    if(nil != self.entries[key])
+    {
+        //remove
+        [self remove:key];
+    }
+
+    //at max?
+    // evict oldest
+    if(self.entries.count >= maxEntries)
+    {
+        //remove
+        [self remove:self.keys.firstObject];
+
+        //inc
+        evictions++;
+    }
+
+    //add
+    self.entries[key] = info;
+    [self.keys addObject:key];
+
+    //inc
+    memory += info.size;
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return;
+}
+
+//remove entry
+// note: caller must hold lock
+-(void)remove:(NSData*)key
+{
+    //dec
+    memory -= self.entries[key].size;
+
+    //remove
+    [self.entries removeObjectForKey:key];
+    [self.keys removeObject:key];
+
+    return;
+}
+
+//stats
+// entries, memory (per entry), hit ratio
+-(NSDictionary*)stats
+{
+    //stats
+    NSDictionary* stats = nil;
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //init
+    stats = @{@"entries":@(self.entries.count),
+              @"max entries":@(maxEntries),
+              @"memory (bytes, est.)":@(memory),
+              @"memory per entry (bytes, est.)":@((0 != self.entries.count) ? (memory / self.entries.count) : 0),
+              @"hits":@(hits),
+              @"misses":@(misses),
+              @"hit rate (%)":@((0 != hits + misses) ? ((100 * hits) / (hits + misses)) : 0),
+              @"evictions":@(evictions)};
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return stats;
+}
+
+@end
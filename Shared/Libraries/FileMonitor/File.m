@@ -13,6 +13,7 @@
 #import <sys/sysctl.h>
 
 #import "FileMonitor.h"
+#import "ProcessTable.h"
 #import "utilities.h"
 
 //log handle
@@ -20,23 +21,98 @@ extern os_log_t logHandle;
 
 /* GLOBALS */
 
-//processes cache
-extern NSCache* processCache;
+//process table
+extern ProcessTable* processTable;
 
 /* FUNCTIONS */
 
+//init view from string token
+// NULL (empty) if token is
+static void initView(PathView* view, const es_string_token_t* dir, const es_string_token_t* name)
+{
+    //reset
+    memset(view, 0, sizeof(PathView));
+    
+    //sanity check
+    if( (NULL == dir->data) ||
+        (0 == dir->length) )
+    {
+        //bail
+        return;
+    }
+    
+    //set dir
+    view->dir = dir->data;
+    view->dirLength = dir->length;
+    
+    //set name
+    if( (NULL != name) &&
+        (NULL != name->data) &&
+        (0 != name->length) )
+    {
+        view->name = name->data;
+        view->nameLength = name->length;
+    }
+    
+    return;
+}
+
+//create path from view
+// combines dir and name (if any), w/ a single allocation
+NSString* pathFromView(const PathView* view)
+{
+    //buffer
+    char buffer[PATH_MAX] = {0};
+    
+    //length
+    size_t length = 0;
+    
+    //no path?
+    if(NULL == view->dir) return nil;
+    
+    //no name?
+    // dir is full path
+    if(NULL == view->name)
+    {
+        return [[NSString alloc] initWithBytes:view->dir length:view->dirLength encoding:NSUTF8StringEncoding];
+    }
+    
+    //too long?
+    // combine as strings
+    if( (view->dirLength + 1 + view->nameLength) > sizeof(buffer) )
+    {
+        return [[[NSString alloc] initWithBytes:view->dir length:view->dirLength encoding:NSUTF8StringEncoding] stringByAppendingPathComponent:[[NSString alloc] initWithBytes:view->name length:view->nameLength encoding:NSUTF8StringEncoding]];
+    }
+    
+    //add dir
+    memcpy(buffer, view->dir, view->dirLength);
+    length = view->dirLength;
+    
+    //add separator
+    // unless dir already ends w/ one (i.e. '/')
+    if('/' != buffer[length-1]) buffer[length++] = '/';
+    
+    //add name
+    memcpy(buffer + length, view->name, view->nameLength);
+    length += view->nameLength;
+    
+    return [[NSString alloc] initWithBytes:buffer length:length encoding:NSUTF8StringEncoding];
+}
+
 @implementation File
 
 @synthesize process;
 @synthesize timestamp;
+@synthesize sourceView;
 @synthesize sourcePath;
+@synthesize destinationView;
 @synthesize destinationPath;
 
 //init
 -(id)init:(es_message_t*)message csOption:(NSUInteger)csOption
 {
     //process audit token
-    NSData* auditToken = nil;
+    const audit_token_t* auditToken = NULL;
     
     //init super
     self = [super init];
@@ -53,18 +129,26 @@ extern NSCache* processCache;
         if(message->event_type == ES_EVENT_TYPE_NOTIFY_BTM_LAUNCH_ITEM_ADD) {
             if( (message->version >= 8) &&
                 (message->event.btm_launch_item_add->instigator_token) ) {
-                auditToken = [NSData dataWithBytes:&message->event.btm_launch_item_add->instigator_token length:sizeof(audit_token_t)];
+                auditToken = message->event.btm_launch_item_add->instigator_token;
             }
         }
         
+        //exec
+        // process is the new image (w/ new pid version), so key by that
+        // and remove old image, as it's been replaced (and won't exit)
+        else if(ES_EVENT_TYPE_NOTIFY_EXEC == message->event_type) {
+            auditToken = &message->event.exec.target->audit_token;
+            [processTable remove:&message->process->audit_token];
+        }
+        
         //default to process in ES msg
-        if(!auditToken) {
-            auditToken = [NSData dataWithBytes:&message->process->audit_token length:sizeof(audit_token_t)];
+        if(NULL == auditToken) {
+            auditToken = &message->process->audit_token;
         }
         
-        //check cache for (same) process
+        //check table for (same) process
         // not found? create process obj...
-        self.process = [processCache objectForKey:auditToken];
+        self.process = [processTable find:auditToken];
         if(nil == self.process)
         {
             //create process
@@ -82,8 +166,8 @@ extern NSCache* processCache;
             goto bail;
         }
         
-        //add to cache
-        [processCache setObject:process forKey:auditToken];
+        //add to table
+        [processTable add:process token:auditToken];
     
         //extract file path(s)
         // logic is specific to event
@@ -95,8 +179,9 @@ bail:
     return self;
 }
 
-//extract source & destination path
+//extract source & destination path (views)
 // this requires event specific logic
+// note: paths (strings) are only created on access, as most events don't match
 -(void)extractPaths:(es_message_t*)message
 {
     //event specific logic
@@ -109,13 +194,13 @@ bail:
             if(ES_DESTINATION_TYPE_EXISTING_FILE == message->event.create.destination_type)
             {
                 //set
-                self.destinationPath = convertStringToken(&message->event.create.destination.existing_file->path);
+                initView(&destinationView, &message->event.create.destination.existing_file->path, NULL);
             }
             //destination, for new path
             else
             {
-                //set, via combining
-                self.destinationPath = [convertStringToken(&message->event.create.destination.new_path.dir->path) stringByAppendingPathComponent:convertStringToken(&message->event.create.destination.new_path.filename)];
+                //set, dir and file name
+                initView(&destinationView, &message->event.create.destination.new_path.dir->path, &message->event.create.destination.new_path.filename);
             }
             
             break;
@@ -126,28 +211,41 @@ bail:
         case ES_EVENT_TYPE_NOTIFY_WRITE:
             
             //set destination
-            self.destinationPath = convertStringToken(&message->event.write.target->path);
+            initView(&destinationView, &message->event.write.target->path, NULL);
             
             break;
             
         
+        //close
+        // only if file was modified (i.e. written)
+        case ES_EVENT_TYPE_NOTIFY_CLOSE:
+            
+            //modified?
+            if(true == message->event.close.modified)
+            {
+                //set destination
+                initView(&destinationView, &message->event.close.target->path, NULL);
+            }
+            
+            break;
+            
         //rename
         case ES_EVENT_TYPE_NOTIFY_RENAME:
             
             //set source
-            self.sourcePath = convertStringToken(&message->event.rename.source->path);
+            initView(&sourceView, &message->event.rename.source->path, NULL);
             
             //destination, for existing file
             if(ES_DESTINATION_TYPE_EXISTING_FILE == message->event.rename.destination_type)
             {
                 //set
-                self.destinationPath = convertStringToken(&message->event.rename.destination.existing_file->path);
+                initView(&destinationView, &message->event.rename.destination.existing_file->path, NULL);
             }
             //destination, for new path
             else
             {
-                //set, via combining
-                self.destinationPath = [convertStringToken(&message->event.rename.destination.new_path.dir->path) stringByAppendingPathComponent:convertStringToken(&message->event.rename.destination.new_path.filename)];
+                //set, dir and file name
+                initView(&destinationView, &message->event.rename.destination.new_path.dir->path, &message->event.rename.destination.new_path.filename);
             }
             
             break;
@@ -159,6 +257,55 @@ bail:
     return;
 }
 
+//source path
+// created from view on first access
+-(NSString*)sourcePath
+{
+    //create
+    if( (nil == sourcePath) &&
+        (NULL != sourceView.dir) )
+    {
+        sourcePath = pathFromView(&sourceView);
+    }
+    
+    return sourcePath;
+}
+
+//destination path
+// created from view on first access
+-(NSString*)destinationPath
+{
+    //create
+    if( (nil == destinationPath) &&
+        (NULL != destinationView.dir) )
+    {
+        destinationPath = pathFromView(&destinationView);
+    }
+    
+    return destinationPath;
+}
+
+//create paths from views
+-(void)materialize
+{
+    //create
+    [self sourcePath];
+    [self destinationPath];
+    
+    return;
+}
+
+//detach from ES message
+// views point into it, so clear
+-(void)detach
+{
+    //clear
+    memset(&sourceView, 0, sizeof(PathView));
+    memset(&destinationView, 0, sizeof(PathView));
+    
+    return;
+}
+
 //for pretty printing
 // though we convert to JSON
 -(NSString *)description
@@ -192,6 +339,11 @@ bail:
         case ES_EVENT_TYPE_NOTIFY_RENAME:
             [description appendString:@"\"ES_EVENT_TYPE_NOTIFY_RENAME\","];
             break;
+            
+        //close
+        case ES_EVENT_TYPE_NOTIFY_CLOSE:
+            [description appendString:@"\"ES_EVENT_TYPE_NOTIFY_CLOSE\","];
+            break;
                         
         default:
             break;
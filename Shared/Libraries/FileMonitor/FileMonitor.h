@@ -37,18 +37,54 @@ enum Architectures{ArchUnknown, ArchAppleSilicon, ArchIntel};
 
 /* TYPEDEFS */
 
+//path view
+// borrowed from an ES message, so only valid during the (file) callback
+// path is 'dir', or for new files, 'dir' + '/' + 'name'
+typedef struct
+{
+    //dir (or full path)
+    const char* _Nullable dir;
+    size_t dirLength;
+    
+    //file name
+    // NULL if 'dir' is full path
+    const char* _Nullable name;
+    size_t nameLength;
+    
+} PathView;
+
 //block for library
 typedef void (^FileCallbackBlock)(File* _Nonnull);
 
 @interface FileMonitor : NSObject
 
+/* PROPERTIES */
+
+//target path prefixes
+// if set (macOS 13+), file events are only delivered for paths under these
+@property(nonatomic, retain)NSArray<NSString*>* _Nullable targetPrefixes;
+
+/* METHODS */
+
+//will file events be restricted to target paths?
+// i.e. target prefixes are set, and inverted (target path) muting is supported (macOS 13+)
+-(BOOL)isTargeted;
+
 //start monitoring
 // pass in events of interest, count of said events, flag for codesigning, and callback
 -(BOOL)start:(es_event_type_t* _Nonnull)events count:(uint32_t)count csOption:(NSUInteger)csOption callback:(FileCallbackBlock _Nonnull)callback;
 
+//update target path prefixes
+// while monitoring, so (e.g.) a new user's directories are covered
+-(BOOL)retarget:(NSArray<NSString*>* _Nonnull)prefixes;
+
 //stop monitoring
 -(BOOL)stop;
 
+//stats
+// process table, process tree, executable/signing caches, processes, etc
+-(NSDictionary* _Nonnull)stats;
+
 @end
 
 /* OBJECT: FILE */
@@ -65,11 +101,21 @@ typedef void (^FileCallbackBlock)(File* _Nonnull);
 @property(nonatomic, retain)NSDate* _Nonnull timestamp;
 
 //src path
+// created from view on first access
 @property(nonatomic, retain)NSString* _Nullable sourcePath;
 
 //dest path
+// created from view on first access
 @property(nonatomic, retain)NSString* _Nullable destinationPath;
 
+//src path view
+// only valid during callback
+@property(nonatomic, readonly)PathView sourceView;
+
+//dest path view
+// only valid during callback
+@property(nonatomic, readonly)PathView destinationView;
+
 //process
 @property(nonatomic, retain)Process* _Nullable process;
 
@@ -78,8 +124,21 @@ typedef void (^FileCallbackBlock)(File* _Nonnull);
 //init
 -(id _Nullable)init:(es_message_t* _Nonnull)message csOption:(NSUInteger)csOption;
 
+//create paths from views
+// i.e. so they outlive the ES message (e.g. once matched)
+-(void)materialize;
+
+//detach from ES message
+// clears views, so paths not yet created are nil
+-(void)detach;
+
 @end
 
+/* FUNCTIONS */
+
+//create path from view
+NSString* _Nullable pathFromView(const PathView* _Nonnull view);
+
 /* OBJECT: PROCESS */
 
 @interface Process : NSObject
@@ -103,7 +162,7 @@ typedef void (^FileCallbackBlock)(File* _Nonnull);
 @property u_int32_t event;
 
 //cpu type
-@property NSUInteger architecture;
+@property(nonatomic) NSUInteger architecture;
 
 //exit code
 @property int exit;
@@ -123,6 +182,10 @@ typedef void (^FileCallbackBlock)(File* _Nonnull);
 //ancestors
 @property(nonatomic, retain)NSMutableArray* _Nonnull ancestors;
 
+//ancestors' paths
+// same order as ancestors, kept even if ancestor has since exited
+@property(nonatomic, retain)NSMutableArray* _Nonnull ancestorPaths;
+
 //platform binary
 @property(nonatomic, retain)NSNumber* _Nonnull isPlatformBinary;
 
@@ -139,7 +202,7 @@ typedef void (^FileCallbackBlock)(File* _Nonnull);
 @property(nonatomic, retain)NSString* _Nonnull teamID;
 
 //signing info
-// manually generated via CS APIs if `codesign:TRUE` is set
+// manually generated via CS APIs if `codesign:TRUE` is set (on first access)
 @property(nonatomic, retain)NSMutableDictionary* _Nonnull signingInfo;
 
 //timestamp
@@ -158,4 +221,8 @@ typedef void (^FileCallbackBlock)(File* _Nonnull);
 // sets 'signingInfo' iVar with resuls
 -(void)generateCSInfo:(NSUInteger)csOption;
 
+//stats
+// processes created, and how many had each (lazy) field resolved
++(NSDictionary* _Nonnull)stats;
+
 @end
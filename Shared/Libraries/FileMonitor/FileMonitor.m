@@ -12,8 +12,14 @@
 #import "consts.h"
 #import "utilities.h"
 #import "FileMonitor.h"
+#import "ProcessTree.h"
+#import "ProcessTable.h"
+#import "SigningCache.h"
+#import "SigningFlights.h"
+#import "ExecutableCache.h"
 
 #import <dlfcn.h>
+#import <os/lock.h>
 #import <Foundation/Foundation.h>
 #import <EndpointSecurity/EndpointSecurity.h>
 
@@ -26,18 +32,41 @@ es_client_t* endpointClient = nil;
 // responsibility_get_pid_responsible_for_pid
 pid_t (*getRPID)(pid_t pid) = NULL;
 
-//process cache
-NSCache* _Nonnull processCache;
+//process table
+// key: audit token
+ProcessTable* _Nonnull processTable;
 
-//processes cache
-NSCache* _Nonnull processesCache;
+//executable cache
+// key: (device, inode, cd hash)
+ExecutableCache* _Nonnull executableCache;
+
+//process tree
+// parent/responsible links, from fork/exec/exit
+ProcessTree* _Nonnull processTree;
+
+//signing (verdict) cache
+// key: (cd hash, team id), persisted
+SigningCache* _Nonnull signingCache;
+
+//in-flight signing checks
+// key: (cd hash, team id, option)
+SigningFlights* _Nonnull signingFlights;
 
 @interface FileMonitor ()
+{
+    //lock for args
+    // as (when targeted) they're saved/removed on the process client's queue, but read on the file client's
+    os_unfair_lock argumentsLock;
+}
 
 //process args (via `ES_EVENT_TYPE_NOTIFY_EXEC`)
 // so save, to report with all other file i/o events
 @property(atomic, retain)NSMutableDictionary* arguments;
 
+//endpoint (process) client
+// only used when file events are restricted to target paths
+@property es_client_t* processClient;
+
 @end
 
 @implementation FileMonitor
@@ -45,6 +74,12 @@ NSCache* _Nonnull processesCache;
 //args
 @synthesize arguments;
 
+//process client
+@synthesize processClient;
+
+//target prefixes
+@synthesize targetPrefixes;
+
 //init
 -(id)init
 {
@@ -55,21 +90,49 @@ NSCache* _Nonnull processesCache;
         //alloc agrugments dictionary
         arguments = [NSMutableDictionary dictionary];
         
+        //init lock for args
+        argumentsLock = OS_UNFAIR_LOCK_INIT;
+        
         //get function pointer
         getRPID = dlsym(RTLD_NEXT, "responsibility_get_pid_responsible_for_pid");
         
-        //init process cache
-        processCache = [[NSCache alloc] init];
-        processCache.countLimit = 2048;
+        //init process table
+        processTable = [[ProcessTable alloc] initWithMaxEntries:PROCESS_TABLE_MAX_ENTRIES];
+        
+        //init executable cache
+        executableCache = [[ExecutableCache alloc] initWithMaxEntries:EXECUTABLE_CACHE_MAX_ENTRIES];
         
-        //init processes cache
-        processesCache = [[NSCache alloc] init];
-        processesCache.countLimit = 2048;
+        //init process tree
+        processTree = [[ProcessTree alloc] init];
+        
+        //init signing cache
+        // loads (persisted) verdicts
+        signingCache = [[SigningCache alloc] initWithFile:[INSTALL_DIRECTORY stringByAppendingPathComponent:SIGNING_CACHE_FILE]];
+        
+        //init in-flight signing checks
+        // one worker per (active) core
+        signingFlights = [[SigningFlights alloc] initWithWorkers:NSProcessInfo.processInfo.activeProcessorCount];
     }
     
     return self;
 }
 
+//will file events be restricted to target paths?
+// requires inverted muting, which is macOS 13+
+-(BOOL)isTargeted
+{
+    //target paths?
+    if(0 == self.targetPrefixes.count) return NO;
+    
+    //supported?
+    if(@available(macOS 13.0, *))
+    {
+        return YES;
+    }
+    
+    return NO;
+}
+
 //start monitoring
 // pass in events of interest, count of said events, and callback
 -(BOOL)start:(es_event_type_t*)events count:(uint32_t)count csOption:(NSUInteger)csOption callback:(FileCallbackBlock)callback
@@ -77,20 +140,48 @@ NSCache* _Nonnull processesCache;
     //flag
     BOOL started = NO;
     
-    //result
-    es_new_client_result_t result = 0;
+    //flag
+    // restrict file events to target paths?
+    BOOL targeted = NO;
+    
+    //file events
+    es_event_type_t fileEvents[ES_EVENT_TYPE_LAST] = {0};
+    uint32_t fileEventsCount = 0;
+    
+    //process events
+    es_event_type_t processEvents[ES_EVENT_TYPE_LAST] = {0};
+    uint32_t processEventsCount = 0;
+    
+    //handler
+    es_handler_block_t handler = nil;
     
     //sync
     @synchronized (self)
     {
     
-    //create client
-    // callback invoked on file events
-    result = es_new_client(&endpointClient, ^(es_client_t *client, const es_message_t *message)
+    //handler
+    // invoked on file (and process) events
+    handler = ^(es_client_t *client, const es_message_t *message)
     {
         //new file obj
         File* file = nil;
         
+        //(saved) process args
+        NSMutableArray* processArgs = nil;
+        
+        //fork/exec?
+        // update process tree (first, so process' ancestors are current)
+        if( (ES_EVENT_TYPE_NOTIFY_FORK == message->event_type) ||
+            (ES_EVENT_TYPE_NOTIFY_EXEC == message->event_type) )
+        {
+            //update
+            [processTree update:message];
+            
+            //fork
+            // nothing else to do
+            if(ES_EVENT_TYPE_NOTIFY_FORK == message->event_type) return;
+        }
+        
         //init file obj
         // then generate args, code-signing info, etc
         file = [[File alloc] init:(es_message_t* _Nonnull)message csOption:csOption];
@@ -107,46 +198,62 @@ NSCache* _Nonnull processesCache;
                 return;
             }
                 
+            //grab args
+            // note: lock, as (when targeted) process client updates them concurrently
+            os_unfair_lock_lock(&self->argumentsLock);
+            processArgs = self.arguments[[NSNumber numberWithInt:file.process.pid]];
+            os_unfair_lock_unlock(&self->argumentsLock);
+            
             //add args
-            if(nil != self.arguments[[NSNumber numberWithInt:file.process.pid]])
+            if(nil != processArgs)
             {
                 //add
-                file.process.arguments = self.arguments[[NSNumber numberWithInt:file.process.pid]];
+                file.process.arguments = processArgs;
             }
         
             //invoke user callback
             callback(file);
+            
+            //detach
+            // as message (which views point into) is only valid till we return
+            [file detach];
         }
-    });
+    };
     
-    //error?
-    if(ES_NEW_CLIENT_RESULT_SUCCESS != result)
+    //target paths?
+    // requires inverted muting, which is macOS 13+
+    targeted = [self isTargeted];
+    
+    //seed process tree
+    // w/ processes that predate monitoring
+    [processTree seed];
+    
+    //split events
+    // when file events are restricted, process events (fork/exec/exit) need their own client
+    // note: each client delivers its messages in order, but there's no ordering between clients
+    //       so a process' file event may be handled before (or concurrently with) its exec/exit
+    //       thus shared state (args, process table/tree) is locked, and may lag (e.g. file event lacks args)
+    for(uint32_t i = 0; i < count; i++)
     {
-        //err msg
-        NSLog(@"ERROR: es_new_client() failed with %#x", result);
-        
-        //provide more info
-        switch (result) {
-                
-            //not entitled
-            case ES_NEW_CLIENT_RESULT_ERR_NOT_ENTITLED:
-                NSLog(@"ES_NEW_CLIENT_RESULT_ERR_NOT_ENTITLED: \"The caller is not properly entitled to connect\"");
-                break;
-                      
-            //not permitted
-            case ES_NEW_CLIENT_RESULT_ERR_NOT_PERMITTED:
-                NSLog(@"ES_NEW_CLIENT_RESULT_ERR_NOT_PERMITTED: \"The caller is not permitted to connect. They lack Transparency, Consent, and Control (TCC) approval form the user.\"");
-                break;
-                      
-            //not privileged
-            case ES_NEW_CLIENT_RESULT_ERR_NOT_PRIVILEGED:
-                NSLog(@"ES_NEW_CLIENT_RESULT_ERR_NOT_PRIVILEGED: \"The caller is not running as root\"");
-                break;
-                
-            default:
-                break;
+        //process event?
+        if( (YES == targeted) &&
+            ((ES_EVENT_TYPE_NOTIFY_FORK == events[i]) || (ES_EVENT_TYPE_NOTIFY_EXEC == events[i]) || (ES_EVENT_TYPE_NOTIFY_EXIT == events[i])) )
+        {
+            //add
+            processEvents[processEventsCount++] = events[i];
+        }
+        //file event
+        else
+        {
+            //add
+            fileEvents[fileEventsCount++] = events[i];
         }
+    }
     
+    //create client
+    endpointClient = [self createClient:handler];
+    if(NULL == endpointClient)
+    {
         //bail
         goto bail;
     }
@@ -166,9 +273,41 @@ NSCache* _Nonnull processesCache;
         
     //mute log
     es_mute_path_literal(endpointClient, UNIVERSAL_LOG);
+    
+    //restrict to target paths
+    // invert (target path) muting, then 'mute' each prefix, so only events under them are delivered
+    if(YES == targeted)
+    {
+        if(@available(macOS 13.0, *))
+        {
+            //invert
+            if(ES_RETURN_SUCCESS != es_invert_muting(endpointClient, ES_MUTE_INVERSION_TYPE_TARGET_PATH))
+            {
+                //err msg
+                NSLog(@"ERROR: es_invert_muting() failed");
+                
+                //bail
+                goto bail;
+            }
+            
+            //add each prefix
+            for(NSString* prefix in self.targetPrefixes)
+            {
+                //mute
+                if(ES_RETURN_SUCCESS != es_mute_path(endpointClient, prefix.UTF8String, ES_MUTE_PATH_TYPE_TARGET_PREFIX))
+                {
+                    //err msg
+                    NSLog(@"ERROR: es_mute_path() failed for %@", prefix);
+                    
+                    //bail
+                    goto bail;
+                }
+            }
+        }
+    }
 
     //subscribe
-    if(ES_RETURN_SUCCESS != es_subscribe(endpointClient, events, count))
+    if(ES_RETURN_SUCCESS != es_subscribe(endpointClient, fileEvents, fileEventsCount))
     {
         //err msg
         NSLog(@"ERROR: es_subscribe() failed");
@@ -176,6 +315,32 @@ NSCache* _Nonnull processesCache;
         //bail
         goto bail;
     }
+    
+    //process events?
+    // subscribe via own (non-targeted) client
+    if(0 != processEventsCount)
+    {
+        //create client
+        self.processClient = [self createClient:handler];
+        if(NULL == self.processClient)
+        {
+            //bail
+            goto bail;
+        }
+        
+        //mute self
+        es_mute_path_literal(self.processClient, [NSProcessInfo.processInfo.arguments[0] UTF8String]);
+        
+        //subscribe
+        if(ES_RETURN_SUCCESS != es_subscribe(self.processClient, processEvents, processEventsCount))
+        {
+            //err msg
+            NSLog(@"ERROR: es_subscribe() failed (process events)");
+            
+            //bail
+            goto bail;
+        }
+    }
         
     } //sync
     
@@ -187,6 +352,54 @@ bail:
     return started;
 }
 
+//create endpoint client
+// logs more info on failure
+-(es_client_t*)createClient:(es_handler_block_t)handler
+{
+    //client
+    es_client_t* client = NULL;
+    
+    //result
+    es_new_client_result_t result = 0;
+    
+    //create client
+    result = es_new_client(&client, handler);
+    
+    //error?
+    if(ES_NEW_CLIENT_RESULT_SUCCESS != result)
+    {
+        //err msg
+        NSLog(@"ERROR: es_new_client() failed with %#x", result);
+        
+        //provide more info
+        switch (result) {
+                
+            //not entitled
+            case ES_NEW_CLIENT_RESULT_ERR_NOT_ENTITLED:
+                NSLog(@"ES_NEW_CLIENT_RESULT_ERR_NOT_ENTITLED: \"The caller is not properly entitled to connect\"");
+                break;
+                      
+            //not permitted
+            case ES_NEW_CLIENT_RESULT_ERR_NOT_PERMITTED:
+                NSLog(@"ES_NEW_CLIENT_RESULT_ERR_NOT_PERMITTED: \"The caller is not permitted to connect. They lack Transparency, Consent, and Control (TCC) approval form the user.\"");
+                break;
+                      
+            //not privileged
+            case ES_NEW_CLIENT_RESULT_ERR_NOT_PRIVILEGED:
+                NSLog(@"ES_NEW_CLIENT_RESULT_ERR_NOT_PRIVILEGED: \"The caller is not running as root\"");
+                break;
+                
+            default:
+                break;
+        }
+        
+        //unset
+        client = NULL;
+    }
+    
+    return client;
+}
+
 //process args
 -(void)processArgs:(const es_message_t*)message file:(File*)file
 {
@@ -196,20 +409,115 @@ bail:
         (ES_EVENT_TYPE_NOTIFY_EXEC == message->event_type) )
     {
         //save args
+        os_unfair_lock_lock(&argumentsLock);
         self.arguments[[NSNumber numberWithInt:file.process.pid]] = file.process.arguments;
+        os_unfair_lock_unlock(&argumentsLock);
     }
     
     //process exit?
-    // remove saved process args
+    // remove saved process args, and process
     else if(ES_EVENT_TYPE_NOTIFY_EXIT == message->event_type)
     {
         //remove args
+        os_unfair_lock_lock(&argumentsLock);
         [self.arguments removeObjectForKey:[NSNumber numberWithInt:file.process.pid]];
+        os_unfair_lock_unlock(&argumentsLock);
+        
+        //remove process
+        [processTable remove:&message->process->audit_token];
+        
+        //update process tree
+        [processTree update:message];
     }
     
     return;
 }
 
+//stats
+// process table, process tree, executable/signing caches, processes, etc
+-(NSDictionary*)stats
+{
+    return @{@"process table":[processTable stats], @"process tree":[processTree stats], @"executable cache":[executableCache stats], @"processes":[Process stats], @"signing cache":[signingCache stats], @"signing checks":[signingFlights stats]};
+}
+
+//update target path prefixes
+// adds new ones first, then removes old ones, so no (still targeted) events are missed in between
+-(BOOL)retarget:(NSArray<NSString*>*)prefixes
+{
+    //flag
+    BOOL retargeted = NO;
+    
+    //sync
+    @synchronized (self)
+    {
+    
+    //not targeted?
+    // or not started
+    if( (YES != [self isTargeted]) ||
+        (NULL == endpointClient) )
+    {
+        //bail
+        goto bail;
+    }
+    
+    //no prefixes?
+    // can't (now) switch to watching everything
+    if(0 == prefixes.count)
+    {
+        //bail
+        goto bail;
+    }
+    
+    if(@available(macOS 13.0, *))
+    {
+        //add new prefixes
+        for(NSString* prefix in prefixes)
+        {
+            //existing?
+            if(YES == [self.targetPrefixes containsObject:prefix]) continue;
+            
+            //mute
+            // i.e. target, as muting is inverted
+            if(ES_RETURN_SUCCESS != es_mute_path(endpointClient, prefix.UTF8String, ES_MUTE_PATH_TYPE_TARGET_PREFIX))
+            {
+                //err msg
+                NSLog(@"ERROR: es_mute_path() failed for %@", prefix);
+                
+                //bail
+                goto bail;
+            }
+        }
+        
+        //remove old prefixes
+        for(NSString* prefix in self.targetPrefixes)
+        {
+            //still needed?
+            if(YES == [prefixes containsObject:prefix]) continue;
+            
+            //unmute
+            // i.e. untarget, as muting is inverted
+            if(ES_RETURN_SUCCESS != es_unmute_path(endpointClient, prefix.UTF8String, ES_MUTE_PATH_TYPE_TARGET_PREFIX))
+            {
+                //err msg
+                // not fatal, just means (some) extra events
+                NSLog(@"ERROR: es_unmute_path() failed for %@", prefix);
+            }
+        }
+    }
+    
+    //save
+    self.targetPrefixes = prefixes;
+    
+    //happy
+    retargeted = YES;
+        
+    } //sync
+    
+bail:
+    
+    return retargeted;
+}
+
 //stop
 -(BOOL)stop
 {
@@ -219,29 +527,31 @@ bail:
     //sync
     @synchronized (self)
     {
+    
+    //process client?
+    // unsubscribe & delete
+    if(NULL != self.processClient)
+    {
+        //delete
+        if(YES != [self deleteClient:self.processClient])
+        {
+            //bail
+            goto bail;
+        }
+        
+        //unset
+        self.processClient = NULL;
+    }
         
     //unsubscribe & delete
     if(NULL != endpointClient)
     {
-       //unsubscribe
-       if(ES_RETURN_SUCCESS != es_unsubscribe_all(endpointClient))
-       {
-           //err msg
-           NSLog(@"ERROR: es_unsubscribe_all() failed");
-           
-           //bail
-           goto bail;
-       }
-       
-       //delete
-       if(ES_RETURN_SUCCESS != es_delete_client(endpointClient))
-       {
-           //err msg
-           NSLog(@"ERROR: es_delete_client() failed");
-           
-           //bail
-           goto bail;
-       }
+        //delete
+        if(YES != [self deleteClient:endpointClient])
+        {
+            //bail
+            goto bail;
+        }
        
        //unset
        endpointClient = NULL;
@@ -254,7 +564,44 @@ bail:
     
 bail:
     
+    //save (any unsaved) signing verdicts
+    [signingCache save];
+    
     return stopped;
 }
 
+//unsubscribe & delete endpoint client
+-(BOOL)deleteClient:(es_client_t*)client
+{
+    //flag
+    BOOL deleted = NO;
+    
+    //unsubscribe
+    if(ES_RETURN_SUCCESS != es_unsubscribe_all(client))
+    {
+        //err msg
+        NSLog(@"ERROR: es_unsubscribe_all() failed");
+        
+        //bail
+        goto bail;
+    }
+    
+    //delete
+    if(ES_RETURN_SUCCESS != es_delete_client(client))
+    {
+        //err msg
+        NSLog(@"ERROR: es_delete_client() failed");
+        
+        //bail
+        goto bail;
+    }
+    
+    //happy
+    deleted = YES;
+    
+bail:
+    
+    return deleted;
+}
+
 @end
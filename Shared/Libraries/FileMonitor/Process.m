@@ -9,6 +9,7 @@
 @import OSLog;
 
 #import <dlfcn.h>
+#import <mach/mach_time.h>
 #import <libproc.h>
 #import <bsm/libbsm.h>
 #import <sys/sysctl.h>
@@ -16,6 +17,10 @@
 #import "signing.h"
 #import "utilities.h"
 #import "FileMonitor.h"
+#import "ProcessTree.h"
+#import "SigningCache.h"
+#import "SigningFlights.h"
+#import "ExecutableCache.h"
 
 //hash length
 // from: cs_blobs.h
@@ -23,11 +28,17 @@
 
 /* GLOBALS */
 
-//processes cache
-extern NSCache* processesCache;
+//executable cache
+extern ExecutableCache* executableCache;
 
-//responsbile pid
-extern pid_t (*getRPID)(pid_t pid);
+//signing (verdict) cache
+extern SigningCache* signingCache;
+
+//in-flight signing checks
+extern SigningFlights* signingFlights;
+
+//process tree
+extern ProcessTree* processTree;
 
 //log handle
 extern os_log_t logHandle;
@@ -35,21 +46,80 @@ extern os_log_t logHandle;
 //interpreters
 extern NSMutableSet* interpreters;
 
+//counters
+// processes, and what was (lazily) resolved for them
+static _Atomic uint64_t processesCreated = 0;
+static _Atomic uint64_t executablesResolved = 0;
+static _Atomic uint64_t executablesGenerated = 0;
+static _Atomic uint64_t architecturesResolved = 0;
+static _Atomic uint64_t ancestorsResolved = 0;
+static _Atomic uint64_t scriptsResolved = 0;
+static _Atomic uint64_t scriptLookups = 0;
+static _Atomic uint64_t signingInfoResolved = 0;
+static _Atomic uint64_t signingInfoGenerated = 0;
+static _Atomic uint64_t sysctlCalls = 0;
+
 /* FUNCTIONS */
 
 //helper function
 // get parent of arbitrary process
 pid_t getParentID(pid_t child);
 
+//helper function
+// percent of total (0 if none)
+static uint64_t percentOf(uint64_t count, uint64_t total)
+{
+    return (0 != total) ? ((100 * count) / total) : 0;
+}
+
+//  only what's (cheaply) in the ES message is captured when a process is created. name,
+//  architecture, cd hash, ancestors, script, and signing info are resolved on first access
+//  (e.g. once a plugin has matched), as most file events are never reported
+
+@interface Process ()
+{
+    //audit token
+    audit_token_t token;
+    
+    //code signing option
+    NSUInteger codeSigningOption;
+    
+    //executable key
+    // (device, inode, cd hash)
+    ExecutableKey executableKey;
+    
+    //node in process tree
+    // captured now, as process may have exited by the time ancestors are resolved
+    ProcessNode* node;
+    
+    //script (from ES)
+    NSString* execScript;
+    
+    //cwd (from ES)
+    NSString* execCWD;
+    
+    //resolved flags
+    BOOL resolvedExecutable;
+    BOOL resolvedArchitecture;
+    BOOL resolvedAncestors;
+    BOOL resolvedScript;
+    BOOL resolvedSigningInfo;
+}
+
+@end
+
 @implementation Process
 
 @synthesize pid;
 @synthesize exit;
+@synthesize name;
 @synthesize path;
 @synthesize ppid;
 @synthesize event;
+@synthesize cdHash;
 @synthesize script;
 @synthesize ancestors;
+@synthesize ancestorPaths;
 @synthesize arguments;
 @synthesize timestamp;
 @synthesize auditToken;
@@ -58,6 +128,7 @@ pid_t getParentID(pid_t child);
 
 //init
 // flag controls code signing options
+// note: only captures what's in the message, as the rest is resolved lazily
 -(id)init:(es_message_t*)message csOption:(NSUInteger)csOption
 {
     //string value
@@ -67,24 +138,18 @@ pid_t getParentID(pid_t child);
     //process from msg
     es_process_t* process = NULL;
     
-    //inode
-    NSNumber* inode = 0;
-    
-    //cached process
-    Process* cachedProcess = nil;
-    
     //init super
     self = [super init];
     if(nil != self)
     {
+        //inc
+        processesCreated++;
+        
         //alloc array for args
         self.arguments = [NSMutableArray array];
         
-        //alloc array for parents
-        self.ancestors = [NSMutableArray array];
-        
-        //alloc dictionary for signing info
-        self.signingInfo = [NSMutableDictionary dictionary];
+        //save code signing option
+        codeSigningOption = csOption;
         
         //init exit
         self.exit = -1;
@@ -101,9 +166,6 @@ pid_t getParentID(pid_t child);
         //set type
         self.event = message->event_type;
         
-        //init
-        self.script = NULL;
-        
         //event specific logic
         
         // set type
@@ -120,6 +182,20 @@ pid_t getParentID(pid_t child);
                 //extract/format args
                 [self extractArgs:&message->event];
                 
+                //save script
+                if( (message->version >= 2) &&
+                    (NULL != message->event.exec.script) )
+                {
+                    execScript = convertStringToken(&message->event.exec.script->path);
+                }
+                
+                //save CWD
+                if( (message->version >= 3) &&
+                    (NULL != message->event.exec.cwd) )
+                {
+                    execCWD = convertStringToken(&message->event.exec.cwd->path);
+                }
+                
                 break;
                 
             //fork
@@ -165,8 +241,8 @@ pid_t getParentID(pid_t child);
                 break;
         }
         
-        //init audit token
-        self.auditToken = [NSData dataWithBytes:&process->audit_token length:sizeof(audit_token_t)];
+        //save audit token
+        token = process->audit_token;
         
         //init pid
         self.pid = audit_token_to_pid(process->audit_token);
@@ -189,192 +265,398 @@ pid_t getParentID(pid_t child);
         //path
         self.path = convertStringToken(&process->executable->path);
         
-        //now grab inode
-        inode = [NSNumber numberWithUnsignedLong:[self inode]];
-        
-        //now attempt to find cached process
-        // via inode, so will be same binary (though pid/args, etc will be different)
-        cachedProcess = [processesCache objectForKey:inode];
-        
-        //(basic) sanity check
-        // make sure cs flags still match
-        if(YES != [self.csFlags isEqualTo:cachedProcess.csFlags])
-        {
-            //unset
-            cachedProcess = nil;
-            
-            //remove
-            [processesCache removeObjectForKey:inode];
-        }
-        
-        //generate name
-        if(nil == cachedProcess)
-        {
-            self.name = [self getName];
-        }
-        //from cache
-        else
-        {
-            self.name = cachedProcess.name;
-        }
-        
-        //cpu type
-        if(nil == cachedProcess)
-        {
-            self.architecture = [self getArchitecture];
-        }
-        //from cache
-        else
-        {
-            self.architecture = cachedProcess.architecture;
-        }
-    
         //add signing id
-        if(nil == cachedProcess)
-        {
-            if(nil != (string = convertStringToken(&process->signing_id)))
-            {
-                //add
-                self.signingID = string;
-            }
-        }
-        //from cache
-        else
+        if(nil != (string = convertStringToken(&process->signing_id)))
         {
-            self.signingID = cachedProcess.signingID;
+            //add
+            self.signingID = string;
         }
         
         //add team id
-        if(nil == cachedProcess)
-        {
-            if(nil != (string = convertStringToken(&process->team_id)))
-            {
-                //add
-                self.teamID = string;
-            }
-        }
-        //from cache
-        else
+        if(nil != (string = convertStringToken(&process->team_id)))
         {
-            self.teamID = cachedProcess.teamID;
+            //add
+            self.teamID = string;
         }
         
         //add platform binary
         self.isPlatformBinary = [NSNumber numberWithBool:process->is_platform_binary];
         
-        //save cd hash
-        if(nil == cachedProcess)
+        //save executable key
+        // (device, inode) from ES (so no stat), and cd hash
+        executableKey.device = process->executable->stat.st_dev;
+        executableKey.inode = process->executable->stat.st_ino;
+        memcpy(executableKey.cdHash, process->cdhash, sizeof(es_cdhash_t));
+        
+        //save node in process tree
+        // by pid and pid version, so a (stale) node of a prior process w/ same pid isn't used
+        node = [processTree find:self.pid pidversion:audit_token_to_pidversion(token)];
+    }
+    
+    return self;
+}
+
+//audit token
+// created on first access
+-(NSData*)auditToken
+{
+    @synchronized(self)
+    {
+        //create
+        if(nil == auditToken)
         {
-            self.cdHash = [NSData dataWithBytes:(const void *)process->cdhash length:sizeof(uint8_t)*CS_CDHASH_LEN];
+            auditToken = [NSData dataWithBytes:&token length:sizeof(audit_token_t)];
         }
-        //from cache
-        else
+        
+        return auditToken;
+    }
+}
+
+//cd hash
+// created on first access
+-(NSData*)cdHash
+{
+    @synchronized(self)
+    {
+        //create
+        if(nil == cdHash)
         {
-            self.cdHash = cachedProcess.cdHash;
+            cdHash = [NSData dataWithBytes:executableKey.cdHash length:sizeof(uint8_t)*CS_CDHASH_LEN];
         }
-               
-        //when specified
-        // generate full code signing info
-        if(csNone != csOption) {
+        
+        return cdHash;
+    }
+}
+
+//name
+// resolved on first access
+-(NSString*)name
+{
+    @synchronized(self)
+    {
+        //resolve
+        [self resolveExecutable];
+        
+        return name;
+    }
+}
+
+//architecture
+// resolved on first access
+// note: per process (not per executable), as a universal binary may run native or translated
+-(NSUInteger)architecture
+{
+    @synchronized(self)
+    {
+        //resolve
+        if(YES != resolvedArchitecture)
+        {
+            //set
+            resolvedArchitecture = YES;
             
-            //use cached signing info (if available)
-            if(cachedProcess.signingInfo.count)
-            {
-                self.signingInfo = cachedProcess.signingInfo;
-            }
-            //otherwise generate
-            else
-            {
-                [self generateCSInfo:csOption];
-            }
+            //inc
+            architecturesResolved++;
+            
+            //cpu type
+            architecture = [self getArchitecture];
         }
         
-        //script
-        if(message->version >= 2)
+        return architecture;
+    }
+}
+
+//ancestors
+// resolved on first access
+-(NSMutableArray*)ancestors
+{
+    @synchronized(self)
+    {
+        //resolve
+        [self enumerateAncestors];
+        
+        return ancestors;
+    }
+}
+
+//ancestors' paths
+// resolved on first access
+-(NSMutableArray*)ancestorPaths
+{
+    @synchronized(self)
+    {
+        //resolve
+        [self enumerateAncestors];
+        
+        return ancestorPaths;
+    }
+}
+
+//script
+// resolved on first access
+-(NSString*)script
+{
+    @synchronized(self)
+    {
+        //resolve
+        [self resolveScript];
+        
+        return script;
+    }
+}
+
+//signing info
+// resolved (generated, if specified) on first access
+-(NSMutableDictionary*)signingInfo
+{
+    //cached executable info
+    ExecutableInfo* cachedInfo = nil;
+    
+    @synchronized(self)
+    {
+        //resolve
+        if(YES != resolvedSigningInfo)
         {
-            //check event type
-            if( (ES_EVENT_TYPE_AUTH_EXEC == message->event_type) ||
-                (ES_EVENT_TYPE_NOTIFY_EXEC == message->event_type) )
+            //set
+            resolvedSigningInfo = YES;
+            
+            //inc
+            signingInfoResolved++;
+            
+            //when specified
+            // generate full code signing info
+            if(csNone != codeSigningOption)
             {
-                //save
-                if(NULL != message->event.exec.script)
+                //use cached signing info (if available)
+                cachedInfo = [executableCache find:&executableKey csFlags:self.csFlags.unsignedIntValue];
+                if(0 != cachedInfo.signingInfo.count)
                 {
-                    self.script = convertStringToken(&message->event.exec.script->path);
+                    signingInfo = [cachedInfo.signingInfo mutableCopy];
+                }
+                //otherwise generate
+                // and (re)cache executable info, now w/ signing info (if it's valid)
+                else
+                {
+                    [self generateCSInfo:codeSigningOption];
+                    if( (nil != signingInfo[KEY_SIGNATURE_STATUS]) &&
+                        (errSecSuccess == [signingInfo[KEY_SIGNATURE_STATUS] intValue]) )
+                    {
+                        [executableCache add:[self executableInfo] key:&executableKey];
+                    }
                 }
             }
         }
         
-        //no script, but this is an interpreter?
-        // try look up script manually, if ES didn't give us one
-        if( (!self.script.length) &&
-            (arguments.count >= 2) ) {
-            
-            if( (self.signingID) &&
-                ([interpreters containsObject:self.signingID]) ) {
-                
-                NSString* cwd = nil;
-                NSArray* scripts = nil;
-                
-                //grab CWD
-                if (message->version >= 3 && message->event.exec.cwd) {
-                    cwd = convertStringToken(&message->event.exec.cwd->path);
-                }
-            
-                //get via args
-                scripts = getScripts(pid, arguments, cwd);
-                
-                //for now just grab ...first?
-                self.script = scripts.firstObject;
-            }
+        //none?
+        if(nil == signingInfo)
+        {
+            //alloc
+            signingInfo = [NSMutableDictionary dictionary];
         }
+        
+        return signingInfo;
+    }
+}
+
+//resolve executable info
+// name, from cache or generated
+// note: caller must sync
+-(void)resolveExecutable
+{
+    //cached executable info
+    ExecutableInfo* cachedInfo = nil;
     
-        //enumerate ancestors
-        [self enumerateAncestors];
+    //already resolved?
+    if(YES == resolvedExecutable) return;
+    
+    //set
+    resolvedExecutable = YES;
+    
+    //inc
+    executablesResolved++;
+    
+    //attempt to find cached info for executable
+    // so will be same binary (though pid/args, etc will be different)
+    cachedInfo = [executableCache find:&executableKey csFlags:self.csFlags.unsignedIntValue];
+    
+    //generate
+    if(nil == cachedInfo)
+    {
+        //inc
+        executablesGenerated++;
         
-        //for EXEC events
-        // now, cache process
-        if ( (message->event_type == ES_EVENT_TYPE_AUTH_EXEC) ||
-             (message->event_type == ES_EVENT_TYPE_NOTIFY_EXEC) ) {
-            
-            if(!cachedProcess && inode.unsignedLongValue) {
-                [processesCache setObject:self forKey:inode];
-            }
-        }
+        //name
+        name = [self getName];
+        
+        //cache
+        [executableCache add:[self executableInfo] key:&executableKey];
+    }
+    //from cache
+    else
+    {
+        //name
+        name = cachedInfo.name;
     }
     
-    return self;
+    return;
+}
+
+//resolve script
+// from ES, or (for interpreters) via args
+// note: caller must sync
+-(void)resolveScript
+{
+    //scripts
+    NSArray* scripts = nil;
+    
+    //already resolved?
+    if(YES == resolvedScript) return;
+    
+    //set
+    resolvedScript = YES;
+    
+    //inc
+    scriptsResolved++;
+    
+    //from ES
+    script = execScript;
+    
+    //no script, but this is an (exec'd) interpreter?
+    // try look up script manually, if ES didn't give us one
+    if( (0 == script.length) &&
+        ((ES_EVENT_TYPE_AUTH_EXEC == self.event) || (ES_EVENT_TYPE_NOTIFY_EXEC == self.event)) &&
+        (self.arguments.count >= 2) &&
+        (nil != self.signingID) &&
+        (YES == [interpreters containsObject:self.signingID]) )
+    {
+        //inc
+        scriptLookups++;
+        
+        //get via args
+        scripts = getScripts(pid, self.arguments, execCWD);
+        
+        //for now just grab ...first?
+        script = scripts.firstObject;
+    }
+    
+    return;
 }
 
-//get's process' path
-// note: path must be set
--(unsigned long)inode
+//executable's info
+// i.e. what's the same for all processes of a binary
+// note: caller must sync
+-(ExecutableInfo*)executableInfo
 {
-    //stat
-    struct stat fileStat = {0};
+    //info
+    ExecutableInfo* info = nil;
+    
+    //resolve
+    // name
+    [self resolveExecutable];
     
-    //inode
-    unsigned long iNode = 0;
+    //init
+    info = [[ExecutableInfo alloc] init];
     
-    //stat
-    if(0 == stat(self.path.fileSystemRepresentation, &fileStat))
+    //add
+    info.name = name;
+    info.signingID = self.signingID;
+    info.teamID = self.teamID;
+    info.cdHash = self.cdHash;
+    info.csFlags = self.csFlags;
+    
+    //add signing info
+    // if generated, and valid (as an error may be transient, e.g. binary being replaced)
+    if( (nil != signingInfo[KEY_SIGNATURE_STATUS]) &&
+        (errSecSuccess == [signingInfo[KEY_SIGNATURE_STATUS] intValue]) )
     {
-        //save
-        iNode = fileStat.st_ino;
+        info.signingInfo = [signingInfo copy];
     }
-  
-    return iNode;
+    
+    return info;
 }
 
 //generate code signing info
 // sets 'signingInfo' iVar
+// note: (persisted) verdict for same cd hash/team id is used, if there is one
 -(void)generateCSInfo:(NSUInteger)csOption
 {
-    //generate via helper function
-    self.signingInfo = generateSigningInfo(self, csOption, kSecCSDefaultFlags);
+    //cached verdict
+    NSDictionary* verdict = nil;
+    
+    //start
+    uint64_t start = 0;
+    
+    //flag
+    // generated (vs. waited on)?
+    BOOL leader = NO;
+    
+    @synchronized(self)
+    {
+        //set
+        resolvedSigningInfo = YES;
+        
+        //check cache
+        verdict = [signingCache find:executableKey.cdHash teamID:self.teamID csFlags:self.csFlags.unsignedIntValue];
+        if(nil != verdict)
+        {
+            //use
+            signingInfo = [verdict mutableCopy];
+            
+            //done
+            return;
+        }
+        
+        //start
+        start = mach_absolute_time();
+        
+        //generate via helper function
+        // ...or wait on a (concurrent) check of same binary that's in flight
+        signingInfo = [signingFlights verify:executableKey.cdHash teamID:self.teamID option:csOption csFlags:self.csFlags.unsignedIntValue check:^NSMutableDictionary*
+        {
+            //generate
+            return generateSigningInfo(self, csOption, kSecCSDefaultFlags);
+            
+        } leader:&leader];
+        
+        //generated?
+        // (only) then, add to cache
+        if(YES == leader)
+        {
+            //inc
+            signingInfoGenerated++;
+            
+            //cache
+            [signingCache add:signingInfo cdHash:executableKey.cdHash teamID:self.teamID csFlags:self.csFlags.unsignedIntValue latency:machTimeToNanoseconds(mach_absolute_time() - start)];
+        }
+    }
     
     return;
 }
 
+//stats
+// processes created, and (per field) how many were resolved
+// note: prior to lazy resolution, every field was resolved for every process
++(NSDictionary*)stats
+{
+    //processes
+    uint64_t processes = processesCreated;
+    
+    return @{@"processes":@(processes),
+             @"executables resolved":@(executablesResolved),
+             @"executables resolved (%)":@(percentOf(executablesResolved, processes)),
+             @"executables generated (cache miss)":@(executablesGenerated),
+             @"architectures resolved":@(architecturesResolved),
+             @"ancestors resolved":@(ancestorsResolved),
+             @"ancestors resolved (%)":@(percentOf(ancestorsResolved, processes)),
+             @"scripts resolved":@(scriptsResolved),
+             @"scripts resolved (%)":@(percentOf(scriptsResolved, processes)),
+             @"script lookups":@(scriptLookups),
+             @"signing info resolved":@(signingInfoResolved),
+             @"signing info resolved (%)":@(percentOf(signingInfoResolved, processes)),
+             @"signing info generated":@(signingInfoGenerated),
+             @"sysctl calls":@(sysctlCalls),
+             @"sysctl calls per process":@((0 != processes) ? ((double)sysctlCalls / processes) : 0)};
+}
+
 //get process' name
 // either via app bundle, or path
 -(NSString*)getName
@@ -441,6 +723,9 @@ bail:
     //proc info
     struct kinfo_proc procInfo = {0};
     
+    //inc
+    sysctlCalls += 2;
+    
     //get mib for 'proc_cputype'
     if(noErr != sysctlnametomib("sysctl.proc_cputype", mib, &length))
     {
@@ -495,6 +780,9 @@ bail:
         //(re)set size
         size = sizeof(procInfo);
         
+        //inc
+        sysctlCalls++;
+        
         //get proc info
         if(noErr != sysctl(mib, (u_int)length, &procInfo, &size, NULL, 0))
         {
@@ -557,77 +845,31 @@ bail:
 }
 
 //generate list of ancestors
-// note: if possible, built off responsible pid (vs. parent)
+// via process tree, so no syscalls (and exited ancestors are included)
+// note: built off responsible pid (vs. parent), if possible; caller must sync
 -(void)enumerateAncestors
 {
-    //current process id
-    pid_t currentPID = -1;
+    //already resolved?
+    if(YES == resolvedAncestors) return;
     
-    //parent pid
-    pid_t parentPID = -1;
-
-    //have rpid (from ESF)
-    // init parent w/ that
-    if(0 != self.rpid)
-    {
-        parentPID = self.rpid;
-    }
-    //no rpid
-    // try lookup via private API
-    else if(NULL != getRPID)
-    {
-        //get rpid
-        parentPID = getRPID(pid);
-    }
+    //set
+    resolvedAncestors = YES;
     
-    //couldn't find/get rPID?
-    // default back to using ppid
-    if( (parentPID <= 0) ||
-        (self.pid == parentPID) )
-    {
-        //use ppid
-        parentPID = self.ppid;
-    }
+    //inc
+    ancestorsResolved++;
     
-    //add parent
-    [self.ancestors addObject:[NSNumber numberWithInt:parentPID]];
-        
-    //set current to parent
-    currentPID = parentPID;
+    //alloc
+    ancestors = [NSMutableArray array];
+    ancestorPaths = [NSMutableArray array];
     
-    //complete ancestry
-    while(YES)
+    //add each
+    for(ProcessNode* ancestor in [processTree ancestorsOfNode:node])
     {
-        //for parent
-        // first try via rPID
-        if(NULL != getRPID)
-        {
-            //get rpid
-            parentPID = getRPID(currentPID);
-        }
-        
-        //couldn't find/get rPID?
-        // default back to using standard method
-        if( (parentPID <= 0) ||
-            (currentPID == parentPID) )
-        {
-            //get parent pid
-            parentPID = getParentID(currentPID);
-        }
-        
-        //done?
-        if( (parentPID <= 0) ||
-            (currentPID == parentPID) )
-        {
-            //bail
-            break;
-        }
-        
-        //update
-        currentPID = parentPID;
+        //add pid
+        [ancestors addObject:[NSNumber numberWithInt:ancestor.pid]];
         
-        //add
-        [self.ancestors addObject:[NSNumber numberWithInt:parentPID]];
+        //add path
+        [ancestorPaths addObject:(nil != ancestor.path) ? ancestor.path : @""];
     }
     
     return;
@@ -0,0 +1,49 @@
+//
+//  ProcessTable.h
+//  FileMonitor
+//
+//  Created by Patrick Wardle
+//  Copyright © 2025 Objective-See. All rights reserved.
+//
+
+#ifndef ProcessTable_h
+#define ProcessTable_h
+
+#import <Foundation/Foundation.h>
+#import <EndpointSecurity/EndpointSecurity.h>
+
+@class Process;
+
+/* CONSTS */
+
+//default max number of processes
+// bounds memory, as processes that exit w/o an (ES) exit event are eventually evicted
+#define PROCESS_TABLE_MAX_ENTRIES 4096
+
+@interface ProcessTable : NSObject
+
+/* METHODS */
+
+//init
+// table is sized for max entries (at most half full)
+-(id _Nonnull)initWithMaxEntries:(NSUInteger)maxEntries;
+
+//find process
+// by (full) audit token, so a reused pid (or re-exec'd process) won't match
+-(Process* _Nullable)find:(const audit_token_t* _Nonnull)token;
+
+//add process
+// replaces any existing, evicting (via clock) if at max entries
+-(void)add:(Process* _Nonnull)process token:(const audit_token_t* _Nonnull)token;
+
+//remove process
+// e.g. on exit
+-(void)remove:(const audit_token_t* _Nonnull)token;
+
+//stats
+// occupancy, hit rate, evictions, etc
+-(NSDictionary* _Nonnull)stats;
+
+@end
+
+#endif /* ProcessTable_h */
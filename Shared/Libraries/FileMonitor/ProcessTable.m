@@ -0,0 +1,379 @@
+//
+//  ProcessTable.m
+//  FileMonitor
+//
+//  Created by Patrick Wardle
+//  Copyright © 2025 Objective-See. All rights reserved.
+//
+
+//  processes, by audit token. the table is open addressed (linear probing, w/ backward
+//  shift deletion, so no tombstones), hashed by versioned pid (pid + pid version), and
+//  keyed by the full (fixed size) audit token. entries are added on exec (or first sight)
+//  and removed on exit. as exits can be missed (e.g. muted processes), the table has a
+//  max number of entries: when reached, one is evicted via a clock (second chance) sweep
+
+@import OSLog;
+
+#import <os/lock.h>
+#import <bsm/libbsm.h>
+
+#import "FileMonitor.h"
+#import "ProcessTable.h"
+
+/* TYPEDEFS */
+
+//slot
+typedef struct
+{
+    //audit token
+    audit_token_t token;
+
+    //process
+    // retained, NULL if slot is empty
+    void* process;
+
+    //referenced (since last sweep)
+    uint32_t referenced;
+
+} ProcessTableSlot;
+
+@interface ProcessTable ()
+{
+    //lock
+    os_unfair_lock lock;
+
+    //slots
+    ProcessTableSlot* slots;
+
+    //number of slots
+    // power of two
+    NSUInteger capacity;
+
+    //max entries
+    NSUInteger maxEntries;
+
+    //entries
+    NSUInteger count;
+
+    //clock hand
+    NSUInteger hand;
+
+    //counters
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t removals;
+}
+
+@end
+
+@implementation ProcessTable
+
+//init
+// at least twice as many slots as (max) entries
+-(id)initWithMaxEntries:(NSUInteger)entries
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init
+        lock = OS_UNFAIR_LOCK_INIT;
+        maxEntries = MAX(entries, 1);
+
+        //init capacity
+        capacity = 2;
+        while(capacity < (2 * maxEntries)) capacity <<= 1;
+
+        //alloc
+        slots = calloc(capacity, sizeof(ProcessTableSlot));
+    }
+
+    return self;
+}
+
+//dealloc
+// release all processes, and free slots
+-(void)dealloc
+{
+    //release all
+    for(NSUInteger i = 0; i < capacity; i++)
+    {
+        //release
+        if(NULL != slots[i].process) CFRelease(slots[i].process);
+    }
+
+    //free
+    free(slots);
+
+    return;
+}
+
+//home slot
+// hash of versioned pid
+-(NSUInteger)home:(const audit_token_t*)token
+{
+    //versioned pid
+    uint64_t key = ((uint64_t)audit_token_to_pidversion(*token) << 32) | (uint32_t)audit_token_to_pid(*token);
+
+    //mix
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+
+    return (NSUInteger)key & (capacity - 1);
+}
+
+//find slot
+// returns NSNotFound if token isn't in table
+// note: caller must hold lock
+-(NSUInteger)slot:(const audit_token_t*)token
+{
+    //slot
+    NSUInteger slot = [self home:token];
+
+    //probe
+    // note: table is never full, so there's always an empty slot
+    while(NULL != slots[slot].process)
+    {
+        //match?
+        if(0 == memcmp(&slots[slot].token, token, sizeof(audit_token_t))) return slot;
+
+        //next
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    return NSNotFound;
+}
+
+//find process
+-(Process*)find:(const audit_token_t*)token
+{
+    //process
+    Process* process = nil;
+
+    //slot
+    NSUInteger slot = NSNotFound;
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //find
+    slot = [self slot:token];
+    if(NSNotFound != slot)
+    {
+        //grab (and retain)
+        process = (__bridge Process*)slots[slot].process;
+
+        //mark
+        slots[slot].referenced = 1;
+
+        //hit
+        hits++;
+    }
+    else
+    {
+        //miss
+        misses++;
+    }
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return process;
+}
+
+//add process
+-(void)add:(Process*)process token:(const audit_token_t*)token
+{
+    //slot
+    NSUInteger slot = NSNotFound;
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //existing?
+    // replace process
+    slot = [self slot:token];
+    if(NSNotFound != slot)
+    {
+        //release old
+        CFRelease(slots[slot].process);
+
+        //save
+        slots[slot].process = (void*)CFBridgingRetain(process);
+        slots[slot].referenced = 1;
+
+        //done
+        goto bail;
+    }
+
+    //at max?
+    // evict one
+    if(count >= maxEntries)
+    {
+        //evict
+        [self evict];
+    }
+
+    //find empty slot
+    slot = [self home:token];
+    while(NULL != slots[slot].process) slot = (slot + 1) & (capacity - 1);
+
+    //add
+    slots[slot].token = *token;
+    slots[slot].process = (void*)CFBridgingRetain(process);
+    slots[slot].referenced = 1;
+
+    //inc
+    count++;
+
+bail:
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return;
+}
+
+//remove process
+-(void)remove:(const audit_token_t*)token
+{
+    //slot
+    NSUInteger slot = NSNotFound;
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //find
+    slot = [self slot:token];
+    if(NSNotFound != slot)
+    {
+        //remove
+        [self removeSlot:slot];
+
+        //inc
+        removals++;
+    }
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return;
+}
+
+//evict an entry
+// clock sweep: skip (and clear) referenced entries, till an unreferenced one is found
+// note: caller must hold lock
+-(void)evict
+{
+    //sweep
+    // at most two passes, as first clears all referenced bits
+    while(0 != count)
+    {
+        //occupied?
+        if(NULL != slots[hand].process)
+        {
+            //unreferenced?
+            // evict
+            if(0 == slots[hand].referenced)
+            {
+                //remove
+                [self removeSlot:hand];
+
+                //inc
+                evictions++;
+
+                //done
+                break;
+            }
+
+            //clear
+            // i.e. second chance
+            slots[hand].referenced = 0;
+        }
+
+        //next
+        hand = (hand + 1) & (capacity - 1);
+    }
+
+    return;
+}
+
+//remove slot
+// then shift back any following entries that were displaced (so probing still finds them)
+// note: caller must hold lock
+-(void)removeSlot:(NSUInteger)slot
+{
+    //next slot
+    NSUInteger next = slot;
+
+    //release
+    CFRelease(slots[slot].process);
+    slots[slot].process = NULL;
+
+    //shift back
+    while(YES)
+    {
+        //home of next
+        NSUInteger home = 0;
+
+        //next
+        next = (next + 1) & (capacity - 1);
+
+        //empty?
+        // done
+        if(NULL == slots[next].process) break;
+
+        //home of next
+        home = [self home:&slots[next].token];
+
+        //home (cyclically) in (slot, next]?
+        // then it can't move to (empty) slot
+        if( (slot <= next) ? ((slot < home) && (home <= next)) : ((slot < home) || (home <= next)) ) continue;
+
+        //move
+        slots[slot] = slots[next];
+        slots[next].process = NULL;
+
+        //next empty
+        slot = next;
+    }
+
+    //clear
+    memset(&slots[slot], 0, sizeof(ProcessTableSlot));
+
+    //dec
+    count--;
+
+    return;
+}
+
+//stats
+// occupancy, hit rate, evictions, etc
+-(NSDictionary*)stats
+{
+    //stats
+    NSDictionary* stats = nil;
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //init
+    stats = @{@"entries":@(count),
+              @"max entries":@(maxEntries),
+              @"occupancy (%)":@((100 * count) / maxEntries),
+              @"memory (bytes)":@(capacity * sizeof(ProcessTableSlot)),
+              @"hits":@(hits),
+              @"misses":@(misses),
+              @"hit rate (%)":@((0 != hits + misses) ? ((100 * hits) / (hits + misses)) : 0),
+              @"evictions":@(evictions),
+              @"removals":@(removals)};
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return stats;
+}
+
+@end
@@ -0,0 +1,96 @@
+//
+//  ProcessTree.h
+//  FileMonitor
+//
+//  Created by Patrick Wardle
+//  Copyright © 2025 Objective-See. All rights reserved.
+//
+
+#ifndef ProcessTree_h
+#define ProcessTree_h
+
+#import <Foundation/Foundation.h>
+#import <EndpointSecurity/EndpointSecurity.h>
+
+/* CONSTS */
+
+//max depth
+// bounds walks, should links ever form a cycle
+#define PROCESS_TREE_MAX_DEPTH 128
+
+/* OBJECT: NODE */
+
+@interface ProcessNode : NSObject
+
+/* PROPERTIES */
+
+//pid
+@property pid_t pid;
+
+//pid version
+// from audit token, 0 if unknown (e.g. looked up via syscalls)
+@property int pidversion;
+
+//path
+@property(nonatomic, retain)NSString* _Nullable path;
+
+//exited
+@property BOOL exited;
+
+//parent
+// strong, so (exited) ancestors live as long as their descendants
+@property(nonatomic, retain)ProcessNode* _Nullable parent;
+
+//responsible process
+// nil if process is responsible for itself
+@property(nonatomic, retain)ProcessNode* _Nullable responsible;
+
+@end
+
+/* OBJECT: TREE */
+
+@interface ProcessTree : NSObject
+
+/* METHODS */
+
+//seed
+// w/ all running processes (via syscalls), so ancestors that predate monitoring are known
+-(void)seed;
+
+//update
+// from a fork, exec, or exit message
+-(void)update:(const es_message_t* _Nonnull)message;
+
+//fork
+// child inherits its parent's path (till it execs)
+-(void)fork:(pid_t)child pidversion:(int)pidversion parent:(pid_t)parent responsible:(pid_t)rpid;
+
+//exec
+// process' image (path), pid version, and responsible process change
+-(void)exec:(pid_t)pid pidversion:(int)pidversion parent:(pid_t)ppid responsible:(pid_t)rpid path:(NSString* _Nullable)path;
+
+//exit
+// node is kept (by descendants) as an exited ancestor
+// note: ignored if pid's node is of a newer process (i.e. pid was reused)
+-(void)exit:(pid_t)pid pidversion:(int)pidversion;
+
+//find (live) process' node
+// no syscalls unless process wasn't seen, or its node is stale (i.e. of a prior process w/ same pid)
+// pidversion: from process' audit token, or 0 to match any
+-(ProcessNode* _Nullable)find:(pid_t)pid pidversion:(int)pidversion;
+
+//ancestors
+// walks responsible (else parent) links, no syscalls unless process wasn't seen
+-(NSArray<ProcessNode*>* _Nonnull)ancestors:(pid_t)pid;
+
+//ancestors of node
+// e.g. one found earlier, as its process may have since exited
+-(NSArray<ProcessNode*>* _Nonnull)ancestorsOfNode:(ProcessNode* _Nullable)node;
+
+//stats
+// nodes, events, queries, and lookups (via syscalls)
+-(NSDictionary* _Nonnull)stats;
+
+@end
+
+#endif /* ProcessTree_h */
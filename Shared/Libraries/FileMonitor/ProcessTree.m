@@ -0,0 +1,677 @@
+//
+//  ProcessTree.m
+//  FileMonitor
+//
+//  Created by Patrick Wardle
+//  Copyright © 2025 Objective-See. All rights reserved.
+//
+
+//  process ancestry, maintained from fork/exec/exit events (vs. walking up to launchd via
+//  responsibility/sysctl calls for each new process). live processes are tracked by pid,
+//  while each node holds (strong) links to its parent and responsible process. as such, an
+//  ancestor that has exited (or whose pid has since been reused) is still reachable, w/ its
+//  path, for as long as any of its descendants are. once they've all exited, it's freed.
+//
+//  nodes are only created via syscalls for processes that weren't seen (e.g. that predate
+//  monitoring, or whose fork was missed). everything else is answered from the tree.
+//
+//  as (file and process) events come from different ES clients, the tree may lag (or lead) a
+//  file event's process. so nodes record their pid version (from the audit token), and a node
+//  of a different process w/ the same pid is never returned, nor removed by the other's exit.
+//
+//  events are plain (pid, pid version, path) tuples, so a tree can also be fed a synthetic stream
+
+@import OSLog;
+
+#import <os/lock.h>
+#import <libproc.h>
+#import <bsm/libbsm.h>
+
+#import "utilities.h"
+#import "ProcessTree.h"
+
+/* GLOBALS */
+
+//responsbile pid
+extern pid_t (*getRPID)(pid_t pid);
+
+/* FUNCTIONS */
+
+//helper function
+// get parent of arbitrary process
+pid_t getParentID(pid_t child);
+
+@implementation ProcessNode
+
+@synthesize pid;
+@synthesize path;
+@synthesize pidversion;
+@synthesize exited;
+@synthesize parent;
+@synthesize responsible;
+
+@end
+
+@interface ProcessTree ()
+{
+    //lock
+    os_unfair_lock lock;
+
+    //counters
+    uint64_t forks;
+    uint64_t execs;
+    uint64_t exits;
+    uint64_t queries;
+    uint64_t lookups;
+    uint64_t stale;
+}
+
+//live processes
+// key: pid
+@property(nonatomic, retain)NSMutableDictionary<NSNumber*, ProcessNode*>* nodes;
+
+@end
+
+@implementation ProcessTree
+
+@synthesize nodes;
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init
+        lock = OS_UNFAIR_LOCK_INIT;
+
+        //alloc
+        nodes = [NSMutableDictionary dictionary];
+    }
+
+    return self;
+}
+
+//seed
+// w/ all running processes
+-(void)seed
+{
+    //number of pids
+    int count = 0;
+
+    //pids
+    pid_t* pids = NULL;
+
+    //(all) pids
+    NSMutableArray<NSNumber*>* all = nil;
+
+    //(looked up) process infos
+    NSDictionary* infos = nil;
+
+    //get number of pids
+    count = proc_listallpids(NULL, 0);
+    if(count <= 0)
+    {
+        //bail
+        goto bail;
+    }
+
+    //alloc
+    // w/ some slack, as processes may be spawned in between
+    pids = calloc((size_t)count * 2, sizeof(pid_t));
+    if(NULL == pids)
+    {
+        //bail
+        goto bail;
+    }
+
+    //get pids
+    count = proc_listallpids(pids, count * 2 * (int)sizeof(pid_t));
+
+    //init
+    all = [NSMutableArray array];
+    for(int i = 0; i < count; i++)
+    {
+        //add
+        [all addObject:@(pids[i])];
+    }
+
+    //look up each
+    // via syscalls, outside lock
+    infos = [self lookup:all];
+
+    //add each
+    // note: parents are added too (if not already)
+    // lock per process, so (ES) handlers aren't stalled behind all of them
+    for(int i = 0; i < count; i++)
+    {
+        //lock
+        os_unfair_lock_lock(&lock);
+
+        //add
+        [self node:pids[i] infos:infos];
+
+        //unlock
+        os_unfair_lock_unlock(&lock);
+    }
+
+bail:
+
+    //free
+    if(NULL != pids) free(pids);
+
+    return;
+}
+
+//update
+// from a fork, exec, or exit message
+-(void)update:(const es_message_t*)message
+{
+    //responsible pid
+    // only in newer messages
+    pid_t rpid = 0;
+
+    //process
+    const es_process_t* process = NULL;
+
+    switch(message->event_type)
+    {
+        //fork
+        case ES_EVENT_TYPE_NOTIFY_FORK:
+
+            //child
+            process = message->event.fork.child;
+
+            //rpid
+            if(message->version >= 4) rpid = audit_token_to_pid(process->responsible_audit_token);
+
+            //fork
+            [self fork:audit_token_to_pid(process->audit_token) pidversion:audit_token_to_pidversion(process->audit_token) parent:process->ppid responsible:rpid];
+
+            break;
+
+        //exec
+        case ES_EVENT_TYPE_NOTIFY_EXEC:
+
+            //target
+            process = message->event.exec.target;
+
+            //rpid
+            if(message->version >= 4) rpid = audit_token_to_pid(process->responsible_audit_token);
+
+            //exec
+            [self exec:audit_token_to_pid(process->audit_token) pidversion:audit_token_to_pidversion(process->audit_token) parent:process->ppid responsible:rpid path:convertStringToken(&process->executable->path)];
+
+            break;
+
+        //exit
+        case ES_EVENT_TYPE_NOTIFY_EXIT:
+
+            //exit
+            [self exit:audit_token_to_pid(message->process->audit_token) pidversion:audit_token_to_pidversion(message->process->audit_token)];
+
+            break;
+
+        default:
+            break;
+    }
+
+    return;
+}
+
+//fork
+// child starts w/ parent's image
+-(void)fork:(pid_t)child pidversion:(int)pidversion parent:(pid_t)ppid responsible:(pid_t)rpid
+{
+    //node
+    ProcessNode* node = nil;
+
+    //(looked up) process infos
+    NSDictionary* infos = nil;
+
+    //look up (any unknown) parent/responsible
+    // via syscalls, outside lock
+    infos = [self lookup:@[@(ppid), @(rpid)]];
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //init
+    // note: replaces any (stale) node w/ same pid
+    node = [[ProcessNode alloc] init];
+    node.pid = child;
+    node.pidversion = pidversion;
+
+    //link parent
+    node.parent = [self node:ppid infos:infos];
+
+    //inherit path
+    node.path = node.parent.path;
+
+    //link responsible
+    [self link:node responsible:rpid infos:infos];
+
+    //add
+    self.nodes[@(child)] = node;
+
+    //inc
+    forks++;
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return;
+}
+
+//exec
+// image (path) and responsible process change
+-(void)exec:(pid_t)pid pidversion:(int)pidversion parent:(pid_t)ppid responsible:(pid_t)rpid path:(NSString*)path
+{
+    //node
+    ProcessNode* node = nil;
+
+    //(looked up) process infos
+    NSDictionary* infos = nil;
+
+    //look up (any unknown) parent/responsible
+    // via syscalls, outside lock
+    infos = [self lookup:@[@(ppid), @(rpid)]];
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //existing?
+    node = self.nodes[@(pid)];
+    if(nil == node)
+    {
+        //init
+        node = [[ProcessNode alloc] init];
+        node.pid = pid;
+
+        //link parent
+        node.parent = [self node:ppid infos:infos];
+
+        //add
+        self.nodes[@(pid)] = node;
+    }
+
+    //update path
+    // and pid version, as it changes on exec
+    node.path = path;
+    node.pidversion = pidversion;
+
+    //(re)link responsible
+    [self link:node responsible:rpid infos:infos];
+
+    //inc
+    execs++;
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return;
+}
+
+//exit
+// remove from live processes
+// note: node lives on (as exited ancestor) while referenced by any descendants
+-(void)exit:(pid_t)pid pidversion:(int)pidversion
+{
+    //node
+    ProcessNode* node = nil;
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //inc
+    exits++;
+
+    //get
+    node = self.nodes[@(pid)];
+
+    //newer process (w/ same pid)?
+    // i.e. its fork was seen before this exit, so leave it be
+    if( (0 != node.pidversion) &&
+        (0 != pidversion) &&
+        (node.pidversion > pidversion) )
+    {
+        //inc
+        stale++;
+
+        //unlock
+        os_unfair_lock_unlock(&lock);
+
+        return;
+    }
+
+    //mark
+    node.exited = YES;
+
+    //remove
+    [self.nodes removeObjectForKey:@(pid)];
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return;
+}
+
+//find (live) process' node
+// checking its pid version, so a (stale) node of another process w/ the same pid isn't used
+-(ProcessNode*)find:(pid_t)pid pidversion:(int)pidversion
+{
+    //node
+    ProcessNode* node = nil;
+
+    //(looked up) process infos
+    NSDictionary* infos = nil;
+
+    //look up (if unknown)
+    // via syscalls, outside lock
+    infos = [self lookup:@[@(pid)]];
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //find
+    node = [self node:pid infos:infos];
+
+    //different process (w/ same pid)?
+    if( (nil != node) &&
+        (0 != node.pidversion) &&
+        (0 != pidversion) &&
+        (node.pidversion != pidversion) )
+    {
+        //inc
+        stale++;
+
+        //newer?
+        // i.e. process has exited (and its pid reused), so has no node
+        if(node.pidversion > pidversion)
+        {
+            //unset
+            node = nil;
+        }
+        //older?
+        // i.e. its exit (and this process' fork/exec) weren't seen yet, so remove it
+        else
+        {
+            //mark
+            node.exited = YES;
+
+            //remove
+            [self.nodes removeObjectForKey:@(pid)];
+
+            //unset
+            node = nil;
+
+            //unlock
+            os_unfair_lock_unlock(&lock);
+
+            //look up (again)
+            // via syscalls, outside lock
+            infos = [self lookup:@[@(pid)]];
+
+            //lock
+            os_unfair_lock_lock(&lock);
+
+            //create
+            // note: may race w/ process' fork/exec, which will then replace/update it
+            node = [self node:pid infos:infos];
+            if( (nil != node) &&
+                (0 == node.pidversion) )
+            {
+                //set
+                node.pidversion = pidversion;
+            }
+        }
+    }
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return node;
+}
+
+//ancestors
+-(NSArray<ProcessNode*>*)ancestors:(pid_t)pid
+{
+    return [self ancestorsOfNode:[self find:pid pidversion:0]];
+}
+
+//ancestors of node
+// walks up responsible (else parent) links
+-(NSArray<ProcessNode*>*)ancestorsOfNode:(ProcessNode*)node
+{
+    //ancestors
+    NSMutableArray* ancestors = nil;
+
+    //current node
+    ProcessNode* current = node;
+
+    //alloc
+    ancestors = [NSMutableArray array];
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //inc
+    queries++;
+
+    //walk up
+    while(ancestors.count < PROCESS_TREE_MAX_DEPTH)
+    {
+        //next
+        // prefer responsible
+        current = (nil != current.responsible) ? current.responsible : current.parent;
+        if(nil == current)
+        {
+            //done
+            break;
+        }
+
+        //add
+        [ancestors addObject:current];
+    }
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return ancestors;
+}
+
+//look up (unknown) processes
+// via syscalls, along w/ their (unknown) parents and responsible processes
+// note: caller must NOT hold lock, as that'd stall all (ES) handlers behind the syscalls
+-(NSDictionary<NSNumber*, NSDictionary*>*)lookup:(NSArray<NSNumber*>*)pids
+{
+    //infos
+    // key: pid, value: @{path, ppid, rpid}
+    NSMutableDictionary<NSNumber*, NSDictionary*>* infos = nil;
+
+    //pending pids
+    NSMutableArray<NSNumber*>* pending = nil;
+
+    //pid
+    pid_t pid = 0;
+
+    //parent pid
+    pid_t ppid = -1;
+
+    //responsible pid
+    pid_t rpid = 0;
+
+    //path
+    NSString* path = nil;
+
+    //flag
+    BOOL known = NO;
+
+    //alloc
+    infos = [NSMutableDictionary dictionary];
+    pending = [pids mutableCopy];
+
+    //look up each
+    while(0 != pending.count)
+    {
+        //next
+        pid = pending.lastObject.intValue;
+        [pending removeLastObject];
+
+        //none, or already looked up?
+        if( (pid <= 0) ||
+            (nil != infos[@(pid)]) )
+        {
+            //skip
+            continue;
+        }
+
+        //known?
+        os_unfair_lock_lock(&lock);
+        known = (nil != self.nodes[@(pid)]);
+        os_unfair_lock_unlock(&lock);
+        if(YES == known) continue;
+
+        //get path, parent, and responsible process
+        path = getProcessPath(pid);
+        ppid = getParentID(pid);
+        rpid = (NULL != getRPID) ? getRPID(pid) : 0;
+
+        //save
+        infos[@(pid)] = @{@"path":(nil != path) ? path : [NSNull null], @"ppid":@(ppid), @"rpid":@(rpid)};
+
+        //look up parent/responsible too
+        if(pid != ppid) [pending addObject:@(ppid)];
+        if(pid != rpid) [pending addObject:@(rpid)];
+    }
+
+    return infos;
+}
+
+//get node for (live) process
+// not found? create from (looked up) infos, along w/ its parents
+// note: caller must hold lock
+-(ProcessNode*)node:(pid_t)pid infos:(NSDictionary<NSNumber*, NSDictionary*>*)infos
+{
+    //node
+    ProcessNode* node = nil;
+
+    //info
+    NSDictionary* info = nil;
+
+    //parent pid
+    pid_t ppid = -1;
+
+    //none?
+    // e.g. launchd's parent
+    if(pid <= 0) return nil;
+
+    //existing?
+    node = self.nodes[@(pid)];
+    if(nil != node) return node;
+
+    //not looked up?
+    // e.g. (was) known, but exited since
+    info = infos[@(pid)];
+    if(nil == info) return nil;
+
+    //init
+    node = [[ProcessNode alloc] init];
+    node.pid = pid;
+    node.path = (YES == [info[@"path"] isKindOfClass:[NSString class]]) ? info[@"path"] : nil;
+
+    //add
+    // before linking, so lookups up the chain terminate
+    self.nodes[@(pid)] = node;
+
+    //inc
+    lookups++;
+
+    //link parent
+    ppid = [info[@"ppid"] intValue];
+    if(pid != ppid)
+    {
+        //link
+        node.parent = [self node:ppid infos:infos];
+    }
+
+    //link responsible
+    [self link:node responsible:[info[@"rpid"] intValue] infos:infos];
+
+    return node;
+}
+
+//link responsible process
+// ignored if process is its own (or if it would create a cycle)
+// note: caller must hold lock
+-(void)link:(ProcessNode*)node responsible:(pid_t)rpid infos:(NSDictionary<NSNumber*, NSDictionary*>*)infos
+{
+    //responsible
+    ProcessNode* responsible = nil;
+
+    //current
+    ProcessNode* current = nil;
+
+    //depth
+    NSUInteger depth = 0;
+
+    //unset
+    node.responsible = nil;
+
+    //self (or none)?
+    if( (rpid <= 0) ||
+        (rpid == node.pid) )
+    {
+        //done
+        return;
+    }
+
+    //get
+    responsible = [self node:rpid infos:infos];
+
+    //check for cycle
+    // i.e. responsible process descends from node
+    current = responsible;
+    while( (nil != current) &&
+           (depth++ < PROCESS_TREE_MAX_DEPTH) )
+    {
+        //cycle?
+        if(current == node) return;
+
+        //next
+        current = (nil != current.responsible) ? current.responsible : current.parent;
+    }
+
+    //link
+    node.responsible = responsible;
+
+    return;
+}
+
+//stats
+// nodes, events, queries, and lookups (via syscalls)
+-(NSDictionary*)stats
+{
+    //stats
+    NSDictionary* stats = nil;
+
+    //lock
+    os_unfair_lock_lock(&lock);
+
+    //init
+    stats = @{@"live processes":@(self.nodes.count),
+              @"forks":@(forks),
+              @"execs":@(execs),
+              @"exits":@(exits),
+              @"queries":@(queries),
+              @"lookups (syscalls)":@(lookups),
+              @"stale (pid reused)":@(stale)};
+
+    //unlock
+    os_unfair_lock_unlock(&lock);
+
+    return stats;
+}
+
+@end
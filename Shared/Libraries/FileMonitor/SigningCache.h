@@ -0,0 +1,58 @@
+//
+//  SigningCache.h
+//  FileMonitor
+//
+//  Created by Patrick Wardle
+//  Copyright © 2025 Objective-See. All rights reserved.
+//
+
+#ifndef SigningCache_h
+#define SigningCache_h
+
+#import <Foundation/Foundation.h>
+#import <EndpointSecurity/EndpointSecurity.h>
+
+/* CONSTS */
+
+//max number of verdicts
+#define SIGNING_CACHE_MAX_ENTRIES 4096
+
+//time to live (seconds)
+// so e.g. a revoked (notarization) ticket is eventually picked up
+#define SIGNING_CACHE_TTL (24 * 60 * 60)
+
+//allowed clock skew (seconds)
+// verdicts timestamped further in the future are dropped
+#define SIGNING_CACHE_CLOCK_SKEW (5 * 60)
+
+//delay before saving (seconds)
+// so bursts of new verdicts are written once
+#define SIGNING_CACHE_SAVE_DELAY 30
+
+@interface SigningCache : NSObject
+
+/* METHODS */
+
+//init
+// loads (persisted) verdicts from file, dropping any that have expired
+-(id _Nonnull)initWithFile:(NSString* _Nonnull)path;
+
+//find verdict (signing info)
+// keyed by cd hash and team id, and only for (kernel) validated code w/ same cs flags
+-(NSDictionary* _Nullable)find:(const uint8_t* _Nonnull)cdHash teamID:(NSString* _Nullable)teamID csFlags:(uint32_t)csFlags;
+
+//add verdict (signing info)
+// only successful verdicts are cached; latency is that of generating it (i.e. a miss)
+-(void)add:(NSDictionary* _Nonnull)signingInfo cdHash:(const uint8_t* _Nonnull)cdHash teamID:(NSString* _Nullable)teamID csFlags:(uint32_t)csFlags latency:(uint64_t)latency;
+
+//save
+// now, if there are unsaved verdicts
+-(BOOL)save;
+
+//stats
+// entries, hits/misses, and their (avg) latency
+-(NSDictionary* _Nonnull)stats;
+
+@end
+
+#endif /* SigningCache_h */
@@ -0,0 +1,514 @@
+//
+//  SigningCache.m
+//  FileMonitor
+//
+//  Created by Patrick Wardle
+//  Copyright © 2025 Objective-See. All rights reserved.
+//
+
+//  code signing verdicts (signing info), keyed by cd hash and team id, so the (expensive)
+//  dynamic/notarization checks are done once per binary, vs. once per exec. verdicts are
+//  persisted (as a binary plist), so they survive restarts and clearing of the ES cache.
+//
+//  invalidation:
+//   - only successful verdicts are cached (so e.g. a process that exited is re-checked)
+//   - only used for code the kernel validated (CS_VALID), w/ the same cs flags as when cached
+//   - verdicts expire after a day, so e.g. a revoked notarization ticket is picked up
+//   - a file w/ a different (format) version is ignored
+
+@import OSLog;
+
+#import <mach/mach_time.h>
+
+#import "signing.h"
+#import "utilities.h"
+#import "SigningCache.h"
+
+/* CONSTS */
+
+//format version
+#define SIGNING_CACHE_VERSION 1
+
+//keys
+#define KEY_CACHE_VERSION @"version"
+#define KEY_CACHE_ENTRIES @"entries"
+#define KEY_CACHE_CD_HASH @"cdHash"
+#define KEY_CACHE_TEAM_ID @"teamID"
+#define KEY_CACHE_CS_FLAGS @"csFlags"
+#define KEY_CACHE_TIMESTAMP @"timestamp"
+#define KEY_CACHE_SIGNING_INFO @"signingInfo"
+
+//code is valid
+// from: cs_blobs.h
+#define CS_VALID 0x00000001
+
+//hash length
+// from: cs_blobs.h
+#define CS_CDHASH_LEN 20
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+/* FUNCTIONS */
+
+//is (cached) verdict valid?
+// each field is of expected type, and it's neither expired, nor (too far) in the future
+static BOOL isValidEntry(id entry, double now);
+
+@interface SigningCache ()
+{
+    //unsaved verdicts?
+    BOOL dirty;
+
+    //save scheduled?
+    BOOL saveScheduled;
+
+    //counters
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t expired;
+    uint64_t invalidated;
+
+    //latency (nanoseconds)
+    uint64_t hitLatency;
+    uint64_t missLatency;
+}
+
+//file
+@property(nonatomic, retain)NSString* path;
+
+//verdicts
+// key: cd hash + team id
+@property(nonatomic, retain)NSMutableDictionary<NSData*, NSDictionary*>* entries;
+
+//queue
+// for (delayed) saves
+@property(nonatomic, retain)dispatch_queue_t queue;
+
+@end
+
+@implementation SigningCache
+
+@synthesize path;
+@synthesize queue;
+@synthesize entries;
+
+//init
+// load verdicts from file
+-(id)initWithFile:(NSString*)file
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //save
+        path = file;
+
+        //alloc
+        entries = [NSMutableDictionary dictionary];
+
+        //init queue
+        queue = dispatch_queue_create("com.objective-see.blockblock.signingCache", DISPATCH_QUEUE_SERIAL);
+
+        //load
+        [self load];
+    }
+
+    return self;
+}
+
+//key
+// cd hash + team id
+-(NSData*)key:(const uint8_t*)cdHash teamID:(NSString*)teamID
+{
+    //key
+    NSMutableData* key = nil;
+
+    //init w/ cd hash
+    key = [NSMutableData dataWithBytes:cdHash length:CS_CDHASH_LEN];
+
+    //add team id
+    if(0 != teamID.length)
+    {
+        //add
+        [key appendData:[teamID dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    return key;
+}
+
+//find verdict
+-(NSDictionary*)find:(const uint8_t*)cdHash teamID:(NSString*)teamID csFlags:(uint32_t)csFlags
+{
+    //signing info
+    NSDictionary* signingInfo = nil;
+
+    //entry
+    NSDictionary* entry = nil;
+
+    //start
+    uint64_t start = mach_absolute_time();
+
+    //key
+    NSData* key = nil;
+
+    //not (kernel) validated?
+    // can't rely on a cached verdict
+    if(CS_VALID != (csFlags & CS_VALID)) return nil;
+
+    //init key
+    key = [self key:cdHash teamID:teamID];
+
+    //sync
+    @synchronized(self)
+    {
+        //find
+        entry = self.entries[key];
+        if(nil == entry)
+        {
+            //bail
+            goto bail;
+        }
+
+        //expired (or invalid)?
+        if(YES != isValidEntry(entry, [NSDate.date timeIntervalSince1970]))
+        {
+            //remove
+            [self.entries removeObjectForKey:key];
+
+            //inc
+            expired++;
+
+            //unsaved
+            [self scheduleSave];
+
+            //bail
+            goto bail;
+        }
+
+        //cs flags changed?
+        if([entry[KEY_CACHE_CS_FLAGS] unsignedIntValue] != csFlags)
+        {
+            //remove
+            [self.entries removeObjectForKey:key];
+
+            //inc
+            invalidated++;
+
+            //unsaved
+            [self scheduleSave];
+
+            //bail
+            goto bail;
+        }
+
+        //hit
+        signingInfo = entry[KEY_CACHE_SIGNING_INFO];
+
+        //inc
+        hits++;
+        hitLatency += machTimeToNanoseconds(mach_absolute_time() - start);
+    }
+
+bail:
+
+    return signingInfo;
+}
+
+//add verdict
+-(void)add:(NSDictionary*)signingInfo cdHash:(const uint8_t*)cdHash teamID:(NSString*)teamID csFlags:(uint32_t)csFlags latency:(uint64_t)latency
+{
+    //key
+    NSData* key = nil;
+
+    //sync
+    @synchronized(self)
+    {
+        //(generating it was) a miss
+        misses++;
+        missLatency += latency;
+    }
+
+    //not (kernel) validated, or unsuccessful?
+    // don't cache, as it can't be relied on
+    if( (CS_VALID != (csFlags & CS_VALID)) ||
+        (errSecSuccess != [signingInfo[KEY_SIGNATURE_STATUS] intValue]) )
+    {
+        //bail
+        return;
+    }
+
+    //init key
+    key = [self key:cdHash teamID:teamID];
+
+    //sync
+    @synchronized(self)
+    {
+        //at max?
+        // evict oldest
+        if( (nil == self.entries[key]) &&
+            (self.entries.count >= SIGNING_CACHE_MAX_ENTRIES) )
+        {
+            //evict
+            [self evict];
+        }
+
+        //add
+        self.entries[key] = @{KEY_CACHE_CD_HASH:[NSData dataWithBytes:cdHash length:CS_CDHASH_LEN],
+                              KEY_CACHE_TEAM_ID:(nil != teamID) ? teamID : @"",
+                              KEY_CACHE_CS_FLAGS:@(csFlags),
+                              KEY_CACHE_TIMESTAMP:@([NSDate.date timeIntervalSince1970]),
+                              KEY_CACHE_SIGNING_INFO:[signingInfo copy]};
+
+        //unsaved
+        [self scheduleSave];
+    }
+
+    return;
+}
+
+//evict oldest verdict
+// note: caller must sync
+-(void)evict
+{
+    //oldest
+    __block NSData* oldest = nil;
+
+    //oldest's timestamp
+    __block double timestamp = DBL_MAX;
+
+    //find oldest
+    [self.entries enumerateKeysAndObjectsUsingBlock:^(NSData* key, NSDictionary* entry, BOOL* stop)
+    {
+        //older?
+        if([entry[KEY_CACHE_TIMESTAMP] doubleValue] < timestamp)
+        {
+            //save
+            oldest = key;
+            timestamp = [entry[KEY_CACHE_TIMESTAMP] doubleValue];
+        }
+    }];
+
+    //remove
+    if(nil != oldest) [self.entries removeObjectForKey:oldest];
+
+    return;
+}
+
+//schedule (delayed) save
+// note: caller must sync
+-(void)scheduleSave
+{
+    //set
+    dirty = YES;
+
+    //already scheduled?
+    if(YES == saveScheduled) return;
+
+    //set
+    saveScheduled = YES;
+
+    //save (later)
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, SIGNING_CACHE_SAVE_DELAY * NSEC_PER_SEC), self.queue, ^{
+
+        //save
+        [self save];
+    });
+
+    return;
+}
+
+//load verdicts
+// dropping any that have expired
+-(void)load
+{
+    //data
+    NSData* data = nil;
+
+    //cache
+    NSDictionary* cache = nil;
+
+    //error
+    NSError* error = nil;
+
+    //now
+    double now = [NSDate.date timeIntervalSince1970];
+
+    //load
+    data = [NSData dataWithContentsOfFile:self.path];
+    if(nil == data)
+    {
+        //bail
+        goto bail;
+    }
+
+    //deserialize
+    cache = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:&error];
+    if( (YES != [cache isKindOfClass:[NSDictionary class]]) ||
+        (SIGNING_CACHE_VERSION != [cache[KEY_CACHE_VERSION] intValue]) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: ignoring (invalid) signing cache %{public}@ (error: %{public}@)", self.path, error);
+
+        //bail
+        goto bail;
+    }
+
+    //invalid entries?
+    if(YES != [cache[KEY_CACHE_ENTRIES] isKindOfClass:[NSArray class]])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: ignoring (invalid) signing cache %{public}@ (no entries)", self.path);
+
+        //bail
+        goto bail;
+    }
+
+    //add each
+    for(NSDictionary* entry in cache[KEY_CACHE_ENTRIES])
+    {
+        //invalid or expired?
+        if(YES != isValidEntry(entry, now))
+        {
+            //skip
+            continue;
+        }
+
+        //add
+        self.entries[[self key:[entry[KEY_CACHE_CD_HASH] bytes] teamID:entry[KEY_CACHE_TEAM_ID]]] = entry;
+    }
+
+    //dbg msg
+    os_log_debug(logHandle, "loaded %lu signing verdict(s) from %{public}@", (unsigned long)self.entries.count, self.path);
+
+bail:
+
+    return;
+}
+
+//save
+// as binary plist, atomically
+-(BOOL)save
+{
+    //flag
+    BOOL saved = NO;
+
+    //cache
+    NSDictionary* cache = nil;
+
+    //data
+    NSData* data = nil;
+
+    //error
+    NSError* error = nil;
+
+    //sync
+    @synchronized(self)
+    {
+        //unset
+        saveScheduled = NO;
+
+        //nothing to save?
+        if(YES != dirty) return YES;
+
+        //unset
+        dirty = NO;
+
+        //init
+        cache = @{KEY_CACHE_VERSION:@(SIGNING_CACHE_VERSION), KEY_CACHE_ENTRIES:self.entries.allValues};
+    }
+
+    //serialize
+    data = [NSPropertyListSerialization dataWithPropertyList:cache format:NSPropertyListBinaryFormat_v1_0 options:0 error:&error];
+    if(nil == data)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to serialize signing cache (error: %{public}@)", error);
+
+        //bail
+        goto bail;
+    }
+
+    //save
+    if(YES != [data writeToFile:self.path options:NSDataWritingAtomic error:&error])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to save signing cache to %{public}@ (error: %{public}@)", self.path, error);
+
+        //bail
+        goto bail;
+    }
+
+    //happy
+    saved = YES;
+
+bail:
+
+    return saved;
+}
+
+//stats
+// entries, hits/misses, and their (avg) latency
+-(NSDictionary*)stats
+{
+    //sync
+    @synchronized(self)
+    {
+        return @{@"entries":@(self.entries.count),
+                 @"hits":@(hits),
+                 @"misses":@(misses),
+                 @"expired":@(expired),
+                 @"invalidated":@(invalidated),
+                 @"hit latency (avg, ns)":@((0 != hits) ? (hitLatency / hits) : 0),
+                 @"miss latency (avg, us)":@((0 != misses) ? (missLatency / misses / NSEC_PER_USEC) : 0)};
+    }
+}
+
+@end
+
+//is (cached) verdict valid?
+// as cache file could be modified, check each field's type (and cd hash's length), then its age
+static BOOL isValidEntry(id entry, double now)
+{
+    //timestamp
+    double timestamp = 0;
+
+    //not a dictionary?
+    if(YES != [entry isKindOfClass:[NSDictionary class]]) return NO;
+
+    //check types
+    if( (YES != [entry[KEY_CACHE_TIMESTAMP] isKindOfClass:[NSNumber class]]) ||
+        (YES != [entry[KEY_CACHE_TEAM_ID] isKindOfClass:[NSString class]]) ||
+        (YES != [entry[KEY_CACHE_CS_FLAGS] isKindOfClass:[NSNumber class]]) ||
+        (YES != [entry[KEY_CACHE_CD_HASH] isKindOfClass:[NSData class]]) ||
+        (YES != [entry[KEY_CACHE_SIGNING_INFO] isKindOfClass:[NSDictionary class]]) )
+    {
+        return NO;
+    }
+
+    //check cd hash
+    if(CS_CDHASH_LEN != [entry[KEY_CACHE_CD_HASH] length]) return NO;
+
+    //check status
+    // only successful verdicts are cached
+    if( (YES != [entry[KEY_CACHE_SIGNING_INFO][KEY_SIGNATURE_STATUS] isKindOfClass:[NSNumber class]]) ||
+        (errSecSuccess != [entry[KEY_CACHE_SIGNING_INFO][KEY_SIGNATURE_STATUS] intValue]) )
+    {
+        return NO;
+    }
+
+    //timestamp
+    timestamp = [entry[KEY_CACHE_TIMESTAMP] doubleValue];
+
+    //expired?
+    // or in the future (i.e. would never expire)
+    if( (now - timestamp >= SIGNING_CACHE_TTL) ||
+        (timestamp > now + SIGNING_CACHE_CLOCK_SKEW) )
+    {
+        return NO;
+    }
+
+    return YES;
+}
@@ -0,0 +1,39 @@
+//
+//  SigningFlights.h
+//  FileMonitor
+//
+//  Created by Patrick Wardle
+//  Copyright © 2025 Objective-See. All rights reserved.
+//
+
+#ifndef SigningFlights_h
+#define SigningFlights_h
+
+#import <Foundation/Foundation.h>
+
+/* TYPEDEFS */
+
+//code signing check
+// returns signing info
+typedef NSMutableDictionary* _Nonnull (^SigningCheckBlock)(void);
+
+@interface SigningFlights : NSObject
+
+/* METHODS */
+
+//init
+// max number of checks that run at once (e.g. number of cores)
+-(id _Nonnull)initWithWorkers:(NSUInteger)workers;
+
+//verify
+// first caller (for a cd hash, team id, and option) runs the check, concurrent callers wait for (a copy of) its result
+// note: only coalesces (kernel) validated code w/ a cd hash, otherwise just runs the check
+-(NSMutableDictionary* _Nonnull)verify:(const uint8_t* _Nonnull)cdHash teamID:(NSString* _Nullable)teamID option:(NSUInteger)option csFlags:(uint32_t)csFlags check:(SigningCheckBlock _Nonnull)check leader:(BOOL* _Nullable)leader;
+
+//stats
+// checks, coalesced waiters, and waits for a worker
+-(NSDictionary* _Nonnull)stats;
+
+@end
+
+#endif /* SigningFlights_h */
@@ -0,0 +1,327 @@
+//
+//  SigningFlights.m
+//  FileMonitor
+//
+//  Created by Patrick Wardle
+//  Copyright © 2025 Objective-See. All rights reserved.
+//
+
+//  in-flight code signing checks, keyed by cd hash, team id, and option. when many copies
+//  of the same binary are exec'd at once (e.g. by a build system), only the first runs the
+//  (expensive) dynamic/static check, while the rest wait for, and share, its result. checks
+//  run on a bounded pool (workers), so a burst of different binaries can't swamp the cores
+
+@import OSLog;
+
+#import <os/lock.h>
+
+#import "SigningFlights.h"
+
+/* CONSTS */
+
+//code is valid
+// from: cs_blobs.h
+#define CS_VALID 0x00000001
+
+//hash length
+// from: cs_blobs.h
+#define CS_CDHASH_LEN 20
+
+/* OBJECT: FLIGHT */
+
+@interface SigningFlight : NSObject
+
+//group
+// left once check is done
+@property(nonatomic, retain)dispatch_group_t group;
+
+//result
+@property(nonatomic, retain)NSDictionary* signingInfo;
+
+@end
+
+@implementation SigningFlight
+
+@synthesize group;
+@synthesize signingInfo;
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init group
+        group = dispatch_group_create();
+    }
+    
+    return self;
+}
+
+@end
+
+/* OBJECT: FLIGHTS */
+
+@interface SigningFlights ()
+{
+    //lock
+    os_unfair_lock lock;
+    
+    //workers
+    NSUInteger workers;
+    
+    //counters
+    uint64_t checks;
+    uint64_t coalesced;
+    uint64_t uncoalesced;
+    uint64_t workerWaits;
+    
+    //max in flight
+    NSUInteger maxInFlight;
+}
+
+//flights
+// key: cd hash + team id + option
+@property(nonatomic, retain)NSMutableDictionary<NSData*, SigningFlight*>* flights;
+
+//pool
+// bounds concurrent checks
+@property(nonatomic, retain)dispatch_semaphore_t pool;
+
+@end
+
+@implementation SigningFlights
+
+@synthesize pool;
+@synthesize flights;
+
+//init
+-(id)initWithWorkers:(NSUInteger)count
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init
+        lock = OS_UNFAIR_LOCK_INIT;
+        workers = MAX(count, 1);
+        
+        //alloc
+        flights = [NSMutableDictionary dictionary];
+        
+        //init pool
+        pool = dispatch_semaphore_create(workers);
+    }
+    
+    return self;
+}
+
+//verify
+// run check, or wait for (same) one that's in flight
+-(NSMutableDictionary*)verify:(const uint8_t*)cdHash teamID:(NSString*)teamID option:(NSUInteger)option csFlags:(uint32_t)csFlags check:(SigningCheckBlock)check leader:(BOOL*)leader
+{
+    //signing info
+    NSMutableDictionary* signingInfo = nil;
+    
+    //flight
+    SigningFlight* flight = nil;
+    
+    //key
+    NSMutableData* key = nil;
+    
+    //flag
+    BOOL isLeader = NO;
+    
+    //flag
+    BOOL hasHash = NO;
+    
+    //any (non-zero) cd hash?
+    for(NSUInteger i = 0; i < CS_CDHASH_LEN; i++)
+    {
+        //non-zero?
+        if(0 != cdHash[i])
+        {
+            //set
+            hasHash = YES;
+            break;
+        }
+    }
+    
+    //not (kernel) validated, or no cd hash?
+    // can't tell it's the same code, so just run the check
+    if( (CS_VALID != (csFlags & CS_VALID)) ||
+        (YES != hasHash) )
+    {
+        //lock
+        os_unfair_lock_lock(&lock);
+        
+        //inc
+        uncoalesced++;
+        
+        //unlock
+        os_unfair_lock_unlock(&lock);
+        
+        //leader (of own flight)
+        isLeader = YES;
+        
+        //check
+        signingInfo = [self run:check];
+        
+        //done
+        goto bail;
+    }
+    
+    //init key
+    // cd hash + team id + option
+    key = [NSMutableData dataWithBytes:cdHash length:CS_CDHASH_LEN];
+    [key appendBytes:&option length:sizeof(option)];
+    if(0 != teamID.length)
+    {
+        //add
+        [key appendData:[teamID dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+    
+    //lock
+    os_unfair_lock_lock(&lock);
+    
+    //in flight?
+    flight = self.flights[key];
+    
+    //none?
+    // this caller leads (runs check)
+    if(nil == flight)
+    {
+        //init
+        flight = [[SigningFlight alloc] init];
+        
+        //enter
+        // waiters wait till it's left
+        dispatch_group_enter(flight.group);
+        
+        //add
+        self.flights[key] = flight;
+        
+        //set
+        isLeader = YES;
+        
+        //inc
+        checks++;
+        
+        //max?
+        maxInFlight = MAX(maxInFlight, self.flights.count);
+    }
+    //in flight
+    // this caller will wait
+    else
+    {
+        //inc
+        coalesced++;
+    }
+    
+    //unlock
+    os_unfair_lock_unlock(&lock);
+    
+    //leader?
+    // run check, then release waiters
+    if(YES == isLeader)
+    {
+        //check
+        signingInfo = [self run:check];
+        
+        //save
+        // copy, as leader's can be modified
+        flight.signingInfo = [signingInfo copy];
+        
+        //lock
+        os_unfair_lock_lock(&lock);
+        
+        //remove
+        // later callers will check anew (or hit signing cache)
+        [self.flights removeObjectForKey:key];
+        
+        //unlock
+        os_unfair_lock_unlock(&lock);
+        
+        //release waiters
+        dispatch_group_leave(flight.group);
+    }
+    //waiter
+    // wait for leader's result
+    else
+    {
+        //wait
+        dispatch_group_wait(flight.group, DISPATCH_TIME_FOREVER);
+        
+        //copy
+        signingInfo = [flight.signingInfo mutableCopy];
+    }
+    
+bail:
+    
+    //set
+    if(NULL != leader) *leader = isLeader;
+    
+    return signingInfo;
+}
+
+//run check
+// once a worker (from pool) is free
+-(NSMutableDictionary*)run:(SigningCheckBlock)check
+{
+    //signing info
+    NSMutableDictionary* signingInfo = nil;
+    
+    //no free worker?
+    // wait for one
+    if(0 != dispatch_semaphore_wait(self.pool, DISPATCH_TIME_NOW))
+    {
+        //lock
+        os_unfair_lock_lock(&lock);
+        
+        //inc
+        workerWaits++;
+        
+        //unlock
+        os_unfair_lock_unlock(&lock);
+        
+        //wait
+        dispatch_semaphore_wait(self.pool, DISPATCH_TIME_FOREVER);
+    }
+    
+    //check
+    signingInfo = check();
+    
+    //free worker
+    dispatch_semaphore_signal(self.pool);
+    
+    return signingInfo;
+}
+
+//stats
+// checks, coalesced waiters, and waits for a worker
+-(NSDictionary*)stats
+{
+    //stats
+    NSDictionary* stats = nil;
+    
+    //lock
+    os_unfair_lock_lock(&lock);
+    
+    //init
+    stats = @{@"workers":@(workers),
+              @"checks":@(checks),
+              @"checks (uncoalesced)":@(uncoalesced),
+              @"coalesced":@(coalesced),
+              @"coalesced (%)":@((0 != checks + coalesced) ? ((100 * coalesced) / (checks + coalesced)) : 0),
+              @"in flight":@(self.flights.count),
+              @"max in flight":@(maxInFlight),
+              @"worker waits":@(workerWaits)};
+    
+    //unlock
+    os_unfair_lock_unlock(&lock);
+    
+    return stats;
+}
+
+@end
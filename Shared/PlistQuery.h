@@ -0,0 +1,52 @@
+//
+//  file: PlistQuery.h
+//  project: BlockBlock (shared)
+//  description: selective (streaming) plist parser (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+#ifndef PlistQuery_h
+#define PlistQuery_h
+
+@import Foundation;
+
+/* CONSTS */
+
+//max nesting depth
+// deeper (or cyclic, in binary plists) values are invalid
+#define PLIST_QUERY_MAX_DEPTH 64
+
+//max number of objects created for a value
+// bounds (binary) values that share objects exponentially
+#define PLIST_QUERY_MAX_OBJECTS (1024 * 1024)
+
+/* TYPEDEFS */
+
+//result
+typedef NS_ENUM(NSInteger, PlistQueryResult)
+{
+    //found
+    PlistQueryFound,
+
+    //(key path) not found
+    PlistQueryNotFound,
+
+    //invalid (malformed/hostile) plist
+    PlistQueryInvalid,
+
+    //unsupported format
+    // i.e. not an xml or binary (bplist00) plist
+    PlistQueryUnsupported
+};
+
+/* FUNCTIONS */
+
+//query plist for value at key path
+// key path: NSString (dictionary key) and NSNumber (array index) elements
+// only the value found is created, parsing stops once it is, and skipped values aren't copied
+// note: (binary) UIDs are returned as @{@"CF$UID":value}, as in xml plists
+PlistQueryResult plistQuery(NSData* data, NSArray* keyPath, BOOL insensitive, id* value);
+
+#endif /* PlistQuery_h */
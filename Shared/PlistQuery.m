@@ -0,0 +1,1534 @@
+//
+//  file: PlistQuery.m
+//  project: BlockBlock (shared)
+//  description: selective (streaming) plist parser
+//
+//  created by Patrick Wardle
+//  copyright (c) 2025 Objective-See. All rights reserved.
+//
+
+//  to resolve an item, only a value or two (e.g. a launch item's 'Program') is needed, yet
+//  Foundation builds the whole plist's object graph. this walks the (xml or binary) plist to
+//  the value at a key path, creating only that value. skipped keys/values aren't copied: in
+//  binary plists, they're never even touched (just offsets), in xml, they're only scanned.
+//
+//  as plists may be hostile, every offset/count is bounds checked, nesting is capped, and the
+//  number of objects created is too (as binary plists can share objects, i.e. 'billion laughs')
+
+#import "PlistQuery.h"
+
+/* TYPEDEFS */
+
+//binary plist
+// from its trailer
+typedef struct
+{
+    //bytes
+    const uint8_t* bytes;
+
+    //length
+    size_t length;
+
+    //size of offsets
+    uint8_t offsetSize;
+
+    //size of (object) refs
+    uint8_t refSize;
+
+    //number of objects
+    uint64_t objectCount;
+
+    //top (root) object
+    uint64_t topObject;
+
+    //offset of offset table
+    // also end of objects
+    uint64_t offsetTable;
+
+    //objects (still) allowed to be created
+    uint64_t budget;
+
+} BinaryPlist;
+
+//xml cursor
+typedef struct
+{
+    //bytes
+    const char* bytes;
+
+    //length
+    size_t length;
+
+    //position
+    size_t position;
+
+    //objects (still) allowed to be created
+    uint64_t budget;
+
+} XMLCursor;
+
+//xml tag
+typedef struct
+{
+    //name (offset)
+    size_t name;
+
+    //name length
+    size_t nameLength;
+
+    //close tag?
+    BOOL isClose;
+
+    //empty element?
+    BOOL isEmpty;
+
+} XMLTag;
+
+/* FUNCTIONS: BINARY */
+
+//read (big endian) unsigned int
+static uint64_t readUInt(const uint8_t* bytes, size_t size)
+{
+    //value
+    uint64_t value = 0;
+
+    //read
+    for(size_t i = 0; i < size; i++)
+    {
+        value = (value << 8) | bytes[i];
+    }
+
+    return value;
+}
+
+//open binary plist
+// parse and validate trailer
+static BOOL binaryOpen(NSData* data, BinaryPlist* plist)
+{
+    //trailer
+    const uint8_t* trailer = NULL;
+
+    //header + trailer
+    if(data.length < 8 + 32) return NO;
+
+    //init
+    plist->bytes = data.bytes;
+    plist->length = data.length;
+    plist->budget = PLIST_QUERY_MAX_OBJECTS;
+
+    //trailer is last 32 bytes
+    trailer = plist->bytes + plist->length - 32;
+
+    //parse
+    plist->offsetSize = trailer[6];
+    plist->refSize = trailer[7];
+    plist->objectCount = readUInt(trailer + 8, 8);
+    plist->topObject = readUInt(trailer + 16, 8);
+    plist->offsetTable = readUInt(trailer + 24, 8);
+
+    //validate
+    // sizes, top object, and that offset table fits (before trailer)
+    if( (0 == plist->offsetSize) || (plist->offsetSize > 8) ||
+        (0 == plist->refSize) || (plist->refSize > 8) ||
+        (0 == plist->objectCount) ||
+        (plist->topObject >= plist->objectCount) ||
+        (plist->offsetTable < 8) ||
+        (plist->offsetTable >= plist->length - 32) ||
+        (plist->objectCount > (plist->length - 32 - plist->offsetTable) / plist->offsetSize) )
+    {
+        return NO;
+    }
+
+    return YES;
+}
+
+//offset of object
+// must be after header, and before offset table
+static BOOL binaryOffset(BinaryPlist* plist, uint64_t ref, uint64_t* offset)
+{
+    //invalid ref?
+    if(ref >= plist->objectCount) return NO;
+
+    //read
+    *offset = readUInt(plist->bytes + plist->offsetTable + ref * plist->offsetSize, plist->offsetSize);
+
+    return (*offset >= 8) && (*offset < plist->offsetTable);
+}
+
+//count (and start of contents) of object
+// count is in marker, unless it's 0xF, then it follows (as an int object)
+static BOOL binaryCount(BinaryPlist* plist, uint64_t offset, uint64_t* count, uint64_t* start)
+{
+    //marker of count
+    uint8_t marker = 0;
+
+    //size of count
+    uint64_t size = 0;
+
+    //in marker?
+    if(0x0F != (plist->bytes[offset] & 0x0F))
+    {
+        //set
+        *count = plist->bytes[offset] & 0x0F;
+        *start = offset + 1;
+
+        return YES;
+    }
+
+    //int marker
+    if(offset + 2 > plist->offsetTable) return NO;
+    marker = plist->bytes[offset + 1];
+    if( (0x10 != (marker & 0xF0)) || ((marker & 0x0F) > 3) ) return NO;
+
+    //int
+    size = 1ULL << (marker & 0x0F);
+    if(offset + 2 + size > plist->offsetTable) return NO;
+
+    //set
+    *count = readUInt(plist->bytes + offset + 2, (size_t)size);
+    *start = offset + 2 + size;
+
+    return YES;
+}
+
+//do contents fit?
+// i.e. count items (of size) from start, before offset table
+static BOOL binaryFits(BinaryPlist* plist, uint64_t start, uint64_t count, uint64_t size)
+{
+    //start past end?
+    if(start > plist->offsetTable) return NO;
+
+    //fits?
+    return (count <= (plist->offsetTable - start) / size);
+}
+
+//ref at index
+// in an array/dictionary's (already validated) refs
+static uint64_t binaryRef(BinaryPlist* plist, uint64_t start, uint64_t index)
+{
+    return readUInt(plist->bytes + start + index * plist->refSize, plist->refSize);
+}
+
+//does (dictionary) key match?
+// ascii keys are compared in place, w/o creating a string
+static BOOL binaryKeyMatches(BinaryPlist* plist, uint64_t ref, NSString* key, const char* utf8, size_t utf8Length, BOOL insensitive)
+{
+    //offset
+    uint64_t offset = 0;
+
+    //count
+    uint64_t count = 0;
+
+    //start
+    uint64_t start = 0;
+
+    //string
+    NSString* string = nil;
+
+    //offset/count
+    if( (YES != binaryOffset(plist, ref, &offset)) ||
+        (YES != binaryCount(plist, offset, &count, &start)) )
+    {
+        return NO;
+    }
+
+    //ascii string
+    if(0x50 == (plist->bytes[offset] & 0xF0))
+    {
+        //fits/same length?
+        if( (YES != binaryFits(plist, start, count, 1)) ||
+            (count != utf8Length) )
+        {
+            return NO;
+        }
+
+        //compare
+        return (YES == insensitive) ? (0 == strncasecmp((const char*)plist->bytes + start, utf8, utf8Length)) : (0 == memcmp(plist->bytes + start, utf8, utf8Length));
+    }
+
+    //utf-16 string
+    if(0x60 == (plist->bytes[offset] & 0xF0))
+    {
+        //fits?
+        if(YES != binaryFits(plist, start, count, 2)) return NO;
+
+        //init
+        string = [[NSString alloc] initWithBytes:plist->bytes + start length:(NSUInteger)(count * 2) encoding:NSUTF16BigEndianStringEncoding];
+
+        //compare
+        return (YES == insensitive) ? (NSOrderedSame == [string caseInsensitiveCompare:key]) : [string isEqualToString:key];
+    }
+
+    return NO;
+}
+
+//create object
+// and (recursively) any it contains
+static PlistQueryResult binaryObject(BinaryPlist* plist, uint64_t ref, NSUInteger depth, id* value)
+{
+    //offset
+    uint64_t offset = 0;
+
+    //marker
+    uint8_t marker = 0;
+
+    //count
+    uint64_t count = 0;
+
+    //start
+    uint64_t start = 0;
+
+    //size
+    uint64_t size = 0;
+
+    //int
+    uint64_t integer = 0;
+
+    //float
+    float real32 = 0;
+
+    //double
+    double real64 = 0;
+
+    //collection
+    id collection = nil;
+
+    //key
+    id key = nil;
+
+    //object
+    id object = nil;
+
+    //result
+    PlistQueryResult result = PlistQueryInvalid;
+
+    //too deep (or cyclic), or too many objects?
+    if( (depth > PLIST_QUERY_MAX_DEPTH) ||
+        (0 == plist->budget) )
+    {
+        return PlistQueryInvalid;
+    }
+
+    //dec
+    plist->budget--;
+
+    //offset
+    if(YES != binaryOffset(plist, ref, &offset)) return PlistQueryInvalid;
+
+    //marker
+    marker = plist->bytes[offset];
+
+    switch(marker & 0xF0)
+    {
+        //bool
+        case 0x00:
+
+            //false/true
+            if(0x08 == marker) *value = @NO;
+            else if(0x09 == marker) *value = @YES;
+            else return PlistQueryInvalid;
+
+            break;
+
+        //int
+        // 1, 2, 4, 8, or 16 bytes
+        case 0x10:
+
+            //size
+            if((marker & 0x0F) > 4) return PlistQueryInvalid;
+            size = 1ULL << (marker & 0x0F);
+            if(YES != binaryFits(plist, offset + 1, size, 1)) return PlistQueryInvalid;
+
+            //16 bytes
+            // just (unsigned) low 8
+            if(16 == size)
+            {
+                *value = [NSNumber numberWithUnsignedLongLong:readUInt(plist->bytes + offset + 1 + 8, 8)];
+            }
+            //others
+            // (only) 8 bytes are signed
+            else
+            {
+                integer = readUInt(plist->bytes + offset + 1, (size_t)size);
+                *value = [NSNumber numberWithLongLong:(long long)integer];
+            }
+
+            break;
+
+        //real
+        // 4 or 8 bytes
+        case 0x20:
+
+            //float
+            if(0x22 == marker)
+            {
+                if(YES != binaryFits(plist, offset + 1, 4, 1)) return PlistQueryInvalid;
+                integer = readUInt(plist->bytes + offset + 1, 4);
+                uint32_t bits = (uint32_t)integer;
+                memcpy(&real32, &bits, sizeof(real32));
+                *value = [NSNumber numberWithFloat:real32];
+            }
+            //double
+            else if(0x23 == marker)
+            {
+                if(YES != binaryFits(plist, offset + 1, 8, 1)) return PlistQueryInvalid;
+                integer = readUInt(plist->bytes + offset + 1, 8);
+                memcpy(&real64, &integer, sizeof(real64));
+                *value = [NSNumber numberWithDouble:real64];
+            }
+            else return PlistQueryInvalid;
+
+            break;
+
+        //date
+        // double, since 2001
+        case 0x30:
+
+            if( (0x33 != marker) ||
+                (YES != binaryFits(plist, offset + 1, 8, 1)) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            integer = readUInt(plist->bytes + offset + 1, 8);
+            memcpy(&real64, &integer, sizeof(real64));
+            *value = [NSDate dateWithTimeIntervalSinceReferenceDate:real64];
+
+            break;
+
+        //data
+        case 0x40:
+
+            if( (YES != binaryCount(plist, offset, &count, &start)) ||
+                (YES != binaryFits(plist, start, count, 1)) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            *value = [NSData dataWithBytes:plist->bytes + start length:(NSUInteger)count];
+
+            break;
+
+        //ascii string
+        case 0x50:
+
+            if( (YES != binaryCount(plist, offset, &count, &start)) ||
+                (YES != binaryFits(plist, start, count, 1)) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            *value = [[NSString alloc] initWithBytes:plist->bytes + start length:(NSUInteger)count encoding:NSASCIIStringEncoding];
+            if(nil == *value) return PlistQueryInvalid;
+
+            break;
+
+        //utf-16 string
+        case 0x60:
+
+            if( (YES != binaryCount(plist, offset, &count, &start)) ||
+                (YES != binaryFits(plist, start, count, 2)) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            *value = [[NSString alloc] initWithBytes:plist->bytes + start length:(NSUInteger)(count * 2) encoding:NSUTF16BigEndianStringEncoding];
+            if(nil == *value) return PlistQueryInvalid;
+
+            break;
+
+        //uid
+        // 1-8 bytes, as in xml plists
+        case 0x80:
+
+            size = (marker & 0x0F) + 1;
+            if( (size > 8) ||
+                (YES != binaryFits(plist, offset + 1, size, 1)) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            *value = @{@"CF$UID":[NSNumber numberWithUnsignedLongLong:readUInt(plist->bytes + offset + 1, (size_t)size)]};
+
+            break;
+
+        //array/set
+        case 0xA0:
+        case 0xC0:
+
+            if( (YES != binaryCount(plist, offset, &count, &start)) ||
+                (YES != binaryFits(plist, start, count, plist->refSize)) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            //alloc
+            collection = (0xA0 == (marker & 0xF0)) ? [NSMutableArray array] : [NSMutableSet set];
+
+            //add each
+            for(uint64_t i = 0; i < count; i++)
+            {
+                //create
+                result = binaryObject(plist, binaryRef(plist, start, i), depth + 1, &object);
+                if(PlistQueryFound != result) return result;
+
+                //add
+                [collection addObject:object];
+            }
+
+            *value = collection;
+
+            break;
+
+        //dictionary
+        // keys refs, then value refs
+        case 0xD0:
+
+            if( (YES != binaryCount(plist, offset, &count, &start)) ||
+                (YES != binaryFits(plist, start, count, plist->refSize * 2)) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            //alloc
+            collection = [NSMutableDictionary dictionary];
+
+            //add each
+            for(uint64_t i = 0; i < count; i++)
+            {
+                //create key
+                result = binaryObject(plist, binaryRef(plist, start, i), depth + 1, &key);
+                if(PlistQueryFound != result) return result;
+
+                //keys must be strings
+                if(YES != [key isKindOfClass:[NSString class]]) return PlistQueryInvalid;
+
+                //create value
+                result = binaryObject(plist, binaryRef(plist, start, count + i), depth + 1, &object);
+                if(PlistQueryFound != result) return result;
+
+                //add
+                ((NSMutableDictionary*)collection)[key] = object;
+            }
+
+            *value = collection;
+
+            break;
+
+        default:
+            return PlistQueryInvalid;
+    }
+
+    return PlistQueryFound;
+}
+
+//query binary plist
+// walk refs (only) to the value, then create it
+static PlistQueryResult binaryQuery(BinaryPlist* plist, NSArray* keyPath, BOOL insensitive, id* value)
+{
+    //ref
+    uint64_t ref = plist->topObject;
+
+    //offset
+    uint64_t offset = 0;
+
+    //count
+    uint64_t count = 0;
+
+    //start
+    uint64_t start = 0;
+
+    //match
+    uint64_t match = 0;
+
+    //(insensitive) match
+    uint64_t insensitiveMatch = 0;
+
+    //walk key path
+    for(id element in keyPath)
+    {
+        //offset/count
+        if( (YES != binaryOffset(plist, ref, &offset)) ||
+            (YES != binaryCount(plist, offset, &count, &start)) )
+        {
+            return PlistQueryInvalid;
+        }
+
+        //key?
+        // find in dictionary, by comparing keys (only)
+        if(YES == [element isKindOfClass:[NSString class]])
+        {
+            //not a dictionary?
+            if(0xD0 != (plist->bytes[offset] & 0xF0)) return PlistQueryNotFound;
+
+            //fits?
+            if(YES != binaryFits(plist, start, count, plist->refSize * 2)) return PlistQueryInvalid;
+
+            //init
+            match = count;
+            insensitiveMatch = count;
+
+            //find
+            // exact match wins, otherwise insensitive one
+            // note: all keys are checked, as (like CF/launchd) the last duplicate key wins
+            for(uint64_t i = 0; i < count; i++)
+            {
+                //exact?
+                if(YES == binaryKeyMatches(plist, binaryRef(plist, start, i), element, [element UTF8String], strlen([element UTF8String]), NO))
+                {
+                    //save
+                    match = i;
+                    continue;
+                }
+
+                //insensitive?
+                if( (YES == insensitive) &&
+                    (YES == binaryKeyMatches(plist, binaryRef(plist, start, i), element, [element UTF8String], strlen([element UTF8String]), YES)) )
+                {
+                    //save
+                    insensitiveMatch = i;
+                }
+            }
+
+            //none?
+            if(count == match) match = insensitiveMatch;
+            if(count == match) return PlistQueryNotFound;
+
+            //value's ref
+            ref = binaryRef(plist, start, count + match);
+        }
+
+        //index?
+        // in array
+        else if(YES == [element isKindOfClass:[NSNumber class]])
+        {
+            //not an array?
+            if(0xA0 != (plist->bytes[offset] & 0xF0)) return PlistQueryNotFound;
+
+            //fits?
+            if(YES != binaryFits(plist, start, count, plist->refSize)) return PlistQueryInvalid;
+
+            //out of range?
+            if([element unsignedLongLongValue] >= count) return PlistQueryNotFound;
+
+            //value's ref
+            ref = binaryRef(plist, start, [element unsignedLongLongValue]);
+        }
+
+        //invalid element
+        else return PlistQueryNotFound;
+    }
+
+    //create value
+    return binaryObject(plist, ref, 0, value);
+}
+
+/* FUNCTIONS: XML */
+
+//at prefix?
+static BOOL xmlHasPrefix(XMLCursor* cursor, const char* prefix)
+{
+    //length
+    size_t length = strlen(prefix);
+
+    return (cursor->length - cursor->position >= length) && (0 == memcmp(cursor->bytes + cursor->position, prefix, length));
+}
+
+//find terminator
+// between from and to, returns to if not found
+static size_t xmlFind(XMLCursor* cursor, size_t from, size_t to, const char* terminator)
+{
+    //found
+    const char* found = memmem(cursor->bytes + from, to - from, terminator, strlen(terminator));
+
+    return (NULL != found) ? (size_t)(found - cursor->bytes) : to;
+}
+
+//skip past terminator
+static BOOL xmlSkipPast(XMLCursor* cursor, const char* terminator)
+{
+    //find
+    size_t found = xmlFind(cursor, cursor->position, cursor->length, terminator);
+    if(found == cursor->length) return NO;
+
+    //skip
+    cursor->position = found + strlen(terminator);
+
+    return YES;
+}
+
+//skip whitespace, comments, processing instructions, and doctype
+static BOOL xmlSkipMisc(XMLCursor* cursor)
+{
+    //(doctype) bracket depth
+    NSUInteger brackets = 0;
+
+    while(cursor->position < cursor->length)
+    {
+        //whitespace
+        if(isspace((unsigned char)cursor->bytes[cursor->position]))
+        {
+            cursor->position++;
+        }
+        //comment
+        else if(YES == xmlHasPrefix(cursor, "<!--"))
+        {
+            if(YES != xmlSkipPast(cursor, "-->")) return NO;
+        }
+        //processing instruction
+        else if(YES == xmlHasPrefix(cursor, "<?"))
+        {
+            if(YES != xmlSkipPast(cursor, "?>")) return NO;
+        }
+        //doctype
+        // may have an (internal) subset in brackets
+        else if(YES == xmlHasPrefix(cursor, "<!DOCTYPE"))
+        {
+            for(brackets = 0; cursor->position < cursor->length; cursor->position++)
+            {
+                if('[' == cursor->bytes[cursor->position]) brackets++;
+                else if( (']' == cursor->bytes[cursor->position]) && (0 != brackets) ) brackets--;
+                else if( ('>' == cursor->bytes[cursor->position]) && (0 == brackets) ) break;
+            }
+
+            if(cursor->position >= cursor->length) return NO;
+            cursor->position++;
+        }
+        else break;
+    }
+
+    return YES;
+}
+
+//(declared) encoding supported?
+// only utf-8 (the default, if there's no xml declaration, or encoding in it)
+static BOOL xmlEncodingSupported(XMLCursor* cursor)
+{
+    //end of declaration
+    size_t end = 0;
+
+    //encoding
+    size_t encoding = 0;
+
+    //quote
+    char quote = 0;
+
+    //value
+    size_t start = 0;
+
+    //no declaration?
+    if(YES != xmlHasPrefix(cursor, "<?xml")) return YES;
+
+    //find end
+    end = xmlFind(cursor, cursor->position, cursor->length, "?>");
+
+    //find encoding
+    encoding = xmlFind(cursor, cursor->position, end, "encoding");
+    if(encoding == end) return YES;
+
+    //skip to (quoted) value
+    for(encoding += strlen("encoding"); encoding < end; encoding++)
+    {
+        if( ('"' == cursor->bytes[encoding]) || ('\'' == cursor->bytes[encoding]) ) break;
+    }
+    if(encoding >= end) return NO;
+
+    //value
+    quote = cursor->bytes[encoding];
+    start = encoding + 1;
+    encoding = start;
+    while( (encoding < end) && (quote != cursor->bytes[encoding]) ) encoding++;
+    if(encoding >= end) return NO;
+
+    //utf-8?
+    return ( ((encoding - start) == strlen("utf-8")) && (0 == strncasecmp(cursor->bytes + start, "utf-8", strlen("utf-8"))) ) ||
+           ( ((encoding - start) == strlen("utf8")) && (0 == strncasecmp(cursor->bytes + start, "utf8", strlen("utf8"))) );
+}
+
+//read tag
+// name, and if it's a close, or empty, tag (attributes are skipped)
+static BOOL xmlTag(XMLCursor* cursor, XMLTag* tag)
+{
+    //quote
+    char quote = 0;
+
+    //char
+    char c = 0;
+
+    //at tag?
+    if( (cursor->position >= cursor->length) ||
+        ('<' != cursor->bytes[cursor->position]) )
+    {
+        return NO;
+    }
+
+    //init
+    cursor->position++;
+    tag->isClose = NO;
+    tag->isEmpty = NO;
+
+    //close tag?
+    if( (cursor->position < cursor->length) &&
+        ('/' == cursor->bytes[cursor->position]) )
+    {
+        tag->isClose = YES;
+        cursor->position++;
+    }
+
+    //name
+    tag->name = cursor->position;
+    while(cursor->position < cursor->length)
+    {
+        c = cursor->bytes[cursor->position];
+        if( (YES != isalnum((unsigned char)c)) && ('_' != c) && ('-' != c) && (':' != c) && ('.' != c) ) break;
+        cursor->position++;
+    }
+    tag->nameLength = cursor->position - tag->name;
+    if(0 == tag->nameLength) return NO;
+
+    //skip attributes
+    // respecting quotes
+    while(cursor->position < cursor->length)
+    {
+        c = cursor->bytes[cursor->position];
+        if(0 != quote) { if(c == quote) quote = 0; }
+        else if( ('"' == c) || ('\'' == c) ) quote = c;
+        else if('>' == c) break;
+        cursor->position++;
+    }
+    if(cursor->position >= cursor->length) return NO;
+
+    //empty element?
+    if( (YES != tag->isClose) &&
+        ('/' == cursor->bytes[cursor->position - 1]) )
+    {
+        tag->isEmpty = YES;
+    }
+
+    //skip '>'
+    cursor->position++;
+
+    return YES;
+}
+
+//tag is?
+static BOOL xmlTagIs(XMLCursor* cursor, XMLTag* tag, const char* name)
+{
+    return (strlen(name) == tag->nameLength) && (0 == memcmp(cursor->bytes + tag->name, name, tag->nameLength));
+}
+
+//read text of leaf element
+// up to its close tag (skipping cdata, comments), raw: no entities/cdata/comments to decode
+static BOOL xmlLeaf(XMLCursor* cursor, XMLTag* tag, size_t* start, size_t* end, BOOL* raw)
+{
+    //close tag
+    XMLTag close = {0};
+
+    //next '<'
+    const char* next = NULL;
+
+    //init
+    *start = cursor->position;
+    *end = cursor->position;
+    *raw = YES;
+
+    //empty?
+    if(YES == tag->isEmpty) return YES;
+
+    //find end of text
+    while(YES)
+    {
+        //next tag
+        next = memchr(cursor->bytes + cursor->position, '<', cursor->length - cursor->position);
+        if(NULL == next) return NO;
+        cursor->position = next - cursor->bytes;
+
+        //cdata
+        if(YES == xmlHasPrefix(cursor, "<![CDATA["))
+        {
+            *raw = NO;
+            if(YES != xmlSkipPast(cursor, "]]>")) return NO;
+        }
+        //comment
+        else if(YES == xmlHasPrefix(cursor, "<!--"))
+        {
+            *raw = NO;
+            if(YES != xmlSkipPast(cursor, "-->")) return NO;
+        }
+        else break;
+    }
+
+    //end
+    *end = cursor->position;
+
+    //entities?
+    if(NULL != memchr(cursor->bytes + *start, '&', *end - *start)) *raw = NO;
+
+    //close tag
+    // must match
+    if( (YES != xmlTag(cursor, &close)) ||
+        (YES != close.isClose) ||
+        (close.nameLength != tag->nameLength) ||
+        (0 != memcmp(cursor->bytes + close.name, cursor->bytes + tag->name, tag->nameLength)) )
+    {
+        return NO;
+    }
+
+    return YES;
+}
+
+//append (unicode) code point
+// as utf-8
+static BOOL xmlAppendCodePoint(NSMutableData* data, uint32_t codePoint)
+{
+    //bytes
+    uint8_t bytes[4] = {0};
+
+    //length
+    NSUInteger length = 0;
+
+    //invalid?
+    if( (0 == codePoint) || (codePoint > 0x10FFFF) || ((codePoint >= 0xD800) && (codePoint <= 0xDFFF)) ) return NO;
+
+    //encode
+    if(codePoint < 0x80) { bytes[0] = codePoint; length = 1; }
+    else if(codePoint < 0x800) { bytes[0] = 0xC0 | (codePoint >> 6); bytes[1] = 0x80 | (codePoint & 0x3F); length = 2; }
+    else if(codePoint < 0x10000) { bytes[0] = 0xE0 | (codePoint >> 12); bytes[1] = 0x80 | ((codePoint >> 6) & 0x3F); bytes[2] = 0x80 | (codePoint & 0x3F); length = 3; }
+    else { bytes[0] = 0xF0 | (codePoint >> 18); bytes[1] = 0x80 | ((codePoint >> 12) & 0x3F); bytes[2] = 0x80 | ((codePoint >> 6) & 0x3F); bytes[3] = 0x80 | (codePoint & 0x3F); length = 4; }
+
+    //append
+    [data appendBytes:bytes length:length];
+
+    return YES;
+}
+
+//decode text
+// entities, cdata, and comments
+static NSString* xmlDecode(XMLCursor* cursor, size_t start, size_t end, BOOL raw)
+{
+    //decoded
+    NSMutableData* decoded = nil;
+
+    //position
+    size_t position = start;
+
+    //run (of plain text)
+    size_t run = 0;
+
+    //found
+    size_t found = 0;
+
+    //entity
+    NSString* entity = nil;
+
+    //code point
+    unsigned long long codePoint = 0;
+
+    //scanner
+    NSScanner* scanner = nil;
+
+    //raw?
+    // just create string
+    if(YES == raw)
+    {
+        return [[NSString alloc] initWithBytes:cursor->bytes + start length:end - start encoding:NSUTF8StringEncoding];
+    }
+
+    //alloc
+    decoded = [NSMutableData dataWithCapacity:end - start];
+
+    while(position < end)
+    {
+        //plain text
+        // append (whole) run
+        for(run = position; (run < end) && ('&' != cursor->bytes[run]) && ('<' != cursor->bytes[run]); run++);
+        [decoded appendBytes:cursor->bytes + position length:run - position];
+        position = run;
+
+        //done?
+        if(position >= end) break;
+
+        //cdata
+        // append as is
+        if( ('<' == cursor->bytes[position]) &&
+            (end - position >= 9) &&
+            (0 == memcmp(cursor->bytes + position, "<![CDATA[", 9)) )
+        {
+            found = xmlFind(cursor, position + 9, end, "]]>");
+            if(found == end) return nil;
+
+            [decoded appendBytes:cursor->bytes + position + 9 length:found - (position + 9)];
+            position = found + 3;
+        }
+        //comment
+        // skip
+        else if( ('<' == cursor->bytes[position]) &&
+                 (end - position >= 4) &&
+                 (0 == memcmp(cursor->bytes + position, "<!--", 4)) )
+        {
+            found = xmlFind(cursor, position + 4, end, "-->");
+            if(found == end) return nil;
+
+            position = found + 3;
+        }
+        //entity
+        else if('&' == cursor->bytes[position])
+        {
+            //find end
+            found = xmlFind(cursor, position + 1, MIN(end, position + 16), ";");
+            if(found == MIN(end, position + 16)) return nil;
+
+            //entity
+            entity = [[NSString alloc] initWithBytes:cursor->bytes + position + 1 length:found - (position + 1) encoding:NSASCIIStringEncoding];
+
+            //named
+            if([entity isEqualToString:@"lt"]) [decoded appendBytes:"<" length:1];
+            else if([entity isEqualToString:@"gt"]) [decoded appendBytes:">" length:1];
+            else if([entity isEqualToString:@"amp"]) [decoded appendBytes:"&" length:1];
+            else if([entity isEqualToString:@"quot"]) [decoded appendBytes:"\"" length:1];
+            else if([entity isEqualToString:@"apos"]) [decoded appendBytes:"'" length:1];
+
+            //numeric
+            // hex, or decimal
+            else if([entity hasPrefix:@"#"])
+            {
+                //hex?
+                if( ([entity hasPrefix:@"#x"]) || ([entity hasPrefix:@"#X"]) )
+                {
+                    scanner = [NSScanner scannerWithString:[entity substringFromIndex:2]];
+                    if( (YES != [scanner scanHexLongLong:&codePoint]) || (YES != scanner.isAtEnd) ) return nil;
+                }
+                //decimal
+                else
+                {
+                    scanner = [NSScanner scannerWithString:[entity substringFromIndex:1]];
+                    if( (YES != [scanner scanUnsignedLongLong:&codePoint]) || (YES != scanner.isAtEnd) ) return nil;
+                }
+
+                //append
+                if( (codePoint > UINT32_MAX) || (YES != xmlAppendCodePoint(decoded, (uint32_t)codePoint)) ) return nil;
+            }
+
+            //unknown
+            else return nil;
+
+            position = found + 1;
+        }
+        //unexpected
+        else return nil;
+    }
+
+    return [[NSString alloc] initWithData:decoded encoding:NSUTF8StringEncoding];
+}
+
+//does key match?
+// raw keys are compared in place, w/o creating a string
+static BOOL xmlKeyMatches(XMLCursor* cursor, size_t start, size_t end, BOOL raw, NSString* key, const char* utf8, size_t utf8Length, BOOL insensitive)
+{
+    //decoded
+    NSString* decoded = nil;
+
+    //raw?
+    if(YES == raw)
+    {
+        //same length?
+        if(end - start != utf8Length) return NO;
+
+        //compare
+        return (YES == insensitive) ? (0 == strncasecmp(cursor->bytes + start, utf8, utf8Length)) : (0 == memcmp(cursor->bytes + start, utf8, utf8Length));
+    }
+
+    //decode
+    decoded = xmlDecode(cursor, start, end, raw);
+
+    //compare
+    return (YES == insensitive) ? (NSOrderedSame == [decoded caseInsensitiveCompare:key]) : [decoded isEqualToString:key];
+}
+
+//skip value
+// just scans, nothing is created
+static BOOL xmlSkip(XMLCursor* cursor, XMLTag* tag, NSUInteger depth)
+{
+    //child
+    XMLTag child = {0};
+
+    //text
+    size_t start = 0;
+    size_t end = 0;
+    BOOL raw = NO;
+
+    //too deep, or close tag?
+    if( (depth > PLIST_QUERY_MAX_DEPTH) ||
+        (YES == tag->isClose) )
+    {
+        return NO;
+    }
+
+    //empty?
+    if(YES == tag->isEmpty) return YES;
+
+    //container?
+    // skip each child, till close tag
+    if( (YES == xmlTagIs(cursor, tag, "dict")) ||
+        (YES == xmlTagIs(cursor, tag, "array")) )
+    {
+        while(YES)
+        {
+            //child
+            if( (YES != xmlSkipMisc(cursor)) ||
+                (YES != xmlTag(cursor, &child)) )
+            {
+                return NO;
+            }
+
+            //close?
+            if(YES == child.isClose)
+            {
+                return (child.nameLength == tag->nameLength) && (0 == memcmp(cursor->bytes + child.name, cursor->bytes + tag->name, tag->nameLength));
+            }
+
+            //skip
+            if(YES != xmlSkip(cursor, &child, depth + 1)) return NO;
+        }
+    }
+
+    //leaf
+    return xmlLeaf(cursor, tag, &start, &end, &raw);
+}
+
+//create value
+// and (recursively) any it contains
+static PlistQueryResult xmlObject(XMLCursor* cursor, XMLTag* tag, NSUInteger depth, id* value)
+{
+    //child
+    XMLTag child = {0};
+
+    //text
+    size_t start = 0;
+    size_t end = 0;
+    BOOL raw = NO;
+
+    //string
+    NSString* string = nil;
+
+    //key
+    NSString* key = nil;
+
+    //collection
+    id collection = nil;
+
+    //object
+    id object = nil;
+
+    //buffer
+    // for numbers
+    char buffer[64] = {0};
+
+    //end of number
+    char* numberEnd = NULL;
+
+    //result
+    PlistQueryResult result = PlistQueryInvalid;
+
+    //date formatter
+    static NSISO8601DateFormatter* formatter = nil;
+    static dispatch_once_t onceToken = 0;
+
+    //too deep, too many objects, or close tag?
+    if( (depth > PLIST_QUERY_MAX_DEPTH) ||
+        (0 == cursor->budget) ||
+        (YES == tag->isClose) )
+    {
+        return PlistQueryInvalid;
+    }
+
+    //dec
+    cursor->budget--;
+
+    //dictionary
+    if(YES == xmlTagIs(cursor, tag, "dict"))
+    {
+        //alloc
+        collection = [NSMutableDictionary dictionary];
+
+        //add each
+        while(YES != tag->isEmpty)
+        {
+            //key (or close) tag
+            if( (YES != xmlSkipMisc(cursor)) ||
+                (YES != xmlTag(cursor, &child)) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            //close?
+            if(YES == child.isClose)
+            {
+                if(YES != xmlTagIs(cursor, &child, "dict")) return PlistQueryInvalid;
+                break;
+            }
+
+            //key
+            if( (YES != xmlTagIs(cursor, &child, "key")) ||
+                (YES != xmlLeaf(cursor, &child, &start, &end, &raw)) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            key = xmlDecode(cursor, start, end, raw);
+            if(nil == key) return PlistQueryInvalid;
+
+            //value tag
+            if( (YES != xmlSkipMisc(cursor)) ||
+                (YES != xmlTag(cursor, &child)) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            //value
+            result = xmlObject(cursor, &child, depth + 1, &object);
+            if(PlistQueryFound != result) return result;
+
+            //add
+            ((NSMutableDictionary*)collection)[key] = object;
+        }
+
+        *value = collection;
+    }
+
+    //array
+    else if(YES == xmlTagIs(cursor, tag, "array"))
+    {
+        //alloc
+        collection = [NSMutableArray array];
+
+        //add each
+        while(YES != tag->isEmpty)
+        {
+            //value (or close) tag
+            if( (YES != xmlSkipMisc(cursor)) ||
+                (YES != xmlTag(cursor, &child)) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            //close?
+            if(YES == child.isClose)
+            {
+                if(YES != xmlTagIs(cursor, &child, "array")) return PlistQueryInvalid;
+                break;
+            }
+
+            //value
+            result = xmlObject(cursor, &child, depth + 1, &object);
+            if(PlistQueryFound != result) return result;
+
+            //add
+            [collection addObject:object];
+        }
+
+        *value = collection;
+    }
+
+    //leaf
+    else
+    {
+        //text
+        if(YES != xmlLeaf(cursor, tag, &start, &end, &raw)) return PlistQueryInvalid;
+
+        //decode
+        string = xmlDecode(cursor, start, end, raw);
+        if(nil == string) return PlistQueryInvalid;
+
+        //string
+        if(YES == xmlTagIs(cursor, tag, "string"))
+        {
+            *value = string;
+        }
+
+        //true/false
+        else if(YES == xmlTagIs(cursor, tag, "true")) *value = @YES;
+        else if(YES == xmlTagIs(cursor, tag, "false")) *value = @NO;
+
+        //integer/real
+        else if( (YES == xmlTagIs(cursor, tag, "integer")) ||
+                 (YES == xmlTagIs(cursor, tag, "real")) )
+        {
+            //trim
+            string = [string stringByTrimmingCharactersInSet:NSCharacterSet.whitespaceAndNewlineCharacterSet];
+            if( (0 == string.length) ||
+                (YES != [string getCString:buffer maxLength:sizeof(buffer) encoding:NSASCIIStringEncoding]) )
+            {
+                return PlistQueryInvalid;
+            }
+
+            //real
+            if(YES == xmlTagIs(cursor, tag, "real"))
+            {
+                *value = [NSNumber numberWithDouble:strtod(buffer, &numberEnd)];
+            }
+            //negative
+            else if('-' == buffer[0])
+            {
+                *value = [NSNumber numberWithLongLong:strtoll(buffer, &numberEnd, ((0 == strncasecmp(buffer + 1, "0x", 2)) ? 16 : 10))];
+            }
+            //positive
+            else
+            {
+                *value = [NSNumber numberWithUnsignedLongLong:strtoull(buffer, &numberEnd, ((0 == strncasecmp(buffer + (('+' == buffer[0]) ? 1 : 0), "0x", 2)) ? 16 : 10))];
+            }
+
+            //all of it?
+            if('\0' != *numberEnd) return PlistQueryInvalid;
+        }
+
+        //date
+        else if(YES == xmlTagIs(cursor, tag, "date"))
+        {
+            //init formatter once
+            dispatch_once(&onceToken, ^{
+                formatter = [[NSISO8601DateFormatter alloc] init];
+            });
+
+            *value = [formatter dateFromString:[string stringByTrimmingCharactersInSet:NSCharacterSet.whitespaceAndNewlineCharacterSet]];
+            if(nil == *value) return PlistQueryInvalid;
+        }
+
+        //data
+        // base64, ignoring whitespace
+        else if(YES == xmlTagIs(cursor, tag, "data"))
+        {
+            *value = [[NSData alloc] initWithBase64EncodedString:string options:NSDataBase64DecodingIgnoreUnknownCharacters];
+            if(nil == *value) return PlistQueryInvalid;
+        }
+
+        //unknown
+        else return PlistQueryInvalid;
+    }
+
+    return PlistQueryFound;
+}
+
+//query xml plist
+// scan (only) to the value, then create it
+static PlistQueryResult xmlQuery(XMLCursor* cursor, NSArray* keyPath, BOOL insensitive, id* value)
+{
+    //tag
+    XMLTag tag = {0};
+
+    //child
+    XMLTag child = {0};
+
+    //text
+    size_t start = 0;
+    size_t end = 0;
+    BOOL raw = NO;
+
+    //position of value
+    size_t valuePosition = 0;
+
+    //position of (exact) match's value
+    size_t matchPosition = 0;
+
+    //position of (insensitive) match's value
+    size_t insensitivePosition = 0;
+
+    //root tag
+    // skipping prolog, and 'plist' element
+    if( (YES != xmlSkipMisc(cursor)) ||
+        (YES != xmlTag(cursor, &tag)) )
+    {
+        return PlistQueryInvalid;
+    }
+    if(YES == xmlTagIs(cursor, &tag, "plist"))
+    {
+        //empty?
+        if(YES == tag.isEmpty) return PlistQueryNotFound;
+
+        //root value tag
+        if( (YES != xmlSkipMisc(cursor)) ||
+            (YES != xmlTag(cursor, &tag)) )
+        {
+            return PlistQueryInvalid;
+        }
+    }
+
+    //walk key path
+    for(id element in keyPath)
+    {
+        //close tag?
+        if(YES == tag.isClose) return PlistQueryInvalid;
+
+        //key?
+        // find in dictionary, comparing keys and skipping other values
+        if(YES == [element isKindOfClass:[NSString class]])
+        {
+            //not a dictionary?
+            if( (YES != xmlTagIs(cursor, &tag, "dict")) ||
+                (YES == tag.isEmpty) )
+            {
+                return PlistQueryNotFound;
+            }
+
+            //init
+            matchPosition = SIZE_MAX;
+            insensitivePosition = SIZE_MAX;
+
+            //find
+            // exact match wins, otherwise insensitive one
+            // note: all keys are checked, as (like CF/launchd) the last duplicate key wins
+            while(YES)
+            {
+                //key (or close) tag
+                if( (YES != xmlSkipMisc(cursor)) ||
+                    (YES != xmlTag(cursor, &child)) )
+                {
+                    return PlistQueryInvalid;
+                }
+
+                //close?
+                if(YES == child.isClose)
+                {
+                    if(YES != xmlTagIs(cursor, &child, "dict")) return PlistQueryInvalid;
+                    break;
+                }
+
+                //key
+                if( (YES != xmlTagIs(cursor, &child, "key")) ||
+                    (YES != xmlLeaf(cursor, &child, &start, &end, &raw)) ||
+                    (YES != xmlSkipMisc(cursor)) )
+                {
+                    return PlistQueryInvalid;
+                }
+
+                //value's position
+                valuePosition = cursor->position;
+
+                //exact?
+                if(YES == xmlKeyMatches(cursor, start, end, raw, element, [element UTF8String], strlen([element UTF8String]), NO))
+                {
+                    //save
+                    matchPosition = valuePosition;
+                }
+
+                //insensitive?
+                else if( (YES == insensitive) &&
+                         (YES == xmlKeyMatches(cursor, start, end, raw, element, [element UTF8String], strlen([element UTF8String]), YES)) )
+                {
+                    //save
+                    insensitivePosition = valuePosition;
+                }
+
+                //skip value
+                if( (YES != xmlTag(cursor, &child)) ||
+                    (YES != xmlSkip(cursor, &child, 1)) )
+                {
+                    return PlistQueryInvalid;
+                }
+            }
+
+            //none?
+            if(SIZE_MAX == matchPosition) matchPosition = insensitivePosition;
+            if(SIZE_MAX == matchPosition) return PlistQueryNotFound;
+
+            //rewind to match's value
+            cursor->position = matchPosition;
+
+            //value tag
+            if(YES != xmlTag(cursor, &tag)) return PlistQueryInvalid;
+        }
+
+        //index?
+        // in array, skipping values before it
+        else if(YES == [element isKindOfClass:[NSNumber class]])
+        {
+            //not an array?
+            if( (YES != xmlTagIs(cursor, &tag, "array")) ||
+                (YES == tag.isEmpty) )
+            {
+                return PlistQueryNotFound;
+            }
+
+            //find
+            for(NSUInteger i = 0; YES; i++)
+            {
+                //value (or close) tag
+                if( (YES != xmlSkipMisc(cursor)) ||
+                    (YES != xmlTag(cursor, &child)) )
+                {
+                    return PlistQueryInvalid;
+                }
+
+                //close?
+                // out of range
+                if(YES == child.isClose) return PlistQueryNotFound;
+
+                //found?
+                if(i == [element unsignedIntegerValue])
+                {
+                    //save
+                    tag = child;
+                    break;
+                }
+
+                //skip
+                if(YES != xmlSkip(cursor, &child, 1)) return PlistQueryInvalid;
+            }
+        }
+
+        //invalid element
+        else return PlistQueryNotFound;
+    }
+
+    //create value
+    return xmlObject(cursor, &tag, 0, value);
+}
+
+//query plist for value at key path
+// binary (bplist00) or (utf-8) xml
+PlistQueryResult plistQuery(NSData* data, NSArray* keyPath, BOOL insensitive, id* value)
+{
+    //binary plist
+    BinaryPlist binary = {0};
+
+    //xml cursor
+    XMLCursor cursor = {0};
+
+    //init
+    *value = nil;
+
+    //binary?
+    if( (data.length >= 8) &&
+        (0 == memcmp(data.bytes, "bplist00", 8)) )
+    {
+        //open
+        if(YES != binaryOpen(data, &binary)) return PlistQueryInvalid;
+
+        //query
+        return binaryQuery(&binary, keyPath, insensitive, value);
+    }
+
+    //init cursor
+    cursor.bytes = data.bytes;
+    cursor.length = data.length;
+    cursor.budget = PLIST_QUERY_MAX_OBJECTS;
+
+    //skip (utf-8) BOM
+    if(YES == xmlHasPrefix(&cursor, "\xEF\xBB\xBF")) cursor.position += 3;
+
+    //declared (non utf-8) encoding?
+    // as that's only parsed as utf-8, leave it to foundation
+    if(YES != xmlEncodingSupported(&cursor)) return PlistQueryUnsupported;
+
+    //xml?
+    // i.e. starts w/ a tag
+    if( (YES != xmlSkipMisc(&cursor)) ||
+        (cursor.position >= cursor.length) ||
+        ('<' != cursor.bytes[cursor.position]) )
+    {
+        return PlistQueryUnsupported;
+    }
+
+    //query
+    return xmlQuery(&cursor, keyPath, insensitive, value);
+}
@@ -47,8 +47,18 @@
 #define PREFS_FILE @"preferences.plist"
 
 //rules file
+// legacy (keyed archive), migrated to snapshot
 #define RULES_FILE @"rules.plist"
 
+//rules snapshot file
+#define RULES_SNAPSHOT_FILE @"rules.db"
+
+//rules journal file
+#define RULES_JOURNAL_FILE @"rules.journal"
+
+//signing (verdict) cache file
+#define SIGNING_CACHE_FILE @"signing.cache"
+
 //client no status
 #define STATUS_CLIENT_UNKNOWN -1
 
@@ -137,6 +147,7 @@
 #define PREF_NOTARIZATION_MODE @"notarizationMode"
 #define PREF_NOTARIZATION_ALL_MODE @"notarizationAllMode"
 #define PREF_NOTARIZATION_ES_TIMEOUT_MODE @"notarizationESTimeoutMode"
+#define PREF_NOTARIZATION_ES_TIMEOUT_MARGIN @"notarizationESTimeoutMargin"
 
 //prefs
 // (block) click fix mode
@@ -147,6 +158,11 @@
 // update mode
 #define PREF_NO_UPDATE_MODE @"noupdateMode"
 
+//prefs
+// coalescing of related events (window in seconds)
+#define PREF_COALESCE_WINDOW @"coalesceWindow"
+#define PREF_COALESCE_CAPACITY @"coalesceCapacity"
+
 //general error URL
 #define FATAL_ERROR_URL @"https://objective-see.org/errors.html"
 
@@ -34,9 +34,22 @@ void qtn_file_free(qtn_file_t qf);
 uint32_t qtn_file_get_flags(qtn_file_t qf);
 int qtn_file_init_with_path(qtn_file_t qf, const char *path);
 
+//max number of (cached) quarantine flags
+#define QUARANTINE_CACHE_MAX_ENTRIES 1024
+
 //get quarantine flags
 uint32_t getQuarantineFlags(NSString* path);
 
+//get quarantine flags, via cache
+// keyed by (device, inode, ctime)
+uint32_t getCachedQuarantineFlags(NSString* path);
+
+//invalidate cached quarantine flags
+void invalidateQuarantineFlags(NSString* path);
+
+//quarantine (flags) cache stats
+NSDictionary* quarantineCacheStats(void);
+
 //mach time to nano-seconds
 uint64_t machTimeToNanoseconds(uint64_t machTime);
 
@@ -80,6 +93,20 @@ NSBundle* getBundle(NSString* path, float maxWait);
 // takes optional wait time...
 id getValueFromPlist(NSString* plistFile, NSString* key, BOOL insensitive, float maxWait);
 
+#ifdef DAEMON_BUILD
+
+//max memory of plist (query) cache
+#define PLIST_CACHE_MAX_MEMORY (4 * 1024 * 1024)
+
+//query plist for value at key path
+// selectively parsed, and cached by path, (device, inode, ctime, size)
+id queryPlist(NSString* path, NSArray* keyPath, BOOL insensitive);
+
+//plist (query) cache stats
+NSDictionary* plistCacheStats(void);
+
+#endif
+
 //find 'top-level' app of binary
 // useful to determine if binary (or other app) is embedded in a 'parent' app bundle
 NSString* topLevelApp(NSString* binaryPath);
@@ -10,7 +10,12 @@
 #import "consts.h"
 #import "utilities.h"
 
+#ifdef DAEMON_BUILD
+#import "PlistQuery.h"
+#endif
+
 #import <dlfcn.h>
+#import <os/lock.h>
 #import <signal.h>
 #import <unistd.h>
 #import <libproc.h>
@@ -1289,20 +1294,19 @@ void waitForFile(NSString* path, float maxWait)
     NSUInteger count = 0;
     
     //wait for file
-    do
+    // note: no wait (nap) if max is zero
+    while(YES != [[NSFileManager defaultManager] fileExistsAtPath:path])
     {
-        //wait for file
-        if(YES == [[NSFileManager defaultManager] fileExistsAtPath:path])
+        //try up to specified max
+        if(count++ >= maxWait/waitInterval)
         {
-            //happy
+            //done
             break;
         }
         
         //nap
         [NSThread sleepForTimeInterval:waitInterval];
-        
-    //try up to specified max
-    } while(count++ < maxWait/waitInterval);
+    }
 }
 
 //given a bundle path
@@ -1334,19 +1338,411 @@ bail:
     return bundle;
 }
 
+#ifdef DAEMON_BUILD
+
+//plist (query) cache
+// key: path, value: @{version, size, results}
+// results key: (insensitive) key path, value: value (or NSNull, if not found)
+static NSMutableDictionary<NSString*, NSDictionary*>* plistCache = nil;
+
+//plist cache order
+// least recently used first
+static NSMutableArray<NSString*>* plistCacheOrder = nil;
+
+//plist cache lock
+static os_unfair_lock plistCacheLock = OS_UNFAIR_LOCK_INIT;
+
+//plist cache memory (bytes, est.)
+static uint64_t plistCacheMemory = 0;
+
+//plist cache counters
+static uint64_t plistCacheHits = 0;
+static uint64_t plistCacheMisses = 0;
+static uint64_t plistCacheStale = 0;
+static uint64_t plistCacheEvictions = 0;
+
+//plist parse counters
+static uint64_t plistParsesSelective = 0;
+static uint64_t plistParsesFull = 0;
+static uint64_t plistParsesInvalid = 0;
+static uint64_t plistParsesDivergent = 0;
+
+//remove (cached) plist
+// note: caller must hold lock
+static void plistCacheRemove(NSString* path)
+{
+    //dec
+    plistCacheMemory -= [plistCache[path][@"size"] unsignedLongLongValue];
+    
+    //remove
+    [plistCache removeObjectForKey:path];
+    [plistCacheOrder removeObject:path];
+    
+    return;
+}
+
+//walk (fully parsed) plist to value at key path
+// only used for formats the selective parser doesn't support
+static id walkPlist(id plist, NSArray* keyPath, BOOL insensitive)
+{
+    //value
+    id value = plist;
+    
+    //match
+    id match = nil;
+    
+    //walk key path
+    for(id element in keyPath)
+    {
+        //dictionary?
+        if( (YES == [value isKindOfClass:[NSDictionary class]]) &&
+            (YES == [element isKindOfClass:[NSString class]]) )
+        {
+            //exact match
+            match = value[element];
+            
+            //not found?
+            // try insensitve lookup
+            if( (nil == match) &&
+                (YES == insensitive) )
+            {
+                for(id key in value)
+                {
+                    //match?
+                    if( (YES == [key isKindOfClass:[NSString class]]) &&
+                        (NSOrderedSame == [key caseInsensitiveCompare:element]) )
+                    {
+                        //found!
+                        match = value[key];
+                        break;
+                    }
+                }
+            }
+            
+            //next
+            value = match;
+        }
+        
+        //array?
+        else if( (YES == [value isKindOfClass:[NSArray class]]) &&
+                 (YES == [element isKindOfClass:[NSNumber class]]) )
+        {
+            //next
+            value = ([element unsignedIntegerValue] < [value count]) ? value[[element unsignedIntegerValue]] : nil;
+        }
+        
+        //not a container
+        else
+        {
+            value = nil;
+        }
+        
+        //not found?
+        if(nil == value) break;
+    }
+    
+    return value;
+}
+
+//query plist (file) for value at key path
+// selective parse, falling back to a full parse for other formats (e.g. openstep)
+// ...or if the selective parser rejects it, in case it's (more) strict than foundation
+static id parsePlist(NSString* path, NSArray* keyPath, BOOL insensitive)
+{
+    //value
+    id value = nil;
+    
+    //data
+    NSData* data = nil;
+    
+    //(fully) parsed plist
+    id plist = nil;
+    
+    //result
+    PlistQueryResult result = PlistQueryNotFound;
+    
+    //load
+    // mapped, as only parts of it are (typically) read
+    data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+    if(nil == data)
+    {
+        //bail
+        goto bail;
+    }
+    
+    //query
+    result = plistQuery(data, keyPath, insensitive, &value);
+    
+    //unsupported?
+    // fully parse and walk
+    if(PlistQueryUnsupported == result)
+    {
+        //lock
+        os_unfair_lock_lock(&plistCacheLock);
+        
+        //inc
+        plistParsesFull++;
+        
+        //unlock
+        os_unfair_lock_unlock(&plistCacheLock);
+        
+        //parse and walk
+        value = walkPlist([NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:nil], keyPath, insensitive);
+        
+        //done
+        goto bail;
+    }
+    
+    //invalid?
+    // fully parse, as foundation (i.e. launchd) may accept what selective parser doesn't
+    if(PlistQueryInvalid == result)
+    {
+        //parse
+        plist = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:nil];
+        
+        //lock
+        os_unfair_lock_lock(&plistCacheLock);
+        
+        //inc
+        if(nil != plist) plistParsesDivergent++;
+        else plistParsesInvalid++;
+        
+        //unlock
+        os_unfair_lock_unlock(&plistCacheLock);
+        
+        //not valid (to foundation either)?
+        if(nil == plist)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: %{public}@ is not a valid plist", path);
+            
+            //bail
+            goto bail;
+        }
+        
+        //err msg
+        // selective parser should accept anything foundation does
+        os_log_error(logHandle, "ERROR: selective parser rejected %{public}@, but it's a valid plist (used full parse)", path);
+        
+        //walk
+        value = walkPlist(plist, keyPath, insensitive);
+        
+        //done
+        goto bail;
+    }
+    
+    //lock
+    os_unfair_lock_lock(&plistCacheLock);
+    
+    //inc
+    plistParsesSelective++;
+    
+    //unlock
+    os_unfair_lock_unlock(&plistCacheLock);
+    
+bail:
+    
+    return value;
+}
+
+//query plist for value at key path
+// results cached by path, and only used if file's (device, inode, ctime, size) still match
+// note: ctime, not mtime, as mtime can be reset (utimes), but ctime can't
+id queryPlist(NSString* path, NSArray* keyPath, BOOL insensitive)
+{
+    //value
+    id value = nil;
+    
+    //cached
+    NSDictionary* cached = nil;
+    
+    //file info
+    struct stat fileInfo = {0};
+    
+    //version
+    NSString* version = nil;
+    
+    //query
+    NSString* query = nil;
+    
+    //can't stat?
+    if( (0 == path.length) ||
+        (0 != stat(path.fileSystemRepresentation, &fileInfo)) )
+    {
+        //bail
+        goto bail;
+    }
+    
+    //init version
+    version = [NSString stringWithFormat:@"%d:%llu:%ld.%ld:%lld", fileInfo.st_dev, fileInfo.st_ino, fileInfo.st_ctimespec.tv_sec, fileInfo.st_ctimespec.tv_nsec, fileInfo.st_size];
+    
+    //init query
+    query = [NSString stringWithFormat:@"%d:%@", insensitive, [keyPath componentsJoinedByString:@"\x1f"]];
+    
+    //lock
+    os_unfair_lock_lock(&plistCacheLock);
+    
+    //find
+    cached = plistCache[path];
+    
+    //stale?
+    // remove, as it'll be replaced
+    if( (nil != cached) &&
+        (YES != [cached[@"version"] isEqualToString:version]) )
+    {
+        //inc
+        plistCacheStale++;
+        
+        //remove
+        plistCacheRemove(path);
+        
+        //unset
+        cached = nil;
+    }
+    
+    //hit?
+    value = cached[@"results"][query];
+    if(nil != value)
+    {
+        //inc
+        plistCacheHits++;
+        
+        //most recently used
+        [plistCacheOrder removeObject:path];
+        [plistCacheOrder addObject:path];
+        
+        //unlock
+        os_unfair_lock_unlock(&plistCacheLock);
+        
+        //done
+        goto bail;
+    }
+    
+    //inc
+    plistCacheMisses++;
+    
+    //unlock
+    os_unfair_lock_unlock(&plistCacheLock);
+    
+    //query
+    value = parsePlist(path, keyPath, insensitive);
+    
+    //too big to cache?
+    if(fileInfo.st_size > PLIST_CACHE_MAX_MEMORY/4)
+    {
+        //bail
+        goto bail;
+    }
+    
+    //lock
+    os_unfair_lock_lock(&plistCacheLock);
+    
+    //alloc
+    if(nil == plistCache)
+    {
+        //alloc
+        plistCache = [NSMutableDictionary dictionary];
+        plistCacheOrder = [NSMutableArray array];
+    }
+    
+    //not cached?
+    // add, evicting least recently used, till under cap
+    if(nil == plistCache[path])
+    {
+        //evict
+        while( (0 != plistCacheOrder.count) &&
+               (plistCacheMemory + (uint64_t)fileInfo.st_size > PLIST_CACHE_MAX_MEMORY) )
+        {
+            //remove
+            plistCacheRemove(plistCacheOrder.firstObject);
+            
+            //inc
+            plistCacheEvictions++;
+        }
+        
+        //add
+        plistCache[path] = @{@"version":version, @"size":@(fileInfo.st_size), @"results":[NSMutableDictionary dictionary]};
+        [plistCacheOrder addObject:path];
+        
+        //inc
+        plistCacheMemory += fileInfo.st_size;
+    }
+    
+    //add result
+    // ...if (still) same version
+    if(YES == [plistCache[path][@"version"] isEqualToString:version])
+    {
+        //add
+        plistCache[path][@"results"][query] = (nil != value) ? value : [NSNull null];
+    }
+    
+    //unlock
+    os_unfair_lock_unlock(&plistCacheLock);
+    
+bail:
+    
+    //not found?
+    if(YES == [value isKindOfClass:[NSNull class]]) value = nil;
+    
+    return value;
+}
+
+//plist (query) cache stats
+// entries, memory, hits/misses, parses
+NSDictionary* plistCacheStats(void)
+{
+    //stats
+    NSDictionary* stats = nil;
+    
+    //lock
+    os_unfair_lock_lock(&plistCacheLock);
+    
+    //init
+    stats = @{@"entries":@(plistCache.count),
+              @"memory (bytes, est.)":@(plistCacheMemory),
+              @"hits":@(plistCacheHits),
+              @"misses":@(plistCacheMisses),
+              @"hit rate (%)":@((0 != plistCacheHits + plistCacheMisses) ? ((100 * plistCacheHits) / (plistCacheHits + plistCacheMisses)) : 0),
+              @"stale":@(plistCacheStale),
+              @"evictions":@(plistCacheEvictions),
+              @"parses (selective)":@(plistParsesSelective),
+              @"parses (full)":@(plistParsesFull),
+              @"invalid":@(plistParsesInvalid),
+              @"divergent (selective invalid, full valid)":@(plistParsesDivergent)};
+    
+    //unlock
+    os_unfair_lock_unlock(&plistCacheLock);
+    
+    return stats;
+}
+
+#endif
+
 //extract value from plist
 // takes optional wait time...
 id getValueFromPlist(NSString* plistFile, NSString* plistKey, BOOL insensitiveKey, float maxWait)
 {
     //return var
-    id plistValue;
+    id plistValue = nil;
+    
+#ifndef DAEMON_BUILD
     
     //contents of plist
     NSDictionary* plistContents = nil;
     
+#endif
+    
     //wait for file
     waitForFile(plistFile, maxWait);
     
+#ifdef DAEMON_BUILD
+    
+    //query
+    // selectively parsed (only the key's value is created), and cached
+    plistValue = queryPlist(plistFile, @[plistKey], insensitiveKey);
+    
+#else
+    
     //load it
     plistContents = [NSDictionary dictionaryWithContentsOfFile:plistFile];
     if(nil == plistContents)
@@ -1384,6 +1780,8 @@ id getValueFromPlist(NSString* plistFile, NSString* plistKey, BOOL insensitiveKe
     
 bail:
     
+#endif
+    
     return plistValue;
 }
 
@@ -1752,6 +2150,173 @@ uint64_t machTimeToNanoseconds(uint64_t machTime)
     return nanoseconds;
 }
 
+//quarantine (flags) cache
+// key: (device, inode), value: ctime + flags
+static NSMutableDictionary<NSData*, NSArray<NSNumber*>*>* quarantineCache = nil;
+
+//quarantine cache lock
+static os_unfair_lock quarantineCacheLock = OS_UNFAIR_LOCK_INIT;
+
+//quarantine cache counters
+static uint64_t quarantineCacheHits = 0;
+static uint64_t quarantineCacheMisses = 0;
+static uint64_t quarantineCacheInvalidations = 0;
+
+//quarantine cache key
+// (device, inode) of item, as data
+static NSData* quarantineCacheKey(const struct stat* info)
+{
+    //key
+    struct { dev_t device; ino_t inode; } key = {info->st_dev, info->st_ino};
+    
+    return [NSData dataWithBytes:&key length:sizeof(key)];
+}
+
+//get items quarantine flags, via cache
+// key is (device, inode), and ctime must match, as setting/changing the xattr updates it
+uint32_t getCachedQuarantineFlags(NSString* path)
+{
+    //flags
+    uint32_t flags = QTN_NOT_QUARANTINED;
+    
+    //stat
+    struct stat info = {0};
+    
+    //key
+    NSData* key = nil;
+    
+    //cached
+    NSArray<NSNumber*>* cached = nil;
+    
+    //ctime (ns)
+    uint64_t ctime = 0;
+    
+    //can't stat?
+    // just get flags directly
+    if(0 != stat(path.fileSystemRepresentation, &info))
+    {
+        //get
+        return getQuarantineFlags(path);
+    }
+    
+    //init key
+    key = quarantineCacheKey(&info);
+    
+    //init ctime
+    ctime = (uint64_t)info.st_ctimespec.tv_sec * NSEC_PER_SEC + (uint64_t)info.st_ctimespec.tv_nsec;
+    
+    //lock
+    os_unfair_lock_lock(&quarantineCacheLock);
+    
+    //find
+    cached = quarantineCache[key];
+    
+    //hit?
+    // ctime must (still) match
+    if( (nil != cached) &&
+        (ctime == cached.firstObject.unsignedLongLongValue) )
+    {
+        //inc
+        quarantineCacheHits++;
+        
+        //unlock
+        os_unfair_lock_unlock(&quarantineCacheLock);
+        
+        return cached.lastObject.unsignedIntValue;
+    }
+    
+    //inc
+    quarantineCacheMisses++;
+    
+    //unlock
+    os_unfair_lock_unlock(&quarantineCacheLock);
+    
+    //get flags
+    flags = getQuarantineFlags(path);
+    
+    //lock
+    os_unfair_lock_lock(&quarantineCacheLock);
+    
+    //alloc
+    if(nil == quarantineCache)
+    {
+        //alloc
+        quarantineCache = [NSMutableDictionary dictionary];
+    }
+    
+    //full?
+    // just start over
+    if(quarantineCache.count >= QUARANTINE_CACHE_MAX_ENTRIES)
+    {
+        //clear
+        [quarantineCache removeAllObjects];
+    }
+    
+    //add
+    quarantineCache[key] = @[@(ctime), @(flags)];
+    
+    //unlock
+    os_unfair_lock_unlock(&quarantineCacheLock);
+    
+    return flags;
+}
+
+//invalidate quarantine (flags) cache entry
+// e.g. once quarantine attributes have been removed
+void invalidateQuarantineFlags(NSString* path)
+{
+    //stat
+    struct stat info = {0};
+    
+    //can't stat?
+    if(0 != stat(path.fileSystemRepresentation, &info))
+    {
+        //bail
+        return;
+    }
+    
+    //lock
+    os_unfair_lock_lock(&quarantineCacheLock);
+    
+    //remove
+    if(nil != quarantineCache[quarantineCacheKey(&info)])
+    {
+        //remove
+        [quarantineCache removeObjectForKey:quarantineCacheKey(&info)];
+        
+        //inc
+        quarantineCacheInvalidations++;
+    }
+    
+    //unlock
+    os_unfair_lock_unlock(&quarantineCacheLock);
+    
+    return;
+}
+
+//quarantine (flags) cache stats
+// entries, hits/misses, invalidations
+NSDictionary* quarantineCacheStats(void)
+{
+    //stats
+    NSDictionary* stats = nil;
+    
+    //lock
+    os_unfair_lock_lock(&quarantineCacheLock);
+    
+    //init
+    stats = @{@"entries":@(quarantineCache.count),
+              @"hits":@(quarantineCacheHits),
+              @"misses":@(quarantineCacheMisses),
+              @"hit rate (%)":@((0 != quarantineCacheHits + quarantineCacheMisses) ? ((100 * quarantineCacheHits) / (quarantineCacheHits + quarantineCacheMisses)) : 0),
+              @"invalidations":@(quarantineCacheInvalidations)};
+    
+    //unlock
+    os_unfair_lock_unlock(&quarantineCacheLock);
+    
+    return stats;
+}
+
 //check if item is downloaded
 BOOL isDownloaded(NSString* path) {
     
@@ -1761,7 +2326,8 @@ BOOL isDownloaded(NSString* path) {
     }
     
     //get flags
-    uint32_t quarantineFlags = getQuarantineFlags(path);
+    // via cache, as this is checked for every (non-platform) exec
+    uint32_t quarantineFlags = getCachedQuarantineFlags(path);
     
     //not quarantined?
     if(quarantineFlags == QTN_NOT_QUARANTINED) {
@@ -1786,6 +2352,9 @@ BOOL removeQuarantine(NSString* path) {
         return NO;
     }
     
+    //invalidate cached flags
+    invalidateQuarantineFlags(path);
+    
     //remove
     if(0 != removexattr(path.fileSystemRepresentation, "com.apple.quarantine", 0)) {
 